@@ -4,7 +4,10 @@
 #include <string.h>
 #include <getopt.h>
 #include <stdint.h>
+#include <ctype.h>
+#include <errno.h>
 #include "utils/logger.h"
+#include "utils/conn_table.h"
 
 void show_help(const char* program) {
     printf("Usage: %s [OPTIONS]\n", program);
@@ -15,7 +18,12 @@ void show_help(const char* program) {
     printf("  -h, --help           Show this help\n");
     printf("  -u, --add-user       Add a user (format: user:password)\n");
     printf("  -d, --del-user       Delete a user\n");
+    printf("  -B, --batch FILE     Add and delete users in bulk from FILE ('-' for stdin):\n");
+    printf("                       one 'user:password' (add) or '-user' (delete) per line\n");
     printf("  -l, --list-users     List configured users\n");
+    printf("  -W, --bandwidth USER:UP:DOWN  Limit a user's upload and download in bytes/s\n");
+    printf("                       (K, M and G suffixes; 0 = unlimited)\n");
+    printf("  -M, --max-connections USER:N  Limit a user's concurrent connections (0 = unlimited)\n");
     printf("  -s, --stats          Show statistics of the proxy\n");
     printf("  -v, --version        Show version\n");
     printf("  -t, --set-timeout MS Set connection timeout (milliseconds)\n");
@@ -23,6 +31,17 @@ void show_help(const char* program) {
     printf("  -m, --set-max-clients NUM Set maximum number of clients\n");
     printf("  -r, --reload-config       Reload configuration from file\n");
     printf("  -c, --config              Show current server configuration\n");
+    printf("  -C, --connections         List live connections\n");
+    printf("  -L, --loop-stats          Show event loop profile\n");
+    printf("  -R, --rotate-logs         Rotate the server log files now\n");
+    printf("  -F, --flight TARGET       Dump the flight recorder of a connection id, a user,\n");
+    printf("                            or 'failed' for recently failed connections\n");
+    printf("  -S, --slow-handshakes     Show the most recent slow handshakes with per-stage times\n");
+    printf("  -p, --paths               Show TCP path quality per destination (RTT, retransmits)\n");
+    printf("      --filter-user USER    Only connections of USER (with -C)\n");
+    printf("      --filter-dest TEXT    Only destinations containing TEXT (with -C)\n");
+    printf("      --offset N            Skip the first N matches (with -C or -l)\n");
+    printf("      --limit N             Show at most N matches (with -C, max %d, -l, -p or -S)\n", MGMT_CONNECTIONS_PAGE_MAX);
     printf("\n");
     printf("SOCKS5 PROXY USAGE:\n");
     printf("  Default server: 127.0.0.1:1080\n");
@@ -111,42 +130,364 @@ void delete_user(const char* user) {
     mgmt_close_connection(sock);
 }
 
-void list_users(void) {
-    // Connect to server
+static const char* batch_result_text(int32_t result) {
+    switch (result) {
+        case MGMT_BATCH_OK: return "ok";
+        case MGMT_BATCH_EXISTS: return "user already exists";
+        case MGMT_BATCH_NOT_FOUND: return "user not found";
+        case MGMT_BATCH_INVALID: return "invalid entry";
+        default: return "server error";
+    }
+}
+
+// Manda un lote por conexión y muestra las entradas que no se aplicaron;
+// `lines' tiene la línea del archivo de cada entrada
+static uint32_t send_batch(const mgmt_batch_entry_t* entries, const unsigned long* lines, uint32_t count) {
+    static int32_t results[MGMT_BATCH_MAX];
     int sock = mgmt_connect_to_server();
     if (sock < 0) {
         log_fatal("Could not connect to management server at %s:%d", "127.0.0.1", 8080);
         exit(1);
     }
-    
-    // Send command
-    if (mgmt_send_command(sock, CMD_LIST_USERS, NULL, NULL) < 0) {
+    if (mgmt_send_batch_command(sock, entries, count) < 0) {
         log_fatal("Could not send command to management server");
         mgmt_close_connection(sock);
         exit(1);
     }
-    
-    // Receive response
-    mgmt_users_response_t response;
-    if (mgmt_receive_users_response(sock, &response) < 0) {
+    mgmt_batch_response_t response;
+    if (mgmt_receive_batch_response(sock, &response, results, MGMT_BATCH_MAX) < 0) {
         log_fatal("Could not receive response from management server");
         mgmt_close_connection(sock);
         exit(1);
     }
-    
-    // Show result
-    if (response.success) {
-        printf("Configured users (%d):\n", response.user_count);
-        for (int i = 0; i < response.user_count; i++) {
-            printf("  • %s\n", response.users[i].username);
+    mgmt_close_connection(sock);
+
+    if (!response.success) {
+        printf("✗ %s\n", response.message);
+        return 0;
+    }
+    for (uint32_t i = 0; i < response.count; i++) {
+        if (results[i] != MGMT_BATCH_OK) {
+            printf("✗ line %lu: %s %s: %s\n", lines[i],
+                   entries[i].op == MGMT_BATCH_ADD ? "add" : "delete",
+                   entries[i].username, batch_result_text(results[i]));
+        }
+    }
+    return response.applied;
+}
+
+// Altas y bajas desde un archivo, de a MGMT_BATCH_MAX por conexión. Las
+// líneas vacías y las que empiezan con '#' se ignoran.
+static void batch_users(const char* path) {
+    FILE* f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (f == NULL) {
+        log_fatal("Could not open %s", path);
+        exit(1);
+    }
+    static mgmt_batch_entry_t entries[MGMT_BATCH_MAX];
+    static unsigned long lines[MGMT_BATCH_MAX];
+    uint32_t count = 0, total = 0, applied = 0;
+    unsigned long line_number = 0;
+    char line[MAX_USERNAME_LEN + MAX_PASSWORD_LEN + 4];
+
+    while (fgets(line, sizeof(line), f)) {
+        line_number++;
+        if (strchr(line, '\n') == NULL && !feof(f)) {
+            for (int c; (c = getc(f)) != EOF && c != '\n';) {
+            }
+            printf("✗ line %lu: line too long\n", line_number);
+            continue;
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') continue;
+
+        mgmt_batch_entry_t* entry = &entries[count];
+        memset(entry, 0, sizeof(*entry));
+        const char* username = line;
+        if (line[0] == '-') {
+            entry->op = MGMT_BATCH_DEL;
+            username = line + 1;
+        } else {
+            char* separator = strchr(line, ':');
+            if (separator == NULL) {
+                printf("✗ line %lu: expected user:password or -user\n", line_number);
+                continue;
+            }
+            *separator = '\0';
+            entry->op = MGMT_BATCH_ADD;
+            if (strlen(separator + 1) >= MAX_PASSWORD_LEN) {
+                printf("✗ line %lu: password too long\n", line_number);
+                continue;
+            }
+            strcpy(entry->password, separator + 1);
         }
-        if (response.user_count == 0) {
-            printf("  (No users configured)\n");
+        if (strlen(username) >= MAX_USERNAME_LEN) {
+            printf("✗ line %lu: user name too long\n", line_number);
+            continue;
         }
+        strcpy(entry->username, username);
+        lines[count++] = line_number;
+        total++;
+
+        if (count == MGMT_BATCH_MAX) {
+            applied += send_batch(entries, lines, count);
+            count = 0;
+        }
+    }
+    if (f != stdin) {
+        fclose(f);
+    }
+    if (count > 0) {
+        applied += send_batch(entries, lines, count);
+    }
+    memset(entries, 0, sizeof(entries));
+    printf("%s Applied %u of %u user changes\n", applied == total ? "✓" : "✗", applied, total);
+}
+
+static void format_bytes(uint64_t bytes, char* out, size_t out_len);
+
+// "100.0 KiB/s" o "unlimited"
+static void format_limit(uint32_t limit, char* out, size_t out_len) {
+    if (limit == 0) {
+        snprintf(out, out_len, "unlimited");
+        return;
+    }
+    char bytes[32];
+    format_bytes(limit, bytes, sizeof(bytes));
+    snprintf(out, out_len, "%s/s", bytes);
+}
+
+// Bytes/s con sufijo K, M o G opcional (potencias de 1024)
+static bool parse_rate(const char* text, uint32_t* rate) {
+    char* end;
+    errno = 0;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (end == text || errno != 0) return false;
+    unsigned shift = 0;
+    switch (toupper((unsigned char)*end)) {
+        case 'G': shift = 30; end++; break;
+        case 'M': shift = 20; end++; break;
+        case 'K': shift = 10; end++; break;
+        default: break;
+    }
+    // Antes de escalar: 17179869184G daría la vuelta a 0
+    if (*end != '\0' || value > (UINT32_MAX >> shift)) return false;
+    *rate = (uint32_t)(value << shift);
+    return true;
+}
+
+static void set_bandwidth(char* spec) {
+    // USER:UP:DOWN
+    char* up = strchr(spec, ':');
+    char* down = NULL;
+    if (up != NULL) {
+        *up++ = '\0';
+        down = strchr(up, ':');
+    }
+    if (down != NULL) {
+        *down++ = '\0';
+    }
+    uint32_t upload, download;
+    if (down == NULL || spec[0] == '\0' || !parse_rate(up, &upload) || !parse_rate(down, &download)) {
+        log_fatal("Invalid format for bandwidth. Use user:upload:download (bytes/s, 0 = unlimited)");
+        exit(1);
+    }
+
+    int sock = mgmt_connect_to_server();
+    if (sock < 0) {
+        log_fatal("Could not connect to management server at %s:%d", "127.0.0.1", 8080);
+        exit(1);
+    }
+    if (mgmt_send_paged_command(sock, CMD_SET_BANDWIDTH, spec, NULL, upload, download) < 0) {
+        log_fatal("Could not send command to management server");
+        mgmt_close_connection(sock);
+        exit(1);
+    }
+    mgmt_simple_response_t response;
+    if (mgmt_receive_simple_response(sock, &response) < 0) {
+        log_fatal("Could not receive response from management server");
+        mgmt_close_connection(sock);
+        exit(1);
+    }
+    if (response.success) {
+        printf("✓ %s\n", response.message);
     } else {
         printf("✗ %s\n", response.message);
     }
-    
+    mgmt_close_connection(sock);
+}
+
+static void set_max_connections(char* spec) {
+    // USER:N
+    char* number = strchr(spec, ':');
+    char* end = NULL;
+    unsigned long max_connections = 0;
+    if (number != NULL) {
+        *number++ = '\0';
+        errno = 0;
+        max_connections = strtoul(number, &end, 10);
+    }
+    if (number == NULL || spec[0] == '\0' || end == number || *end != '\0' || errno != 0 ||
+        max_connections > UINT32_MAX) {
+        log_fatal("Invalid format for max connections. Use user:connections (0 = unlimited)");
+        exit(1);
+    }
+
+    int sock = mgmt_connect_to_server();
+    if (sock < 0) {
+        log_fatal("Could not connect to management server at %s:%d", "127.0.0.1", 8080);
+        exit(1);
+    }
+    if (mgmt_send_paged_command(sock, CMD_SET_MAX_CONNECTIONS, spec, NULL, 0, (uint32_t)max_connections) < 0) {
+        log_fatal("Could not send command to management server");
+        mgmt_close_connection(sock);
+        exit(1);
+    }
+    mgmt_simple_response_t response;
+    if (mgmt_receive_simple_response(sock, &response) < 0) {
+        log_fatal("Could not receive response from management server");
+        mgmt_close_connection(sock);
+        exit(1);
+    }
+    if (response.success) {
+        printf("✓ %s\n", response.message);
+    } else {
+        printf("✗ %s\n", response.message);
+    }
+    mgmt_close_connection(sock);
+}
+
+// Pide una página de usuarios por conexión; con limit 0 recorre todas
+void list_users(uint32_t offset, uint32_t limit) {
+    static user_t users[MGMT_USERS_PAGE_MAX];
+    bool header = false;
+    uint32_t shown = 0;
+
+    while (limit == 0 || shown < limit) {
+        int sock = mgmt_connect_to_server();
+        if (sock < 0) {
+            log_fatal("Could not connect to management server at %s:%d", "127.0.0.1", 8080);
+            exit(1);
+        }
+
+        uint32_t page = MGMT_USERS_PAGE_MAX;
+        if (limit != 0 && limit - shown < page) {
+            page = limit - shown;
+        }
+        if (mgmt_send_paged_command(sock, CMD_LIST_USERS, NULL, NULL, offset + shown, page) < 0) {
+            log_fatal("Could not send command to management server");
+            mgmt_close_connection(sock);
+            exit(1);
+        }
+
+        mgmt_users_response_t response;
+        if (mgmt_receive_users_response(sock, &response, users, MGMT_USERS_PAGE_MAX) < 0) {
+            log_fatal("Could not receive response from management server");
+            mgmt_close_connection(sock);
+            exit(1);
+        }
+        mgmt_close_connection(sock);
+
+        if (!response.success) {
+            printf("✗ %s\n", response.message);
+            return;
+        }
+        if (!header) {
+            printf("Configured users (%u):\n", response.total);
+            if (response.total == 0) {
+                printf("  (No users configured)\n");
+            }
+            header = true;
+        }
+        for (uint32_t i = 0; i < response.count; i++) {
+            printf("  • %s%s", users[i].username,
+                   users[i].active == USER_ACTIVE_STATIC ? " (command line)" : "");
+            if (users[i].upload_limit != 0 || users[i].download_limit != 0) {
+                char up[40], down[40];
+                format_limit(users[i].upload_limit, up, sizeof(up));
+                format_limit(users[i].download_limit, down, sizeof(down));
+                printf("  [up %s, down %s]", up, down);
+            }
+            if (users[i].max_connections != 0) {
+                printf("  [max %u connections]", users[i].max_connections);
+            }
+            printf("\n");
+        }
+        shown += response.count;
+        if (response.count == 0 || offset + shown >= response.total) {
+            break;
+        }
+    }
+}
+
+static void print_rates(const traffic_rates_t* rates) {
+    printf("  • Throughput: %.1f / %.1f / %.1f KiB/s\n",
+           rates->bytes_1s / 1024.0, rates->bytes_10s / 1024.0, rates->bytes_60s / 1024.0);
+    printf("  • New connections: %.2f / %.2f / %.2f conn/s\n",
+           rates->connections_1s, rates->connections_10s, rates->connections_60s);
+}
+
+static void print_leg(const char* label, const tcp_leg_stats_t* leg) {
+    if (leg->samples == 0) {
+        printf("  • %s: no samples\n", label);
+        return;
+    }
+    printf("  • %s: rtt %.2f ms (var %.2f), cwnd %.0f, delivery %.1f MiB/s, %llu retransmits (%llu samples)\n",
+           label, leg->rtt_us / 1000.0, leg->rttvar_us / 1000.0, leg->snd_cwnd,
+           leg->delivery_rate / (1024.0 * 1024.0), (unsigned long long)leg->retransmits,
+           (unsigned long long)leg->samples);
+}
+
+// RTT suavizado en ms, o "-" si la pata no tiene muestras
+static void format_rtt(const tcp_leg_stats_t* leg, char* out, size_t out_len) {
+    if (leg->samples == 0) {
+        snprintf(out, out_len, "-");
+    } else {
+        snprintf(out, out_len, "%.2f", leg->rtt_us / 1000.0);
+    }
+}
+
+// Tasas por usuario: se obtienen de la lista de usuarios (CMD_LIST_USERS)
+static void show_user_rates(void) {
+    int sock = mgmt_connect_to_server();
+    if (sock < 0) {
+        return;
+    }
+
+    // Solo la primera página: con miles de usuarios el resto se ve con -l
+    static user_t users[MGMT_USERS_PAGE_MAX];
+    mgmt_users_response_t response;
+    if (mgmt_send_paged_command(sock, CMD_LIST_USERS, NULL, NULL, 0, MGMT_USERS_PAGE_MAX) < 0 ||
+        mgmt_receive_users_response(sock, &response, users, MGMT_USERS_PAGE_MAX) < 0 || !response.success) {
+        mgmt_close_connection(sock);
+        return;
+    }
+
+    if (response.count > 0) {
+        printf("\n👤 PER-USER RATES (1s / 10s / 60s):\n");
+    }
+    for (uint32_t i = 0; i < response.count; i++) {
+        const user_t* user = &users[i];
+        const traffic_rates_t* rates = &user->stats.rates;
+        printf("  • %-16s %8.1f / %8.1f / %8.1f KiB/s  %6.2f / %6.2f / %6.2f conn/s  (%llu active)\n",
+               user->username,
+               rates->bytes_1s / 1024.0, rates->bytes_10s / 1024.0, rates->bytes_60s / 1024.0,
+               rates->connections_1s, rates->connections_10s, rates->connections_60s,
+               (unsigned long long)user->stats.current_connections);
+        if (user->stats.path.client.samples > 0 || user->stats.path.remote.samples > 0) {
+            char client_rtt[16], remote_rtt[16];
+            format_rtt(&user->stats.path.client, client_rtt, sizeof(client_rtt));
+            format_rtt(&user->stats.path.remote, remote_rtt, sizeof(remote_rtt));
+            printf("    %-16s rtt client %s ms, upstream %s ms, retransmits %llu / %llu\n", "",
+                   client_rtt, remote_rtt,
+                   (unsigned long long)user->stats.path.client.retransmits,
+                   (unsigned long long)user->stats.path.remote.retransmits);
+        }
+    }
+    if (response.count < response.total) {
+        printf("  (%u more users not shown)\n", response.total - response.count);
+    }
+
     mgmt_close_connection(sock);
 }
 
@@ -206,6 +547,14 @@ void show_stats(void) {
             uint64_t avg_bytes = response.stats.total_bytes_transferred / response.stats.total_connections;
             printf("  • Average per connection: %llu bytes\n", (unsigned long long)avg_bytes);
         }
+
+        printf("\n📈 CURRENT RATES (1s / 10s / 60s):\n");
+        print_rates(&response.stats.rates);
+
+        printf("\n🌐 TCP PATHS (sampled TCP_INFO):\n");
+        print_leg("Client leg", &response.stats.path.client);
+        print_leg("Upstream leg", &response.stats.path.remote);
+        show_user_rates();
         
         printf("\n═══════════════════════════════════════════════════════════════\n");
     } else {
@@ -215,6 +564,83 @@ void show_stats(void) {
     mgmt_close_connection(sock);
 }
 
+static void print_duration_ns(const char* label, uint64_t ns) {
+    if (ns >= 1000000000ull) {
+        printf("%s%.2f s\n", label, ns / 1e9);
+    } else if (ns >= 1000000ull) {
+        printf("%s%.2f ms\n", label, ns / 1e6);
+    } else {
+        printf("%s%.1f us\n", label, ns / 1e3);
+    }
+}
+
+static void show_loop_stats(void) {
+    int sock = mgmt_connect_to_server();
+    if (sock < 0) {
+        log_fatal("Could not connect to management server at %s:%d", "127.0.0.1", 8080);
+        exit(1);
+    }
+
+    if (mgmt_send_command(sock, CMD_LOOP_STATS, NULL, NULL) < 0) {
+        log_fatal("Could not send command to management server");
+        mgmt_close_connection(sock);
+        exit(1);
+    }
+
+    mgmt_loop_stats_response_t response;
+    if (mgmt_receive_loop_stats_response(sock, &response) < 0) {
+        log_fatal("Could not receive response from management server");
+        mgmt_close_connection(sock);
+        exit(1);
+    }
+    mgmt_close_connection(sock);
+
+    if (!response.success) {
+        printf("✗ %s\n", response.message);
+        return;
+    }
+
+    const loop_stats_t* loop = &response.loop;
+    uint64_t total_ns = loop->busy_ns + loop->wait_ns;
+    printf("⏱  EVENT LOOP PROFILE:\n");
+    printf("  • Utilization: %.1f%% (last 1s), %.1f%% (60s avg)\n",
+           loop->utilization * 100.0, loop->utilization_60s * 100.0);
+    print_duration_ns("  • Blocked in select: ", loop->wait_ns);
+    print_duration_ns("  • Busy: ", loop->busy_ns);
+    printf("  • Wakeups: %llu, ready events: %llu (avg %.2f, max %u)\n",
+           (unsigned long long)loop->wakeups, (unsigned long long)loop->ready_events,
+           loop->wakeups > 0 ? (double)loop->ready_events / (double)loop->wakeups : 0.0,
+           loop->max_ready_events);
+    print_duration_ns("  • Longest handler (last 1s): ", loop->interval_max_handler_ns);
+    printf("  • Longest handler (ever): %s, ", loop_handler_name((loop_handler_t)loop->max_handler_class));
+    print_duration_ns("", loop->max_handler_ns);
+
+    printf("\n  %-12s %12s %12s %10s %8s\n", "handler", "calls", "total(ms)", "avg(us)", "share");
+    for (int h = 0; h < LOOP_HANDLER_COUNT; h++) {
+        uint64_t calls = loop->handler_calls[h];
+        uint64_t ns = loop->handler_ns[h];
+        printf("  %-12s %12llu %12.2f %10.2f %7.2f%%\n", loop_handler_name((loop_handler_t)h),
+               (unsigned long long)calls, ns / 1e6, calls > 0 ? ns / 1e3 / calls : 0.0,
+               total_ns > 0 ? ns * 100.0 / total_ns : 0.0);
+    }
+
+    const loop_watchdog_stats_t* wd = &response.watchdog;
+    if (wd->threshold_ms == 0) {
+        printf("\n  Watchdog: disabled\n");
+        return;
+    }
+    printf("\n  Watchdog (threshold %u ms): %llu stalls%s\n", wd->threshold_ms,
+           (unsigned long long)wd->stalls, wd->stalled_now ? ", STALLED NOW" : "");
+    if (wd->stalls > 0) {
+        print_duration_ns("  • Total stalled: ", wd->stall_ns_total);
+        print_duration_ns("  • Longest stall: ", wd->max_stall_ns);
+        printf("  • Last stall: %s handler, connection %llu, %.1fs ago, ",
+               loop_handler_name((loop_handler_t)wd->last_handler),
+               (unsigned long long)wd->last_connection_id, wd->last_stall_ago_ms / 1000.0);
+        print_duration_ns("", wd->last_stall_ns);
+    }
+}
+
 // Nuevas operaciones de configuración
 static void set_timeout(const char* ms_str) {
     int sock = mgmt_connect_to_server();
@@ -361,6 +787,35 @@ static void disable_dissectors(void) {
     mgmt_close_connection(sock);
 }
 
+static void rotate_logs(void) {
+    int sock = mgmt_connect_to_server();
+    if (sock < 0) {
+        log_fatal("Could not connect to management server at %s:%d", "127.0.0.1", 8080);
+        exit(1);
+    }
+
+    if (mgmt_send_command(sock, CMD_ROTATE_LOGS, NULL, NULL) < 0) {
+        log_fatal("Could not send command to management server");
+        mgmt_close_connection(sock);
+        exit(1);
+    }
+
+    mgmt_simple_response_t response;
+    if (mgmt_receive_simple_response(sock, &response) < 0) {
+        log_fatal("Could not receive response from management server");
+        mgmt_close_connection(sock);
+        exit(1);
+    }
+
+    if (response.success) {
+        printf("✓ %s\n", response.message);
+    } else {
+        printf("✗ %s\n", response.message);
+    }
+
+    mgmt_close_connection(sock);
+}
+
 static void reload_config(void) {
     int sock = mgmt_connect_to_server();
     if (sock < 0) {
@@ -428,6 +883,267 @@ static void show_config(void) {
     mgmt_close_connection(sock);
 }
 
+static void format_bytes(uint64_t bytes, char* out, size_t out_len) {
+    const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    double value = (double)bytes;
+    int unit = 0;
+    while (value >= 1024.0 && unit < 4) {
+        value /= 1024.0;
+        unit++;
+    }
+    snprintf(out, out_len, unit == 0 ? "%.0f %s" : "%.1f %s", value, units[unit]);
+}
+
+static void list_connections(const char* user_filter, const char* dest_filter,
+                             uint32_t offset, uint32_t limit) {
+    int sock = mgmt_connect_to_server();
+    if (sock < 0) {
+        log_fatal("Could not connect to management server at %s:%d", "127.0.0.1", 8080);
+        exit(1);
+    }
+
+    if (mgmt_send_paged_command(sock, CMD_LIST_CONNECTIONS, user_filter, dest_filter, offset, limit) < 0) {
+        log_fatal("Could not send command to management server");
+        mgmt_close_connection(sock);
+        exit(1);
+    }
+
+    mgmt_connections_response_t response;
+    static mgmt_connection_entry_t entries[MGMT_CONNECTIONS_PAGE_MAX];
+    if (mgmt_receive_connections_response(sock, &response, entries, MGMT_CONNECTIONS_PAGE_MAX) < 0) {
+        log_fatal("Could not receive response from management server");
+        mgmt_close_connection(sock);
+        exit(1);
+    }
+
+    if (!response.success) {
+        printf("✗ %s\n", response.message);
+        mgmt_close_connection(sock);
+        return;
+    }
+
+    printf("Live connections: %u matching, showing %u from offset %u\n",
+           response.total, response.count, response.offset);
+    if (response.count > 0) {
+        printf("%-8s %-28s %-12s %-32s %-10s %9s %9s %10s %10s %8s %10s %10s\n",
+               "ID", "CLIENT", "USER", "DESTINATION", "STATE", "AGE(s)", "IDLE(s)",
+               "UP", "DOWN", "PENDING", "C.RTT(ms)", "R.RTT(ms)");
+    }
+    for (uint32_t i = 0; i < response.count; i++) {
+        const mgmt_connection_entry_t* e = &entries[i];
+        char up[16], down[16];
+        format_bytes(e->bytes_to_remote, up, sizeof(up));
+        format_bytes(e->bytes_to_client, down, sizeof(down));
+        char client_rtt[16] = "-", remote_rtt[16] = "-";
+        if (e->client_tcp.valid) {
+            snprintf(client_rtt, sizeof(client_rtt), "%.2f", e->client_tcp.rtt_us / 1000.0);
+        }
+        if (e->remote_tcp.valid) {
+            snprintf(remote_rtt, sizeof(remote_rtt), "%.2f", e->remote_tcp.rtt_us / 1000.0);
+        }
+        printf("%-8llu %-28s %-12s %-32s %-10s %9.1f %9.1f %10s %10s %8u %10s %10s\n",
+               (unsigned long long)e->connection_id, e->client_address,
+               e->username[0] ? e->username : "-",
+               e->destination[0] ? e->destination : "-",
+               e->state, e->age_ms / 1000.0, e->idle_ms / 1000.0, up, down,
+               e->pending_to_remote + e->pending_to_client, client_rtt, remote_rtt);
+    }
+    if (response.offset + response.count < response.total) {
+        printf("(more results: use --offset %u)\n", response.offset + response.count);
+    }
+
+    mgmt_close_connection(sock);
+}
+
+static void show_paths(uint32_t limit) {
+    int sock = mgmt_connect_to_server();
+    if (sock < 0) {
+        log_fatal("Could not connect to management server at %s:%d", "127.0.0.1", 8080);
+        exit(1);
+    }
+
+    if (mgmt_send_paged_command(sock, CMD_PATH_STATS, NULL, NULL, 0, limit) < 0) {
+        log_fatal("Could not send command to management server");
+        mgmt_close_connection(sock);
+        exit(1);
+    }
+
+    mgmt_paths_response_t response;
+    static mgmt_path_entry_t entries[PATH_STATS_MAX_DESTINATIONS];
+    if (mgmt_receive_paths_response(sock, &response, entries, PATH_STATS_MAX_DESTINATIONS) < 0) {
+        log_fatal("Could not receive response from management server");
+        mgmt_close_connection(sock);
+        exit(1);
+    }
+    mgmt_close_connection(sock);
+
+    if (!response.success) {
+        printf("✗ %s\n", response.message);
+        return;
+    }
+
+    printf("🌐 TCP PATHS (sampled TCP_INFO):\n");
+    print_leg("Client leg", &response.global.client);
+    print_leg("Upstream leg", &response.global.remote);
+
+    printf("\nDestinations: %u tracked, showing %u\n", response.total, response.count);
+    if (response.count > 0) {
+        printf("%-32s %8s %10s %10s %10s %10s %12s %9s\n", "DESTINATION", "SAMPLES", "C.RTT(ms)",
+               "R.RTT(ms)", "R.VAR(ms)", "R.RETRANS", "R.RATE", "IDLE(s)");
+    }
+    for (uint32_t i = 0; i < response.count; i++) {
+        const mgmt_path_entry_t* e = &entries[i];
+        char client_rtt[16], remote_rtt[16], remote_var[16] = "-", rate[16] = "-";
+        format_rtt(&e->path.client, client_rtt, sizeof(client_rtt));
+        format_rtt(&e->path.remote, remote_rtt, sizeof(remote_rtt));
+        if (e->path.remote.samples > 0) {
+            snprintf(remote_var, sizeof(remote_var), "%.2f", e->path.remote.rttvar_us / 1000.0);
+            format_bytes((uint64_t)e->path.remote.delivery_rate, rate, sizeof(rate));
+            strncat(rate, "/s", sizeof(rate) - strlen(rate) - 1);
+        }
+        printf("%-32s %8llu %10s %10s %10s %10llu %12s %9.1f\n", e->destination,
+               (unsigned long long)e->path.remote.samples, client_rtt, remote_rtt, remote_var,
+               (unsigned long long)e->path.remote.retransmits, rate, e->idle_ms / 1000.0);
+    }
+}
+
+static void print_flight_event(const flight_event_t* e, uint64_t first_us) {
+    printf("   +%10.3fms  %-8s %-10s", (e->time_us - first_us) / 1000.0,
+           flight_event_name((flight_event_type_t)e->type), conn_state_name((conn_state_t)e->state));
+    switch (e->type) {
+        case FLIGHT_STATE:
+            printf(" from %s", conn_state_name((conn_state_t)e->result));
+            break;
+        case FLIGHT_RECV:
+        case FLIGHT_SEND:
+            printf(" %-6s %lld", e->leg == FLIGHT_LEG_REMOTE ? "remote" : "client", (long long)e->result);
+            break;
+        case FLIGHT_ACCEPT:
+        case FLIGHT_CONNECT:
+            printf(" fd=%lld", (long long)e->result);
+            break;
+        default:
+            break;
+    }
+    if (e->err != 0) {
+        printf(" errno=%d (%s)", e->err, strerror(e->err));
+    }
+    printf("\n");
+}
+
+static void show_flight(const char* target) {
+    uint64_t connection_id = 0;
+    const char* user = NULL;
+    bool numeric = target[0] != '\0';
+    for (const char* p = target; *p; p++) {
+        if (!isdigit((unsigned char)*p)) numeric = false;
+    }
+    if (numeric) {
+        connection_id = strtoull(target, NULL, 10);
+    } else if (strcmp(target, "failed") != 0) {
+        user = target;
+    }
+
+    int sock = mgmt_connect_to_server();
+    if (sock < 0) {
+        log_fatal("Could not connect to management server at %s:%d", "127.0.0.1", 8080);
+        exit(1);
+    }
+
+    if (mgmt_send_flight_command(sock, user, connection_id, MGMT_FLIGHT_MAX) < 0) {
+        log_fatal("Could not send command to management server");
+        mgmt_close_connection(sock);
+        exit(1);
+    }
+
+    mgmt_flight_response_t response;
+    static flight_record_t records[MGMT_FLIGHT_MAX];
+    if (mgmt_receive_flight_response(sock, &response, records, MGMT_FLIGHT_MAX) < 0) {
+        log_fatal("Could not receive response from management server");
+        mgmt_close_connection(sock);
+        exit(1);
+    }
+    mgmt_close_connection(sock);
+
+    printf("%s %s\n", response.success ? "✓" : "✗", response.message);
+    for (uint32_t i = 0; i < response.count; i++) {
+        const flight_record_t* r = &records[i];
+        printf("\n#%llu user=%s dest=%s ", (unsigned long long)r->connection_id,
+               r->username[0] ? r->username : "-", r->destination[0] ? r->destination : "-");
+        if (r->live) {
+            printf("[live]");
+        } else {
+            printf("[closed %.1fs ago%s%s]", r->closed_ago_ms / 1000.0,
+                   r->failed ? ", error: " : "", r->failed ? r->close_reason : "");
+        }
+        printf(" events %u of %llu\n", r->event_count, (unsigned long long)r->event_total);
+        uint64_t first_us = r->event_count > 0 ? r->events[0].time_us : 0;
+        for (uint32_t e = 0; e < r->event_count; e++) {
+            print_flight_event(&r->events[e], first_us);
+        }
+    }
+}
+
+static void print_stage_ms(const char* name, uint32_t us) {
+    printf("  %s %.3fms", name, us / 1000.0);
+}
+
+static void show_slow_handshakes(uint32_t limit) {
+    int sock = mgmt_connect_to_server();
+    if (sock < 0) {
+        log_fatal("Could not connect to management server at %s:%d", "127.0.0.1", 8080);
+        exit(1);
+    }
+
+    if (mgmt_send_paged_command(sock, CMD_SLOW_HANDSHAKES, NULL, NULL, 0, limit) < 0) {
+        log_fatal("Could not send command to management server");
+        mgmt_close_connection(sock);
+        exit(1);
+    }
+
+    mgmt_slow_handshakes_response_t response;
+    static slow_handshake_t entries[MGMT_SLOW_HANDSHAKES_MAX];
+    if (mgmt_receive_slow_handshakes_response(sock, &response, entries, MGMT_SLOW_HANDSHAKES_MAX) < 0) {
+        log_fatal("Could not receive response from management server");
+        mgmt_close_connection(sock);
+        exit(1);
+    }
+    mgmt_close_connection(sock);
+
+    printf("%s %s\n", response.success ? "✓" : "✗", response.message);
+    for (uint32_t i = 0; i < response.count; i++) {
+        const slow_handshake_t* e = &entries[i];
+        const handshake_timing_t* t = &e->timing;
+        printf("\n#%llu user=%s dest=%s [%s, %.1fs ago] total %.3fms\n",
+               (unsigned long long)e->connection_id, e->username[0] ? e->username : "-",
+               e->destination[0] ? e->destination : "-", e->failed ? "failed" : "ok",
+               e->ago_ms / 1000.0, t->total_us / 1000.0);
+        print_stage_ms("greeting", t->greeting_us);
+        print_stage_ms("auth", t->auth_us);
+        printf(" (validate %.3fms)", t->validate_us / 1000.0);
+        print_stage_ms("request", t->request_us);
+        print_stage_ms("dns", t->dns_us);
+        printf("\n ");
+        for (uint32_t a = 0; a < t->connect_attempts && a < SLOW_HANDSHAKE_MAX_ATTEMPTS; a++) {
+            char name[24];
+            snprintf(name, sizeof(name), "connect#%u", a + 1);
+            print_stage_ms(name, t->connect_us[a]);
+        }
+        if (t->connect_attempts > SLOW_HANDSHAKE_MAX_ATTEMPTS) {
+            printf("  (+%u attempts)", t->connect_attempts - SLOW_HANDSHAKE_MAX_ATTEMPTS);
+        }
+        print_stage_ms("reply", t->reply_us);
+        printf("\n");
+    }
+}
+
+enum {
+    OPT_FILTER_USER = 256,
+    OPT_FILTER_DEST,
+    OPT_OFFSET,
+    OPT_LIMIT,
+};
+
 int main(int argc, char *argv[]) {
     logger_init(LOG_INFO, NULL); // Using stderr for client messages
     int option;
@@ -435,6 +1151,9 @@ int main(int argc, char *argv[]) {
         {"help",      no_argument,       0, 'h'},
         {"add-user",  required_argument, 0, 'u'},
         {"del-user",  required_argument, 0, 'd'},
+        {"batch",     required_argument, 0, 'B'},
+        {"bandwidth", required_argument, 0, 'W'},
+        {"max-connections", required_argument, 0, 'M'},
         {"list-users", no_argument,      0, 'l'},
         {"stats",     no_argument,       0, 's'},
         {"version",   no_argument,       0, 'v'},
@@ -445,15 +1164,35 @@ int main(int argc, char *argv[]) {
         {"disable-dissectors", no_argument, 0, 'x'},
         {"reload-config", no_argument, 0, 'r'},
         {"config", no_argument, 0, 'c'},
+        {"connections", no_argument, 0, 'C'},
+        {"loop-stats", no_argument, 0, 'L'},
+        {"rotate-logs", no_argument, 0, 'R'},
+        {"flight", required_argument, 0, 'F'},
+        {"paths", no_argument, 0, 'p'},
+        {"slow-handshakes", no_argument, 0, 'S'},
+        {"filter-user", required_argument, 0, OPT_FILTER_USER},
+        {"filter-dest", required_argument, 0, OPT_FILTER_DEST},
+        {"offset", required_argument, 0, OPT_OFFSET},
+        {"limit", required_argument, 0, OPT_LIMIT},
         {0, 0, 0, 0}
     };
+    // Los filtros pueden venir en cualquier orden, así que el listado de
+    // conexiones se ejecuta después de procesar todas las opciones.
+    bool list_conns = false;
+    bool list_all_users = false;
+    bool list_paths = false;
+    bool list_slow = false;
+    const char* user_filter = NULL;
+    const char* dest_filter = NULL;
+    uint32_t offset = 0;
+    uint32_t limit = 0;
 
     if (argc == 1) {
         show_help(argv[0]);
         return 0;
     }
 
-    while ((option = getopt_long(argc, argv, "hu:d:lsvt:b:m:exrc", long_options, NULL)) != -1) {
+    while ((option = getopt_long(argc, argv, "hu:d:B:W:M:lsvt:b:m:exrcCLRF:pS", long_options, NULL)) != -1) {
         switch (option) {
             case 'h':
                 show_help(argv[0]);
@@ -464,8 +1203,17 @@ int main(int argc, char *argv[]) {
             case 'd':
                 delete_user(optarg);
                 break;
+            case 'B':
+                batch_users(optarg);
+                break;
+            case 'W':
+                set_bandwidth(optarg);
+                break;
+            case 'M':
+                set_max_connections(optarg);
+                break;
             case 'l':
-                list_users();
+                list_all_users = true;
                 break;
             case 's':
                 show_stats();
@@ -494,11 +1242,53 @@ int main(int argc, char *argv[]) {
             case 'r':
                 reload_config();
                 break;
+            case 'C':
+                list_conns = true;
+                break;
+            case 'L':
+                show_loop_stats();
+                break;
+            case 'R':
+                rotate_logs();
+                break;
+            case 'F':
+                show_flight(optarg);
+                break;
+            case 'p':
+                list_paths = true;
+                break;
+            case 'S':
+                list_slow = true;
+                break;
+            case OPT_FILTER_USER:
+                user_filter = optarg;
+                break;
+            case OPT_FILTER_DEST:
+                dest_filter = optarg;
+                break;
+            case OPT_OFFSET:
+                offset = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case OPT_LIMIT:
+                limit = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
             default:
                 log_fatal("Invalid option. Use -h for help.");
                 return 1;
         }
     }
+    if (list_all_users) {
+        list_users(offset, limit);
+    }
+    if (list_conns) {
+        list_connections(user_filter, dest_filter, offset, limit);
+    }
+    if (list_paths) {
+        show_paths(limit);
+    }
+    if (list_slow) {
+        show_slow_handshakes(limit);
+    }
     logger_close();
     return 0;
 }
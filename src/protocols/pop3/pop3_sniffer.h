@@ -4,6 +4,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#define POP3_CREDENTIALS_FILE "pop3_credentials.log"
+
 // Procesa datos interceptados en una conexión hacia un servidor POP3
 void pop3_sniffer_process(const uint8_t *data, size_t len, const char *ip_origen);
 
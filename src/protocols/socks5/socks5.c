@@ -18,6 +18,10 @@
 #include "../../utils/util.h"
 #include "../../shared.h"
 #include "../../utils/logger.h"
+#include "../../utils/access_log.h"
+#include "../../utils/conn_log.h"
+#include "../../utils/conn_quota.h"
+#include "../../utils/probes.h"
 #include "../pop3/pop3_sniffer.h"
 
 static void sockaddr_to_string(char *buffer, const struct sockaddr *addr) {
@@ -38,10 +42,6 @@ static void sockaddr_to_string(char *buffer, const struct sockaddr *addr) {
 #define CONNECTION_TIMEOUT_MS 10000  // 10 seconds timeout per connection attempt
 #define RETRY_DELAY_MS 100          // 100ms delay between attempts
 
-#define STATE_AUTH 1
-#define STATE_REQUEST 2
-#define STATE_DONE 3  // o el que necesites como estado final
-
 /**
  * Receives a full buffer of data from a socket, by receiving data until the requested amount
  * of bytes is reached. Returns the amount of bytes received, or -1 if receiving failed before
@@ -62,30 +62,30 @@ static ssize_t recvFull(int fd, void* buf, size_t n, int flags) {
                 int poll_result = poll(&pfd, 1, 5000); // 5 second timeout
                 
                 if (poll_result < 0) {
-                    log_error("poll() in recvFull: %s", strerror(errno));
+                    log_error_limited("poll() in recvFull: %s", strerror(errno));
                     return -1;
                 } else if (poll_result == 0) {
-                    log_error("recv() timeout after 5 seconds");
+                    log_error_limited("recv() timeout after 5 seconds");
                     return -1;
                 } else if (pfd.revents & POLLIN) {
                     retries++;
                     continue; // Try recv again
                 } else {
-                    log_error("poll() unexpected event: %d", pfd.revents);
+                    log_error_limited("poll() unexpected event: %d", pfd.revents);
                     return -1;
                 }
             } else {
-                log_error("recv(): %s", strerror(errno));
+                log_error_limited("recv(): %s", strerror(errno));
                 return -1;
             }
         } else if (nowReceived == 0) {
             // Connection closed by peer
             if (totalReceived == 0) {
-                log_error("Connection closed by peer before any data received");
+                log_error_limited("Connection closed by peer before any data received");
                 return -1;
             } else {
                 // Partial data received before close - return what we got
-                log_warn("Connection closed by peer, partial data received: %zu/%zu bytes", 
+                log_warn_limited("Connection closed by peer, partial data received: %zu/%zu bytes", 
                        totalReceived, n);
                 return totalReceived;
             }
@@ -96,7 +96,7 @@ static ssize_t recvFull(int fd, void* buf, size_t n, int flags) {
     }
 
     if (retries >= maxRetries) {
-        log_error("recvFull() exceeded maximum retries");
+        log_error_limited("recvFull() exceeded maximum retries");
         return -1;
     }
 
@@ -123,24 +123,24 @@ static ssize_t sendFull(int fd, const void* buf, size_t n, int flags) {
                 int poll_result = poll(&pfd, 1, 5000); // timeout de 5 segs
                 
                 if (poll_result < 0) {
-                    log_error("poll() in sendFull: %s", strerror(errno));
+                    log_error_limited("poll() in sendFull: %s", strerror(errno));
                     return -1;
                 } else if (poll_result == 0) {
-                    log_error("send() timeout after 5 seconds");
+                    log_error_limited("send() timeout after 5 seconds");
                     return -1;
                 } else if (pfd.revents & POLLOUT) {
                     retries++;
                     continue; // Reintentamos
                 } else {
-                    log_error("poll() unexpected event: %d", pfd.revents);
+                    log_error_limited("poll() unexpected event: %d", pfd.revents);
                     return -1;
                 }
             } else {
-                log_error("send(): %s", strerror(errno));
+                log_error_limited("send(): %s", strerror(errno));
                 return -1;
             }
         } else if (nowSent == 0) {
-            log_error("send() returned 0, connection may be closed");
+            log_error_limited("send() returned 0, connection may be closed");
             return -1;
         } else {
             totalSent += nowSent;
@@ -149,68 +149,21 @@ static ssize_t sendFull(int fd, const void* buf, size_t n, int flags) {
     }
 
     if (retries >= maxRetries) {
-        log_error("sendFull() exceeded maximum retries");
+        log_error_limited("sendFull() exceeded maximum retries");
         return -1;
     }
 
     return totalSent;
 }
 
+// auth.db, los usuarios de management y los -u (ya cargados en el índice por
+// main) se validan con una sola búsqueda en memoria
 int validateUser(const char* username, const char* password, struct socks5args* args) {
+    (void)args;
     if (!username || !password) {
         return 0;
     }
-
-    // 1) Verificamos usuarios desde el archivo auth.db
-    FILE* file = fopen("auth.db", "r");
-    if (file != NULL) {
-        char line[512];
-        while (fgets(line, sizeof(line), file)) {
-            char* db_user = strtok(line, ":");
-            char* db_pass = strtok(NULL, "\n");
-            if (db_user && db_pass) {
-                if (strcmp(username, db_user) == 0 && strcmp(password, db_pass) == 0) {
-                    fclose(file);
-                    log_access(username, "AUTH_SUCCESS", "User authenticated successfully");
-                    return 1;
-                }
-            }
-        }
-        fclose(file);
-    }
-
-    // 2) Verificamos usuarios cargados dinámicamente en memoria compartida
-    shared_data_t* sh = mgmt_get_shared_data();
-    if (sh) {
-        pthread_mutex_lock(&sh->users_mutex);
-        for (int i = 0; i < sh->user_count; i++) {
-            if (sh->users[i].active &&
-                strcmp(username, sh->users[i].username) == 0 &&
-                strcmp(password, sh->users[i].password) == 0) {
-                pthread_mutex_unlock(&sh->users_mutex);
-                log_access(username, "AUTH_SUCCESS", "User authenticated successfully (shared)");
-                return 1;
-            }
-        }
-        pthread_mutex_unlock(&sh->users_mutex);
-    }
-
-    // 3) Verificamos usuarios provistos por línea de comandos (args)
-    if (args) {
-        for (int i = 0; i < MAX_USERS; i++) {
-            if (args->users[i].name && args->users[i].pass &&
-                args->users[i].name[0] != '\0' && args->users[i].pass[0] != '\0') {
-                if (strcmp(username, args->users[i].name) == 0 &&
-                    strcmp(password, args->users[i].pass) == 0) {
-                    log_access(username, "AUTH_SUCCESS", "User authenticated successfully (args)");
-                    return 1;
-                }
-            }
-        }
-    }
-
-    log_access(username, "AUTH_FAIL", "Authentication failed for user");
-    return 0;
+    return mgmt_check_credentials(username, password) ? 1 : 0;
 }
 
 int handleUsernamePasswordAuth(int clientSocket, struct socks5args* args, char* authenticated_user) {
@@ -275,6 +228,7 @@ int handleUsernamePasswordAuth(int clientSocket, struct socks5args* args, char*
     log_info("Authentication attempt: username='%s'", username);
     
     if (validateUser(username, password, args)) {
+        log_access(username, "AUTH_SUCCESS", "User authenticated successfully");
         if (authenticated_user) {
             strncpy(authenticated_user, username, MAX_USERNAME_LEN - 1);
             authenticated_user[MAX_USERNAME_LEN - 1] = '\0';
@@ -287,6 +241,7 @@ int handleUsernamePasswordAuth(int clientSocket, struct socks5args* args, char*
         return 0;
     } else {
         // Fallo
+        log_access(username, "AUTH_FAIL", "Authentication failed for user");
         if (sendFull(clientSocket, "\x01\x01", 2, 0) < 0) {
             log_error("Failed to send auth failure response");
         }
@@ -354,36 +309,18 @@ int handleAuthNegotiation(int clientSocket, struct socks5args* args, char* authe
     int hasUserPass = 0;
     int hasUsersConfigured = 0;
     
-    log_info("Client specified auth methods: ");
+    log_debug("Client specified auth methods: ");
     for (int i = 0; i < nmethods; i++) {
         if (receiveBuffer[i] == SOCKS5_AUTH_NONE) {
             hasNoAuth = 1;
         } else if (receiveBuffer[i] == SOCKS5_AUTH_USERPASS) {
             hasUserPass = 1;
         }
-        log_info("%02x%s", receiveBuffer[i], i + 1 == nmethods ? "\n" : ", ");
+        log_debug("%02x%s", receiveBuffer[i], i + 1 == nmethods ? "\n" : ", ");
     }
     
-    // Chequeamos si tenemos usuarios configurados en args
-    if (args) {
-        for (int i = 0; i < MAX_USERS && !hasUsersConfigured; i++) {
-            if (args->users[i].name && args->users[i].pass &&
-                args->users[i].name[0] != '\0' && args->users[i].pass[0] != '\0') {
-                hasUsersConfigured = 1;
-            }
-        }
-    }
-    // Si no encontramos, chequeamos memoria compartida
-    if (!hasUsersConfigured) {
-        shared_data_t* sh = mgmt_get_shared_data();
-        if (sh) {
-            pthread_mutex_lock(&sh->users_mutex);
-            for (int i = 0; i < sh->user_count; i++) {
-                if (sh->users[i].active) { hasUsersConfigured = 1; break; }
-            }
-            pthread_mutex_unlock(&sh->users_mutex);
-        }
-    }
+    // Usuarios de la línea de comandos, auth.db y management están en el mismo índice
+    hasUsersConfigured = mgmt_has_users();
     
     if (hasUsersConfigured) {
         // Los usuarios estan configurados, requerimos autenticacion por nombre de usuario y contraseña
@@ -604,10 +541,10 @@ static int connect_with_timeout(int sock, const struct sockaddr* addr, socklen_t
     
     int poll_result = poll(&pfd, 1, timeout_ms);
     if (poll_result < 0) {
-        log_error("connect_with_timeout failed: %s", strerror(errno));
+        log_error_limited("connect_with_timeout failed: %s", strerror(errno));
         return -1;  // error
     } else if (poll_result == 0) {
-        log_error("connect_with_timeout timed out after %dms", timeout_ms);
+        log_error_limited("connect_with_timeout timed out after %dms", timeout_ms);
         return 0;   // timeout
     }
     
@@ -615,7 +552,7 @@ static int connect_with_timeout(int sock, const struct sockaddr* addr, socklen_t
     int error = 0;
     socklen_t error_len = sizeof(error);
     if (getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &error_len) < 0) {
-        log_error("getsockopt failed: %s", strerror(errno));
+        log_error_limited("getsockopt failed: %s", strerror(errno));
         return -1;
     }
     
@@ -692,13 +629,13 @@ int handleConnectAndReply(int clientSocket, struct addrinfo** connectAddresses,
     for (struct addrinfo* aip = *connectAddresses; aip != NULL; aip = aip->ai_next) {
         char flags_buffer[128];
         printFlags(aip, flags_buffer, sizeof(flags_buffer));
-        log_info("Option %i: %s (%s %s) %s %s (Flags:%s)", aipIndex++, printFamily(aip), printType(aip), printProtocol(aip), aip->ai_canonname ? aip->ai_canonname : "-", printAddressPort(aip, addrBuf), flags_buffer);
+        log_debug("Option %i: %s (%s %s) %s %s (Flags:%s)", aipIndex++, printFamily(aip), printType(aip), printProtocol(aip), aip->ai_canonname ? aip->ai_canonname : "-", printAddressPort(aip, addrBuf), flags_buffer);
         total_addresses++;
         if (aip->ai_family == AF_INET) ipv4_count++;
         else if (aip->ai_family == AF_INET6) ipv6_count++;
     }
     
-    log_info("Attempting to connect to %d addresses (%d IPv4, %d IPv6)", 
+    log_debug("Attempting to connect to %d addresses (%d IPv4, %d IPv6)", 
            total_addresses, ipv4_count, ipv6_count);
 
     // Primero intentamos IPv6, luego IPv4
@@ -712,7 +649,7 @@ int handleConnectAndReply(int clientSocket, struct addrinfo** connectAddresses,
         if (addr->ai_family != AF_INET6) continue;
         
         attempt++;
-        log_info("Attempt %d/%d: Trying IPv6 %s", attempt, total_addresses, printAddressPort(addr, addrBuffer));
+        log_debug("Attempt %d/%d: Trying IPv6 %s", attempt, total_addresses, printAddressPort(addr, addrBuffer));
         
         sock = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
         if (sock < 0) {
@@ -752,7 +689,7 @@ int handleConnectAndReply(int clientSocket, struct addrinfo** connectAddresses,
             if (addr->ai_family != AF_INET) continue;
             
             attempt++;
-            log_info("Attempt %d/%d: Trying IPv4 %s", attempt, total_addresses, printAddressPort(addr, addrBuffer));
+            log_debug("Attempt %d/%d: Trying IPv4 %s", attempt, total_addresses, printAddressPort(addr, addrBuffer));
             
             sock = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
             if (sock < 0) {
@@ -814,7 +751,7 @@ int handleConnectAndReply(int clientSocket, struct addrinfo** connectAddresses,
     socklen_t boundAddressLen = sizeof(boundAddress);
     if (getsockname(sock, (struct sockaddr*)&boundAddress, &boundAddressLen) >= 0) {
         printSocketAddress((struct sockaddr*)&boundAddress, addrBuffer);
-        log_info("Remote socket bound at %s", addrBuffer);
+        log_debug("Remote socket bound at %s", addrBuffer);
     } else
         log_warn("Failed to getsockname() for remote socket");
 
@@ -904,7 +841,7 @@ int handleConnectionData(int clientSocket, int remoteSocket, const char* authent
                             inet_ntop(AF_INET6, &((struct sockaddr_in6*)&clientAddr)->sin6_addr, ip_origen, sizeof(ip_origen));
                         }
                     }
-                    printf("[POP3 SNIFFER] Processing %zd bytes from %s\n", received, ip_origen);
+                    log_debug("[POP3 SNIFFER] Processing %zd bytes from %s", received, ip_origen);
                     pop3_sniffer_process((const uint8_t*)receiveBuffer, received, ip_origen);
                 }
                 // [FIN PATCH POP3 SNIFFER]
@@ -925,16 +862,30 @@ int handleConnectionData(int clientSocket, int remoteSocket, const char* authent
     return 0;
 }
 
-int socks5_handle_greeting(int client_fd, struct socks5args *args, uint64_t connection_id) {
+// Evento del registro de accesos binario para la sesión
+static void record_access(access_record_type_t type, access_status_t status,
+                          const socks5_session_t *session, const char *username) {
+    access_event_t event = {
+        .type = type,
+        .status = status,
+        .connection_id = session->connection_id,
+        .username = username,
+        .destination = session->destination,
+    };
+    access_log_record(&event);
+}
+
+int socks5_handle_greeting(int client_fd, struct socks5args *args, socks5_session_t *session) {
+    uint64_t connection_id = session->connection_id;
     uint8_t buffer[BUFFER_SIZE];
     ssize_t n = recv(client_fd, buffer, sizeof(buffer), 0);
     if (n <= 0) {
-        log_error("Greeting failed (fd=%d, id=%llu): %s", client_fd, connection_id, n == 0 ? "closed" : strerror(errno));
+        log_error_limited("Greeting failed (fd=%d, id=%llu): %s", client_fd, connection_id, n == 0 ? "closed" : strerror(errno));
         return -1;
     }
 
     if (buffer[0] != 0x05) {
-        log_warn("Unsupported SOCKS version %d (fd=%d, id=%llu)", buffer[0], client_fd, connection_id);
+        log_warn_limited("Unsupported SOCKS version %d (fd=%d, id=%llu)", buffer[0], client_fd, connection_id);
         return -1; // SOCKS5
     }
 
@@ -944,49 +895,81 @@ int socks5_handle_greeting(int client_fd, struct socks5args *args, uint64_t conn
     return STATE_AUTH;
 }
 
-int socks5_handle_auth(int client_fd, struct socks5args *args, uint64_t connection_id) {
+int socks5_handle_auth(int client_fd, struct socks5args *args, socks5_session_t *session,
+                       socks5_credentials_t *pending) {
+    uint64_t connection_id = session->connection_id;
     uint8_t buffer[BUFFER_SIZE];
     ssize_t n = recv(client_fd, buffer, sizeof(buffer), 0);
     if (n <= 0) {
-        log_error("Auth failed (fd=%d, id=%llu): %s", client_fd, connection_id, n == 0 ? "closed" : strerror(errno));
+        log_error_limited("Auth failed (fd=%d, id=%llu): %s", client_fd, connection_id, n == 0 ? "closed" : strerror(errno));
         return -1;
     }
 
     if (buffer[0] != 0x01) {
-        log_warn("Unsupported auth version %d (fd=%d, id=%llu)", buffer[0], client_fd, connection_id);
+        log_warn_limited("Unsupported auth version %d (fd=%d, id=%llu)", buffer[0], client_fd, connection_id);
         return -1; // auth version
     }
 
     uint8_t ulen = buffer[1];
-    char user[256] = {0};
+    char *user = pending->username;
+    memset(user, 0, sizeof(pending->username));
     memcpy(user, &buffer[2], ulen);
 
     uint8_t plen = buffer[2 + ulen];
-    char pass[256] = {0};
+    char *pass = pending->password;
+    memset(pass, 0, sizeof(pending->password));
     memcpy(pass, &buffer[3 + ulen], plen);
 
-    log_info("Auth attempt for user '%s' (fd=%d, id=%llu)", user, client_fd, connection_id);
+    log_stage(connection_id, "Auth attempt for user '%s' (fd=%d, id=%llu)", user, client_fd, connection_id);
+
+    // Credencial verificada hace poco: se responde ya. Lo demás, incluso un
+    // usuario inexistente, necesita el KDF y el loop lo manda a los workers.
+    uint64_t validate_started = monotonicNanos();
+    int cached = mgmt_check_credentials_cached(user, pass);
+    session->timing.validate_us = (uint32_t)((monotonicNanos() - validate_started) / 1000);
+    if (cached < 0) {
+        return SOCKS5_AUTH_PENDING;
+    }
+    return socks5_finish_auth(client_fd, session, user, cached == 1);
+}
 
-    if (validateUser(user, pass, args)) {
+int socks5_finish_auth(int client_fd, socks5_session_t *session, const char *username, bool valid) {
+    if (valid && !conn_quota_acquire(username, mgmt_get_user_max_connections(username))) {
+        // RFC 1929 no tiene un código para esto: cualquier status distinto de
+        // 0 es falla y el cliente tiene que cerrar
+        log_warn_limited("User '%s' reached its connection limit (%u open, fd=%d, id=%llu)",
+                         username, conn_quota_count(username), client_fd, session->connection_id);
+        record_access(ACCESS_RECORD_AUTH, ACCESS_STATUS_FAIL, session, username);
+        uint8_t response[2] = {0x01, 0x01}; // failure
+        // El cliente pudo irse mientras se verificaba: sin SIGPIPE
+        send(client_fd, response, 2, MSG_NOSIGNAL);
+        return SOCKS5_AUTH_OVER_QUOTA;
+    }
+    if (valid) {
+        strncpy(session->username, username, MAX_USERNAME_LEN - 1);
+        session->username[MAX_USERNAME_LEN - 1] = '\0';
+        record_access(ACCESS_RECORD_AUTH, ACCESS_STATUS_OK, session, session->username);
         uint8_t response[2] = {0x01, 0x00}; // success
-        send(client_fd, response, 2, 0);
+        send(client_fd, response, 2, MSG_NOSIGNAL);
         return STATE_REQUEST;
     } else {
+        record_access(ACCESS_RECORD_AUTH, ACCESS_STATUS_FAIL, session, username);
         uint8_t response[2] = {0x01, 0x01}; // failure
-        send(client_fd, response, 2, 0);
-        return -1;
+        send(client_fd, response, 2, MSG_NOSIGNAL);
+        return SOCKS5_AUTH_REJECTED;
     }
 }
 
-int socks5_handle_request(int client_fd, struct socks5args *args, uint64_t connection_id, int *dest_port_out) {
+int socks5_handle_request(int client_fd, struct socks5args *args, socks5_session_t *session) {
+    uint64_t connection_id = session->connection_id;
     uint8_t header[4];
     if (recvFull(client_fd, header, sizeof(header), 0) < 0) {
-        log_error("Request header failed (fd=%d, id=%llu)", client_fd, connection_id);
+        log_error_limited("Request header failed (fd=%d, id=%llu)", client_fd, connection_id);
         return -1;
     }
 
     if (header[0] != 0x05 || header[1] != 0x01) {
-        log_warn("Unsupported request %d/%d (fd=%d, id=%llu)", header[0], header[1], client_fd, connection_id);
+        log_warn_limited("Unsupported request %d/%d (fd=%d, id=%llu)", header[0], header[1], client_fd, connection_id);
         send_socks5_reply(client_fd, REPLY_COMMAND_NOT_SUPPORTED);
         return -1;
     }
@@ -1019,11 +1002,11 @@ int socks5_handle_request(int client_fd, struct socks5args *args, uint64_t conne
         return -1;
     }
 
-    if (dest_port_out) {
-        *dest_port_out = dest_port;
-    }
+    session->dest_port = dest_port;
+    snprintf(session->destination, sizeof(session->destination), "%s:%d", dest_addr, dest_port);
+    session->timing.request_us = handshake_lap(&session->timing);
 
-    log_info("Client requested to connect to %s:%d (fd=%d, id=%llu)", dest_addr, dest_port, client_fd, connection_id);
+    log_stage(connection_id, "Client requested to connect to %s:%d (fd=%d, id=%llu)", dest_addr, dest_port, client_fd, connection_id);
 
     struct addrinfo hints = {0}, *res = NULL, *rp;
     hints.ai_family = AF_UNSPEC;
@@ -1031,10 +1014,15 @@ int socks5_handle_request(int client_fd, struct socks5args *args, uint64_t conne
     hints.ai_flags = AI_ADDRCONFIG;
     char port_str[6];
     snprintf(port_str, sizeof(port_str), "%d", dest_port);
+    PROBE2(dns_start, connection_id, dest_addr);
     int ga_status = getaddrinfo_with_timeout(dest_addr, port_str, &hints, &res, CONNECTION_TIMEOUT_MS);
+    PROBE2(dns_done, connection_id, ga_status);
+    session->timing.dns_us = handshake_lap(&session->timing);
     if (ga_status != 0) {
-        log_error("Failed to resolve address: %s (fd=%d, id=%llu): %s", dest_addr, client_fd, connection_id, gai_strerror(ga_status));
+        log_error_limited("Failed to resolve address: %s (fd=%d, id=%llu): %s", dest_addr, client_fd, connection_id, gai_strerror(ga_status));
+        record_access(ACCESS_RECORD_CONNECT, ACCESS_STATUS_FAIL, session, session->username);
         send_socks5_reply(client_fd, REPLY_HOST_UNREACHABLE);
+        session->timing.reply_us = handshake_lap(&session->timing);
         return -1;
     }
 
@@ -1044,7 +1032,10 @@ int socks5_handle_request(int client_fd, struct socks5args *args, uint64_t conne
         if (remote_fd < 0) {
             continue;
         }
+        PROBE2(connect_start, connection_id, rp->ai_family);
         int connected = connect_with_timeout(remote_fd, rp->ai_addr, rp->ai_addrlen, CONNECTION_TIMEOUT_MS);
+        PROBE3(connect_done, connection_id, connected == 1, connected == 1 ? 0 : errno);
+        handshake_connect_attempt(&session->timing);
         if (connected == 1) {
             break;
         }
@@ -1055,16 +1046,21 @@ int socks5_handle_request(int client_fd, struct socks5args *args, uint64_t conne
     freeaddrinfo(res);
 
     if (remote_fd < 0) {
-        log_error("Failed to connect to %s:%d (fd=%d, id=%llu) using all resolved addresses", dest_addr, dest_port, client_fd, connection_id);
+        log_error_limited("Failed to connect to %s:%d (fd=%d, id=%llu) using all resolved addresses", dest_addr, dest_port, client_fd, connection_id);
+        record_access(ACCESS_RECORD_CONNECT, ACCESS_STATUS_FAIL, session, session->username);
         send_socks5_reply(client_fd, REPLY_CONNECTION_REFUSED);
+        session->timing.reply_us = handshake_lap(&session->timing);
         return -1;
     }
 
-    log_info("Successfully connected to %s:%d (fd=%d, id=%llu)", dest_addr, dest_port, client_fd, connection_id);
+    log_stage(connection_id, "Successfully connected to %s:%d (fd=%d, id=%llu)", dest_addr, dest_port, client_fd, connection_id);
+    record_access(ACCESS_RECORD_CONNECT, ACCESS_STATUS_OK, session, session->username);
 
     uint8_t response[10] = {0x05, 0x00, 0x00, 0x01};
     memset(&response[4], 0, 6);
-    if (sendFull(client_fd, response, sizeof(response), 0) < 0) {
+    ssize_t replied = sendFull(client_fd, response, sizeof(response), 0);
+    session->timing.reply_us = handshake_lap(&session->timing);
+    if (replied < 0) {
         close(remote_fd);
         return -1;
     }
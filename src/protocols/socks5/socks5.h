@@ -9,7 +9,10 @@
 #define _SOCKS5_H_
 
 #include <netdb.h>
+#include <stdint.h>
 #include "../../utils/args.h"
+#include "../../shared.h"
+#include "../../utils/slow_handshake.h"
 
 struct addrinfo;
 
@@ -50,8 +53,55 @@ int handleRequest(int clientSocket, struct addrinfo** addressConnectTo, int* des
 int handleConnectAndReply(int clientSocket, struct addrinfo** addressConnectTo, int* remoteSocket);
 int handleConnectionData(int clientSocket, int remoteSocket, const char* authenticated_user, int dest_port, struct socks5args* args);
 
-int socks5_handle_greeting(int client_fd, struct socks5args *args, uint64_t connection_id);
-int socks5_handle_auth(int client_fd, struct socks5args *args, uint64_t connection_id);
-int socks5_handle_request(int client_fd, struct socks5args *args, uint64_t connection_id, int *dest_port);
+/**
+ * Datos de una conexión que el handshake va completando y que el loop de
+ * eventos necesita conocer una vez terminado cada paso.
+ */
+typedef struct {
+    uint64_t connection_id;
+    char username[MAX_USERNAME_LEN];                // usuario autenticado
+    char destination[MAX_DESTINATION_LEN];       // "host:puerto" pedido
+    int dest_port;
+    handshake_timing_t timing;                  // cronómetro por etapa del handshake
+} socks5_session_t;
+
+// Estado de una conexión en el loop de eventos. Los handlers del handshake
+// devuelven el siguiente.
+typedef enum {
+    STATE_GREETING,
+    STATE_AUTH,
+    STATE_AUTH_PENDING,     // credenciales en el pool de auth; no se lee al cliente
+    STATE_REQUEST,
+    STATE_CONNECTING,
+    STATE_RELAYING,
+    STATE_DONE,
+    STATE_ERROR
+} client_state;
+
+int socks5_handle_greeting(int client_fd, struct socks5args *args, socks5_session_t *session);
+// socks5_handle_auth: el cliente mandó credenciales inválidas (los demás
+// errores devuelven -1)
+#define SOCKS5_AUTH_REJECTED -2
+// socks5_handle_auth: verificar las credenciales necesita el KDF. Quedaron
+// en `pending' y la respuesta la manda socks5_finish_auth cuando se sepa.
+#define SOCKS5_AUTH_PENDING -3
+// socks5_finish_auth: credenciales válidas, pero el usuario ya tiene abiertas
+// todas las conexiones que le permite su máximo
+#define SOCKS5_AUTH_OVER_QUOTA -4
+
+typedef struct {
+    char username[256];
+    char password[256];
+} socks5_credentials_t;
+
+int socks5_handle_auth(int client_fd, struct socks5args *args, socks5_session_t *session,
+                       socks5_credentials_t *pending);
+/**
+ * Responde al pedido de autenticación; devuelve el próximo estado,
+ * SOCKS5_AUTH_REJECTED o SOCKS5_AUTH_OVER_QUOTA. Con éxito, la conexión queda
+ * contada en conn_quota y hay que descontarla al cerrar.
+ */
+int socks5_finish_auth(int client_fd, socks5_session_t *session, const char *username, bool valid);
+int socks5_handle_request(int client_fd, struct socks5args *args, socks5_session_t *session);
 
 #endif
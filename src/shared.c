@@ -10,9 +10,22 @@
 #include <sys/stat.h>
 #include <stdbool.h>
 #include <fcntl.h> // Para fcntl
+#include <limits.h>
+#include <ctype.h>
 #include <sys/socket.h> // Para fcntl
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 
 #include "utils/logger.h"
+#include "utils/conn_table.h"
+#include "utils/stats_shm.h"
+#include "utils/util.h"
+#include "utils/user_index.h"
+#include "utils/user_journal.h"
+#include "utils/rcu.h"
+#include "utils/file_watch.h"
+#include "utils/auth_cache.h"
 
 // Helpers para enviar/recibir todo el payload
 static int send_all(int sock, const void* buffer, size_t length) {
@@ -53,63 +66,983 @@ static pthread_mutex_t g_config_mutex = PTHREAD_MUTEX_INITIALIZER;
 // Puntero a datos compartidos
 static shared_data_t* g_shared_data = NULL;
 
-// Persistencia de usuarios en un archivo sencillo
+// Persistencia de usuarios: auth.db es la foto y el diario lleva los cambios
+// posteriores (ver utils/user_journal.h)
 #define USERS_PERSIST_FILE "auth.db"
+#define USERS_JOURNAL_FILE "auth.db.journal"
+#define USERS_JOURNAL_OLD_FILE "auth.db.journal.old"
+// Se compacta cuando el diario tiene más registros que usuarios la tabla,
+// así cada alta o baja paga en promedio O(1) de reescritura
+#define USERS_COMPACT_MIN_RECORDS 1024
+
+// Nombre -> user_t* de g_shared_data->users; protegido por users_mutex.
+// Es la tabla que modifican management y las estadísticas; auth.db se lee
+// al arrancar y al recargar, y después solo se escribe.
+static user_index_t g_user_index;
+
+// Versión publicada de g_user_index para autenticar sin lock: el loop la lee
+// dentro de una sección RCU (utils/rcu.h) y cada cambio publica una versión
+// nueva. Apunta a los mismos user_t que la tabla: el nombre y la clave de un
+// user_t no cambian después de publicado (un cambio de clave crea otro) y
+// los que se dan de baja se liberan recién pasado el período de gracia.
+typedef struct {
+    user_index_t index;
+} users_view_t;
+
+static users_view_t* g_users_view = NULL;
+
+// La versión que reemplazó la última publicación, ya sin lectores y al día
+// con la publicada. La próxima publicación la pone al día con los nombres
+// que cambiaron en vez de copiar el índice entero (unos 6 MB con 100k
+// usuarios): a cambio quedan dos versiones en memoria. NULL mientras corre
+// su período de gracia o si no se puede usar. Con users_mutex
+static users_view_t* g_users_spare = NULL;
+static uint64_t g_users_publications = 0;
+
+// Nombres que cambiaron en g_user_index: [0] entre las dos últimas
+// publicaciones (lo que le falta a la versión retirada) y [1] desde la
+// última. Pasado USERS_DELTA_MAX (una recarga
+// grande, la carga inicial) se marca `overflow' y se copia todo. Con
+// users_mutex
+#define USERS_DELTA_MAX 1024
+typedef struct {
+    char (*names)[MAX_USERNAME_LEN];
+    int count;
+    int capacity;
+    bool overflow;
+} users_delta_t;
+
+static users_delta_t g_users_delta[2];
+
+// user_t que la tabla ya no usa pero la versión publicada todavía puede
+// referenciar; con users_mutex
+static user_t** g_retired_users = NULL;
+static int g_retired_count = 0;
+static int g_retired_capacity = 0;
+
+// Usuarios cuyas tasas recalcula el timer: los que tuvieron tráfico y todavía
+// no decayeron a 0. Los demás no cambian, así que el tick no los recorre.
+// Con users_mutex; user_t.rates_active dice si un usuario está.
+static user_t** g_rate_users = NULL;
+static int g_rate_user_count = 0;
+static int g_rate_user_capacity = 0;
+
+// Lo que una publicación dejó sin referencias, para liberar fuera del lock
+typedef struct {
+    users_view_t* view;
+    uint64_t publication;   // la que retiró `view'
+    user_t** users;
+    int user_count;
+} users_garbage_t;
+
+// Diario abierto y si hay una compactación en curso; protegidos por users_mutex
+static user_journal_t g_user_journal = { .fd = -1 };
+static bool g_users_compacting = false;
+
+// Cambios hechos por management; una recarga que lo ve moverse mientras leía
+// los archivos vuelve a empezar, hasta USERS_RELOAD_ATTEMPTS veces.
+// Protegido por users_mutex
+static uint64_t g_users_changes = 0;
+#define USERS_RELOAD_ATTEMPTS 3
+
+// Sube cada vez que cambia algún límite de ancho de banda; el loop lo mira
+// en su tick para aplicar los límites nuevos a las conexiones abiertas
+static uint64_t g_bandwidth_generation = 0;
+
+// Hilos que hashean las claves de un CMD_BATCH_USERS o las claves en texto
+// plano de auth.db, y su nice
+#define USERS_HASH_THREADS 4
+#define USERS_HASH_NICE 5
+
+// Ordena la lectura de auth.db y los diarios contra la escritura de la foto.
+// Si hacen falta los dos, users_mutex se toma primero.
+static pthread_mutex_t g_users_files_mutex = PTHREAD_MUTEX_INITIALIZER;
+// La última foto que escribimos, para no recargar por un cambio propio
+static struct stat g_snapshot_written;
+
+// Archivo de configuración (--config); vacío si no hay
+static char g_config_file[PATH_MAX];
+
+// Hash contra el que se verifica un usuario inexistente, para que tarde lo
+// mismo que uno existente y el tiempo de respuesta no revele los nombres
+static char g_dummy_hash[MAX_PASSWORD_HASH_LEN];
 
 // Forward declaration para usar antes de su definición real
 static int add_user(const char* username, const char* password);
+static bool batch_field_valid(const char* value, bool is_username);
+static int insert_user(const char* username, const char* password_hash, int active);
+static int adopt_user(user_t* user);
+static int reserve_users(int count);
+static void unlink_user_at(int position);
+static user_t* find_user(const char* username);
 
 void sayHello(void) {
     printf("Hello!\n");
 }
 
-// Guarda los usuarios activos al disco
-static void save_users_to_file(void) {
-    if (g_shared_data == NULL) return;
-    FILE* f = fopen(USERS_PERSIST_FILE, "w");
-    if (!f) { perror("Opening users file for write"); return; }
+typedef struct {
+    char* data;
+    size_t len;
+} users_snapshot_t;
 
-    pthread_mutex_lock(&g_shared_data->users_mutex);
+// "usuario:hash", más ":subida:bajada" si tiene límites de ancho de banda y
+// ":subida:bajada:conexiones" si además tiene máximo de conexiones: una
+// línea de auth.db y, sin el '+', un alta del diario
+#define USER_RECORD_LEN (MAX_USERNAME_LEN + MAX_PASSWORD_HASH_LEN + 36)
+
+// Lo que va después de "usuario:" (con users_mutex tomado)
+static void format_user_secret(const user_t* user, char* out, size_t len) {
+    if (user->max_connections != 0) {
+        snprintf(out, len, "%s:%u:%u:%u", user->password_hash, user->upload_limit, user->download_limit,
+                 user->max_connections);
+    } else if (user->upload_limit != 0 || user->download_limit != 0) {
+        snprintf(out, len, "%s:%u:%u", user->password_hash, user->upload_limit, user->download_limit);
+    } else {
+        snprintf(out, len, "%s", user->password_hash);
+    }
+}
+
+// Usuarios persistentes en formato auth.db (con users_mutex tomado). Solo
+// copia memoria: el disco se toca después, sin el lock.
+static users_snapshot_t* snapshot_users(void) {
+    size_t len = 0;
+    for (int i = 0; i < g_shared_data->user_count; i++) {
+        if (g_shared_data->users[i]->active == USER_ACTIVE) {
+            len += USER_RECORD_LEN;
+        }
+    }
+    users_snapshot_t* snapshot = malloc(sizeof(*snapshot));
+    char* data = malloc(len + 1);
+    if (snapshot == NULL || data == NULL) {
+        free(snapshot);
+        free(data);
+        return NULL;
+    }
+    char* out = data;
     for (int i = 0; i < g_shared_data->user_count; i++) {
-        if (g_shared_data->users[i].active) {
-            fprintf(f, "%s:%s\n", g_shared_data->users[i].username,
-                             g_shared_data->users[i].password);
+        const user_t* user = g_shared_data->users[i];
+        if (user->active == USER_ACTIVE) {
+            char secret[USER_RECORD_LEN];
+            format_user_secret(user, secret, sizeof(secret));
+            out += sprintf(out, "%s:%s\n", user->username, secret);
         }
     }
+    snapshot->data = data;
+    snapshot->len = (size_t)(out - data);
+    return snapshot;
+}
+
+// Escribe la foto y, si quedó en disco, descarta el diario rotado
+static bool write_users_snapshot(users_snapshot_t* snapshot) {
+    pthread_mutex_lock(&g_users_files_mutex);
+    bool ok = user_journal_write_snapshot(USERS_PERSIST_FILE, snapshot->data, snapshot->len) == 0;
+    if (ok) {
+        unlink(USERS_JOURNAL_OLD_FILE);
+        stat(USERS_PERSIST_FILE, &g_snapshot_written);
+    }
+    pthread_mutex_unlock(&g_users_files_mutex);
+    if (!ok) {
+        log_error("Could not write %s: %s; user journal compaction disabled until restart",
+                  USERS_PERSIST_FILE, strerror(errno));
+    }
+    free(snapshot->data);
+    free(snapshot);
+    return ok;
+}
+
+static void* users_compaction_main(void* arg) {
+    bool ok = write_users_snapshot(arg);
+    pthread_mutex_lock(&g_shared_data->users_mutex);
+    // Si falló, el .old sigue siendo necesario: no se vuelve a rotar
+    g_users_compacting = !ok;
     pthread_mutex_unlock(&g_shared_data->users_mutex);
-    fclose(f);
+    return NULL;
+}
+
+// Reescribe auth.db con la tabla en segundo plano (con users_mutex tomado).
+// Bajo el lock solo se copia la tabla y se rota el diario; la escritura de
+// auth.db la hace un hilo aparte.
+static void compact_users(void) {
+    if (g_users_compacting) return;
+    if (access(USERS_JOURNAL_OLD_FILE, F_OK) == 0) {
+        // Quedó de una compactación que no terminó; pisarlo perdería registros
+        log_error("%s exists, not compacting the user journal", USERS_JOURNAL_OLD_FILE);
+        g_users_compacting = true;
+        return;
+    }
+
+    users_snapshot_t* snapshot = snapshot_users();
+    if (snapshot == NULL) return;
+    if (user_journal_rotate(&g_user_journal, USERS_JOURNAL_OLD_FILE) < 0) {
+        log_error("Could not rotate %s: %s", USERS_JOURNAL_FILE, strerror(errno));
+        free(snapshot->data);
+        free(snapshot);
+        return;
+    }
+    g_users_compacting = true;
+    pthread_t tid;
+    // Las señales las atiende el loop: el hilo nace con todas bloqueadas
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    int created = pthread_create(&tid, NULL, users_compaction_main, snapshot);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (created == 0) {
+        pthread_detach(tid);
+    } else {
+        g_users_compacting = !write_users_snapshot(snapshot);
+    }
+}
+
+// Compacta si el diario ya tiene más registros que usuarios la tabla
+static void maybe_compact_users(void) {
+    size_t threshold = (size_t)g_shared_data->user_count;
+    if (threshold < USERS_COMPACT_MIN_RECORDS) {
+        threshold = USERS_COMPACT_MIN_RECORDS;
+    }
+    if (g_user_journal.records >= threshold) {
+        compact_users();
+    }
+}
+
+static void track_user_rates(user_t* user) {
+    if (user->rates_active) return;
+    if (g_rate_user_count == g_rate_user_capacity) {
+        int capacity = g_rate_user_capacity ? g_rate_user_capacity * 2 : 64;
+        user_t** grown = realloc(g_rate_users, sizeof(*grown) * capacity);
+        if (grown == NULL) return;  // sus tasas quedan quietas hasta la próxima
+        g_rate_users = grown;
+        g_rate_user_capacity = capacity;
+    }
+    g_rate_users[g_rate_user_count++] = user;
+    user->rates_active = true;
+}
+
+// Saca a `user' de la lista de tasas; si `replacement' no es NULL, ocupa su
+// lugar (un cambio de clave que hereda las estadísticas)
+static void replace_user_rates(user_t* user, user_t* replacement) {
+    if (!user->rates_active) return;
+    user->rates_active = false;
+    for (int i = 0; i < g_rate_user_count; i++) {
+        if (g_rate_users[i] != user) continue;
+        if (replacement != NULL) {
+            g_rate_users[i] = replacement;
+            replacement->rates_active = true;
+        } else {
+            g_rate_users[i] = g_rate_users[--g_rate_user_count];
+        }
+        return;
+    }
+}
+
+// Anota que `username' cambió en g_user_index (con users_mutex tomado)
+static void note_user_changed(const char* username) {
+    users_delta_t* delta = &g_users_delta[1];
+    if (delta->overflow) return;
+    if (delta->count == delta->capacity) {
+        int capacity = delta->capacity ? delta->capacity * 2 : 16;
+        void* names = capacity <= USERS_DELTA_MAX ? realloc(delta->names, sizeof(*delta->names) * capacity) : NULL;
+        if (names == NULL) {
+            delta->overflow = true;
+            return;
+        }
+        delta->names = names;
+        delta->capacity = capacity;
+    }
+    strncpy(delta->names[delta->count], username, MAX_USERNAME_LEN - 1);
+    delta->names[delta->count][MAX_USERNAME_LEN - 1] = '\0';
+    delta->count++;
+}
+
+// Retira un user_t (con users_mutex tomado); se libera después de la
+// próxima publicación y su período de gracia
+static void retire_user(user_t* user) {
+    replace_user_rates(user, NULL);
+    if (g_retired_count == g_retired_capacity) {
+        int capacity = g_retired_capacity ? g_retired_capacity * 2 : 16;
+        user_t** retired = realloc(g_retired_users, sizeof(*retired) * capacity);
+        if (retired == NULL) {
+            // Liberarlo ahora no es seguro: se pierde
+            log_error("Out of memory retiring user %s", user->username);
+            return;
+        }
+        g_retired_users = retired;
+        g_retired_capacity = capacity;
+    }
+    g_retired_users[g_retired_count++] = user;
+}
+
+static void free_users_view(users_view_t* view) {
+    if (view == NULL) return;
+    user_index_free(&view->index);
+    free(view);
+}
+
+// Pone al día `view' con los nombres de `delta' según g_user_index
+static bool apply_users_delta(users_view_t* view, const users_delta_t* delta) {
+    for (int i = 0; i < delta->count; i++) {
+        user_t* user = user_index_get(&g_user_index, delta->names[i]);
+        if (user == NULL) {
+            user_index_remove(&view->index, delta->names[i]);
+        } else if (user_index_put(&view->index, user->username, user) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// La versión de repuesto al día con g_user_index, o NULL si no hay
+static users_view_t* take_spare_users_view(void) {
+    users_view_t* view = g_users_spare;
+    g_users_spare = NULL;
+    if (view == NULL) return NULL;
+    if (g_users_delta[1].overflow || !apply_users_delta(view, &g_users_delta[1])) {
+        free_users_view(view);
+        return NULL;
+    }
+    return view;
+}
+
+// Publica una versión de g_user_index para los lectores (con users_mutex
+// tomado) y deja en `garbage' lo que hay que liberar con
+// release_users_garbage, ya sin el lock. Con la versión de repuesto cuesta
+// lo que cambió desde hace dos publicaciones; sin ella, una copia entera.
+static void publish_users(users_garbage_t* garbage) {
+    memset(garbage, 0, sizeof(*garbage));
+    users_view_t* view = take_spare_users_view();
+    if (view == NULL) {
+        view = malloc(sizeof(*view));
+        if (view == NULL || user_index_copy(&view->index, &g_user_index) < 0) {
+            // Los lectores siguen con la versión anterior, y los retirados
+            // esperan a la próxima publicación
+            free(view);
+            log_error("Out of memory publishing the user index; authentication uses the previous version");
+            return;
+        }
+    }
+    garbage->view = __atomic_exchange_n(&g_users_view, view, __ATOMIC_SEQ_CST);
+    garbage->publication = ++g_users_publications;
+
+    // Lo que cambió desde la última publicación es lo que le falta a la
+    // versión recién retirada
+    users_delta_t used = g_users_delta[0];
+    g_users_delta[0] = g_users_delta[1];
+    g_users_delta[1] = used;
+    g_users_delta[1].count = 0;
+    g_users_delta[1].overflow = false;
+
+    garbage->users = g_retired_users;
+    garbage->user_count = g_retired_count;
+    g_retired_users = NULL;
+    g_retired_count = 0;
+    g_retired_capacity = 0;
+}
+
+// Espera a que ningún lector pueda ver lo publicado antes y lo libera. Si
+// nadie publicó otra mientras tanto, la versión retirada se pone al día y
+// queda de repuesto; se hace antes de liberar los user_t retirados, que
+// todavía tiene como claves.
+static void release_users_garbage(users_garbage_t* garbage) {
+    if (garbage->view == NULL && garbage->user_count == 0) return;
+    rcu_synchronize();
+    if (garbage->view != NULL) {
+        pthread_mutex_lock(&g_shared_data->users_mutex);
+        if (g_users_spare == NULL && garbage->publication == g_users_publications &&
+            !g_users_delta[0].overflow && apply_users_delta(garbage->view, &g_users_delta[0])) {
+            g_users_spare = garbage->view;
+            garbage->view = NULL;
+        }
+        pthread_mutex_unlock(&g_shared_data->users_mutex);
+    }
+    free_users_view(garbage->view);
+    for (int i = 0; i < garbage->user_count; i++) {
+        free(garbage->users[i]);
+    }
+    free(garbage->users);
+}
+
+// Una parte del trabajo de hash_in_parallel: las posiciones first,
+// first + step, ...
+typedef struct {
+    void (*hash)(void* ctx, uint32_t first, uint32_t step);
+    void* ctx;
+    uint32_t first;
+    uint32_t step;
+} hash_slice_t;
+
+static void* hash_slice_main(void* arg) {
+    // Como los workers de auth: si compiten por CPU, el relay sigue primero
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), USERS_HASH_NICE);
+    hash_slice_t* slice = arg;
+    slice->hash(slice->ctx, slice->first, slice->step);
+    return NULL;
+}
+
+// Reparte `count' claves entre hilos y espera a que terminen, sin locks. El
+// KDF es casi todo el costo, así que con varias CPUs rinde en paralelo.
+static void hash_in_parallel(uint32_t count, void (*hash)(void* ctx, uint32_t first, uint32_t step), void* ctx) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t threads = cpus > 1 ? (uint32_t)cpus : 1;
+    if (threads > USERS_HASH_THREADS) {
+        threads = USERS_HASH_THREADS;
+    }
+    if (threads > count) {
+        threads = count;
+    }
+
+    hash_slice_t slices[USERS_HASH_THREADS];
+    pthread_t tids[USERS_HASH_THREADS];
+    bool started[USERS_HASH_THREADS] = {false};
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    for (uint32_t t = 0; t < threads; t++) {
+        slices[t] = (hash_slice_t){ hash, ctx, t, threads };
+        if (t > 0) {
+            started[t] = pthread_create(&tids[t], NULL, hash_slice_main, &slices[t]) == 0;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    // La primera parte, y las de los hilos que no se pudieron crear, acá
+    for (uint32_t t = 0; t < threads; t++) {
+        if (!started[t]) {
+            hash(ctx, slices[t].first, slices[t].step);
+        }
+    }
+    for (uint32_t t = 1; t < threads; t++) {
+        if (started[t]) {
+            pthread_join(tids[t], NULL);
+        }
+    }
+}
+
+// auth.db más los diarios tal como están en disco, armado sin users_mutex.
+// Los user_t que la mezcla agrega a la tabla se toman de acá sin copiarlos.
+typedef struct {
+    user_index_t index;     // nombre -> user_t* (NULL si pasó a la tabla)
+    int migrated;           // claves en texto plano que se hashearon
+    bool failed;
+} stored_users_t;
+
+// Claves en texto plano de un stored_users_t, para hashear en paralelo
+typedef struct {
+    user_t** users;
+    bool* failed;
+    uint32_t count;
+} plaintext_users_t;
+
+static void stored_users_free(stored_users_t* stored) {
+    for (size_t i = 0; i < stored->index.capacity; i++) {
+        free(stored->index.entries[i].value);
+    }
+    user_index_free(&stored->index);
+}
+
+// Alta o cambio de clave. Una clave en texto plano (un auth.db de antes de
+// los hashes, o una línea agregada a mano) queda tal cual en password_hash
+// hasta hash_stored_plaintext. Después de un hash pueden venir los límites
+// ":subida:bajada[:conexiones]"; un hash no tiene ':', una clave en texto
+// plano sí puede, y entonces es toda clave.
+static void stored_user_put(stored_users_t* stored, const char* username, const char* password) {
+    char hash[MAX_PASSWORD_HASH_LEN];
+    unsigned upload = 0, download = 0, max_connections = 0;
+    const char* limits = password[0] == '$' ? strchr(password, ':') : NULL;
+    if (limits != NULL && (size_t)(limits - password) < sizeof(hash) &&
+        sscanf(limits, ":%u:%u:%u", &upload, &download, &max_connections) >= 2) {
+        memcpy(hash, password, (size_t)(limits - password));
+        hash[limits - password] = '\0';
+        if (password_hash_is_hash(hash)) {
+            password = hash;
+        } else {
+            upload = download = max_connections = 0;
+        }
+    }
+    if (!password_hash_is_hash(password) && strlen(password) >= MAX_PASSWORD_HASH_LEN) {
+        log_error("The password of user %s is too long, ignoring the user", username);
+        free(user_index_remove(&stored->index, username));
+        return;
+    }
+
+    user_t* user = user_index_get(&stored->index, username);
+    if (user == NULL) {
+        user = calloc(1, sizeof(*user));
+        if (user == NULL) {
+            stored->failed = true;
+            return;
+        }
+        strncpy(user->username, username, MAX_USERNAME_LEN - 1);
+        user->active = USER_ACTIVE;
+        if (user_index_put(&stored->index, user->username, user) < 0) {
+            free(user);
+            stored->failed = true;
+            return;
+        }
+    }
+    explicit_bzero(user->password_hash, sizeof(user->password_hash));
+    strncpy(user->password_hash, password, MAX_PASSWORD_HASH_LEN - 1);
+    user->upload_limit = upload;
+    user->download_limit = download;
+    user->max_connections = max_connections;
+}
+
+// Un registro del diario al reaplicarlo
+static void apply_journal_record(char op, const char* username, const char* password, void* ctx) {
+    stored_users_t* stored = ctx;
+    if (op == '-') {
+        free(user_index_remove(&stored->index, username));
+    } else {
+        stored_user_put(stored, username, password);
+    }
+}
+
+static void hash_plaintext_slice(void* ctx, uint32_t first, uint32_t step) {
+    plaintext_users_t* plaintext = ctx;
+    for (uint32_t i = first; i < plaintext->count; i += step) {
+        user_t* user = plaintext->users[i];
+        char hash[MAX_PASSWORD_HASH_LEN];
+        if (password_hash_make(user->password_hash, hash, sizeof(hash)) < 0) {
+            log_error("Could not hash the password of user %s", user->username);
+            plaintext->failed[i] = true;
+            memset(hash, 0, sizeof(hash));
+        }
+        // Aunque falle, la clave en texto plano no se queda en memoria
+        explicit_bzero(user->password_hash, sizeof(user->password_hash));
+        memcpy(user->password_hash, hash, sizeof(hash));
+    }
+}
+
+// Hashea las claves en texto plano que quedaron al leer, sin ningún lock: la
+// migración de un auth.db viejo no frena al loop ni a management mientras
+// corre el KDF de cada una
+static void hash_stored_plaintext(stored_users_t* stored) {
+    uint32_t count = 0;
+    for (size_t i = 0; i < stored->index.capacity; i++) {
+        const user_t* user = stored->index.entries[i].value;
+        count += user != NULL && !password_hash_is_hash(user->password_hash);
+    }
+    if (count == 0) return;
+
+    plaintext_users_t plaintext = {
+        .users = calloc(count, sizeof(user_t*)),
+        .failed = calloc(count, sizeof(bool)),
+        .count = count,
+    };
+    if (plaintext.users == NULL || plaintext.failed == NULL) {
+        stored->failed = true;
+    } else {
+        uint32_t n = 0;
+        for (size_t i = 0; i < stored->index.capacity && n < count; i++) {
+            user_t* user = stored->index.entries[i].value;
+            if (user != NULL && !password_hash_is_hash(user->password_hash)) {
+                plaintext.users[n++] = user;
+            }
+        }
+        hash_in_parallel(count, hash_plaintext_slice, &plaintext);
+        for (uint32_t i = 0; i < count; i++) {
+            stored->failed |= plaintext.failed[i];
+        }
+        stored->migrated += (int)count;
+    }
+    free(plaintext.users);
+    free(plaintext.failed);
+}
+
+// Lee la foto y reaplica los diarios (con g_users_files_mutex tomado).
+// Devuelve los registros de diario reaplicados; `stored->failed' indica
+// que algo no se pudo leer y el resultado está incompleto.
+static long read_stored_users(stored_users_t* stored) {
+    FILE* f = fopen(USERS_PERSIST_FILE, "r");
+    if (f != NULL) {
+        // Una pasada para contar permite reservar una sola vez y no
+        // rehashear el índice a medida que crece
+        size_t lines = 0;
+        for (int c; (c = getc(f)) != EOF;) {
+            lines += c == '\n';
+        }
+        rewind(f);
+        user_index_reserve(&stored->index, lines);
+
+        char line[USER_RECORD_LEN + 2]; // username:hash[:subida:bajada]\n\0
+        while (fgets(line, sizeof(line), f)) {
+            // Remover salto de linea
+            char* nl = strchr(line, '\n');
+            if (nl) *nl = '\0';
+            char* sep = strchr(line, ':');
+            if (!sep) continue;
+            *sep = '\0';
+            stored_user_put(stored, line, sep + 1);
+        }
+        if (ferror(f)) {
+            stored->failed = true;
+        }
+        fclose(f);
+    } else if (errno != ENOENT) {
+        log_error("Could not read %s: %s", USERS_PERSIST_FILE, strerror(errno));
+        stored->failed = true;
+    }
+
+    long replayed = 0;
+    const char* journals[] = { USERS_JOURNAL_OLD_FILE, USERS_JOURNAL_FILE };
+    for (size_t i = 0; i < sizeof(journals) / sizeof(journals[0]); i++) {
+        long records = user_journal_replay(journals[i], apply_journal_record, stored);
+        if (records < 0) {
+            log_error("Could not read %s: %s", journals[i], strerror(errno));
+            stored->failed = true;
+        } else {
+            replayed += records;
+        }
+    }
+    if (stored->migrated > 0) {
+        log_info("Hashed %d plaintext passwords from %s", stored->migrated, USERS_PERSIST_FILE);
+    }
+    return replayed;
+}
+
+typedef struct {
+    int added;
+    int removed;
+    int changed;
+} users_merge_t;
+
+static bool same_bandwidth(const user_t* a, const user_t* b) {
+    return a->upload_limit == b->upload_limit && a->download_limit == b->download_limit;
+}
+
+// Cambia los límites de un user_t ya publicado (con users_mutex tomado): el
+// loop los lee sin lock
+static void set_user_limits(user_t* user, uint32_t upload, uint32_t download, uint32_t max_connections) {
+    __atomic_store_n(&user->max_connections, max_connections, __ATOMIC_RELAXED);
+    if (user->upload_limit == upload && user->download_limit == download) return;
+    __atomic_store_n(&user->upload_limit, upload, __ATOMIC_RELAXED);
+    __atomic_store_n(&user->download_limit, download, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&g_bandwidth_generation, 1, __ATOMIC_RELEASE);
+}
+
+// Deja la tabla igual a `stored' más los usuarios de -u (con users_mutex
+// tomado). Los que siguen igual conservan su user_t y sus estadísticas; un
+// cambio de clave pasa al user_t leído, que hereda las estadísticas.
+static users_merge_t merge_stored_users(stored_users_t* stored) {
+    users_merge_t result = {0};
+    if (reserve_users(g_shared_data->user_count + (int)stored->index.count) < 0) {
+        return result;
+    }
+
+    if (g_shared_data->user_count == 0) {
+        // Al arrancar la tabla está vacía: se adopta el índice leído entero
+        user_index_free(&g_user_index);
+        g_user_index = stored->index;
+        stored->index = (user_index_t){0};
+        g_users_delta[1].overflow = true;
+        for (size_t i = 0; i < g_user_index.capacity; i++) {
+            user_t* user = g_user_index.entries[i].value;
+            if (user != NULL) {
+                g_shared_data->users[g_shared_data->user_count++] = user;
+            }
+        }
+        result.added = g_shared_data->user_count;
+        return result;
+    }
+
+    // De atrás para adelante: una baja trae al último, que ya se miró
+    for (int i = g_shared_data->user_count - 1; i >= 0; i--) {
+        user_t* user = g_shared_data->users[i];
+        user_t* on_disk = user_index_get(&stored->index, user->username);
+        if (on_disk == NULL) {
+            if (user->active == USER_ACTIVE) {
+                user_index_remove(&g_user_index, user->username);
+                note_user_changed(user->username);
+                unlink_user_at(i);
+                retire_user(user);
+                result.removed++;
+            }
+            continue;
+        }
+        if (user->active == USER_ACTIVE && strcmp(user->password_hash, on_disk->password_hash) == 0) {
+            if (!same_bandwidth(user, on_disk) || user->max_connections != on_disk->max_connections) {
+                set_user_limits(user, on_disk->upload_limit, on_disk->download_limit, on_disk->max_connections);
+                result.changed++;
+            }
+            continue;
+        }
+        // Clave distinta, o un -u que ahora también está en auth.db (gana el archivo)
+        if (!same_bandwidth(user, on_disk)) {
+            __atomic_add_fetch(&g_bandwidth_generation, 1, __ATOMIC_RELEASE);
+        }
+        user_index_remove(&stored->index, on_disk->username);
+        on_disk->stats = user->stats;
+        replace_user_rates(user, on_disk);
+        user_index_put(&g_user_index, on_disk->username, on_disk);
+        note_user_changed(on_disk->username);
+        g_shared_data->users[i] = on_disk;
+        retire_user(user);
+        result.changed++;
+    }
+
+    // Lo que queda en `stored' y no está en la tabla son altas
+    for (size_t i = 0; i < stored->index.capacity; i++) {
+        user_index_entry_t* entry = &stored->index.entries[i];
+        user_t* on_disk = entry->value;
+        if (on_disk != NULL && find_user(on_disk->username) == NULL && adopt_user(on_disk) == 0) {
+            entry->value = NULL;
+            result.added++;
+        }
+    }
+    return result;
 }
 
-// Carga los usuarios desde disco (si el archivo existe)
+// Carga la foto y reaplica los diarios (si existen)
 static void load_users_from_file(void) {
     if (g_shared_data == NULL) return;
-    FILE* f = fopen(USERS_PERSIST_FILE, "r");
-    if (!f) return; // No hay archivo, no es un error
-
-    char line[MAX_USERNAME_LEN + MAX_PASSWORD_LEN + 2]; // username:pass\n\0
-    while (fgets(line, sizeof(line), f)) {
-        // Remover salto de linea
-        char* nl = strchr(line, '\n');
-        if (nl) *nl = '\0';
-        char* sep = strchr(line, ':');
-        if (!sep) continue;
-        *sep = '\0';
-        const char* username = line;
-        const char* password = sep + 1;
+
+    stored_users_t stored = {0};
+    pthread_mutex_lock(&g_users_files_mutex);
+    long replayed = read_stored_users(&stored);
+    pthread_mutex_unlock(&g_users_files_mutex);
+    hash_stored_plaintext(&stored);
+
+    pthread_mutex_lock(&g_shared_data->users_mutex);
+    merge_stored_users(&stored);
+
+    if (user_journal_open(&g_user_journal, USERS_JOURNAL_FILE) < 0) {
+        log_error("Could not open %s: %s; user changes will not be saved",
+                  USERS_JOURNAL_FILE, strerror(errno));
+    } else if (stored.failed) {
+        // Con una lectura incompleta, compactar pisaría auth.db con menos
+        // usuarios de los que tiene
+        g_users_compacting = true;
+    } else if (replayed > 0 || stored.migrated > 0 || access(USERS_JOURNAL_OLD_FILE, F_OK) == 0) {
+        // Se compacta enseguida y en línea: así arranca con el diario vacío,
+        // sin un .old que la próxima rotación podría pisar y sin claves en
+        // texto plano en disco
+        users_snapshot_t* snapshot = snapshot_users();
+        if (snapshot != NULL && write_users_snapshot(snapshot)) {
+            user_journal_truncate(&g_user_journal);
+        } else {
+            g_users_compacting = true;
+        }
+    }
+    users_garbage_t garbage;
+    publish_users(&garbage);
+    int loaded = g_shared_data->user_count;
+    pthread_mutex_unlock(&g_shared_data->users_mutex);
+    release_users_garbage(&garbage);
+    stored_users_free(&stored);
+    log_info("Loaded %d users from %s (%ld journal records replayed)", loaded, USERS_PERSIST_FILE, replayed);
+}
+
+// Vuelve a leer auth.db y los diarios y aplica la diferencia a la tabla. La
+// lectura y el armado del estado nuevo se hacen sin users_mutex; solo la
+// mezcla lo toma. Autenticar no espera a nada: lee la versión publicada
+// hasta que se publica la nueva. Si management cambia usuarios mientras se
+// lee, se vuelve a leer; tras USERS_RELOAD_ATTEMPTS se rinde con EBUSY en
+// vez de leer con el lock tomado. Devuelve -1 si no se pudo leer todo.
+static int reload_users(users_merge_t* result, int* total) {
+    for (int attempt = 1; attempt <= USERS_RELOAD_ATTEMPTS; attempt++) {
+        pthread_mutex_lock(&g_shared_data->users_mutex);
+        uint64_t changes = g_users_changes;
+        pthread_mutex_unlock(&g_shared_data->users_mutex);
+
+        stored_users_t stored = {0};
+        pthread_mutex_lock(&g_users_files_mutex);
+        read_stored_users(&stored);
+        pthread_mutex_unlock(&g_users_files_mutex);
+        hash_stored_plaintext(&stored);
+        if (stored.failed) {
+            stored_users_free(&stored);
+            errno = EIO;
+            return -1;
+        }
 
         pthread_mutex_lock(&g_shared_data->users_mutex);
-        if (g_shared_data->user_count < MAX_USERS) {
-            int slot = g_shared_data->user_count;
-            strncpy(g_shared_data->users[slot].username, username, MAX_USERNAME_LEN - 1);
-            strncpy(g_shared_data->users[slot].password, password, MAX_PASSWORD_LEN - 1);
-            g_shared_data->users[slot].username[MAX_USERNAME_LEN - 1] = '\0';
-            g_shared_data->users[slot].password[MAX_PASSWORD_LEN - 1] = '\0';
-            g_shared_data->users[slot].active = 1;
-            g_shared_data->user_count = slot + 1;
+        if (g_users_changes != changes) {
+            pthread_mutex_unlock(&g_shared_data->users_mutex);
+            stored_users_free(&stored);
+            continue;
+        }
+
+        *result = merge_stored_users(&stored);
+        if (stored.migrated > 0) {
+            // Saca del disco las claves en texto plano que se agregaron a mano
+            compact_users();
         }
+        users_garbage_t garbage;
+        publish_users(&garbage);
+        *total = g_shared_data->user_count;
         pthread_mutex_unlock(&g_shared_data->users_mutex);
+        release_users_garbage(&garbage);
+        stored_users_free(&stored);
+        return 0;
+    }
+    errno = EBUSY;
+    return -1;
+}
+
+// auth.db es la foto que escribimos nosotros (el watcher la ignora)
+static bool snapshot_is_ours(void) {
+    struct stat st;
+    pthread_mutex_lock(&g_users_files_mutex);
+    bool ours = stat(USERS_PERSIST_FILE, &st) == 0 &&
+                st.st_ino == g_snapshot_written.st_ino &&
+                st.st_size == g_snapshot_written.st_size &&
+                st.st_mtim.tv_sec == g_snapshot_written.st_mtim.tv_sec &&
+                st.st_mtim.tv_nsec == g_snapshot_written.st_mtim.tv_nsec;
+    pthread_mutex_unlock(&g_users_files_mutex);
+    return ours;
+}
+
+// Lee `clave = valor' de g_config_file y, si todo es válido, lo aplica de una
+// vez bajo g_config_mutex. Si algo falla no cambia nada y deja el motivo en
+// `error'.
+static int apply_config_file(char* error, size_t error_len) {
+    FILE* f = fopen(g_config_file, "r");
+    if (f == NULL) {
+        snprintf(error, error_len, "%s: %s", g_config_file, strerror(errno));
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_config_mutex);
+    int timeout_ms = g_connection_timeout_ms;
+    int buffer_size = g_buffer_size;
+    int max_clients = g_max_clients;
+    bool dissectors = g_dissectors_enabled;
+    pthread_mutex_unlock(&g_config_mutex);
+
+    char line[256];
+    int line_number = 0;
+    int result = 0;
+    while (result == 0 && fgets(line, sizeof(line), f)) {
+        line_number++;
+        char* key = line;
+        while (isspace((unsigned char)*key)) key++;
+        if (*key == '\0' || *key == '#') continue;
+        char* eq = strchr(key, '=');
+        if (eq == NULL) {
+            snprintf(error, error_len, "%s:%d: falta '='", g_config_file, line_number);
+            errno = EINVAL;
+            result = -1;
+            break;
+        }
+        char* key_end = eq;
+        while (key_end > key && isspace((unsigned char)key_end[-1])) key_end--;
+        *key_end = '\0';
+        char* value = eq + 1;
+        while (isspace((unsigned char)*value)) value++;
+        char* value_end = value + strlen(value);
+        while (value_end > value && isspace((unsigned char)value_end[-1])) value_end--;
+        *value_end = '\0';
+
+        char* end;
+        long number = strtol(value, &end, 10);
+        bool is_number = *value != '\0' && *end == '\0' && number > 0 && number <= INT_MAX;
+        if (strcmp(key, "connection_timeout_ms") == 0 && is_number) {
+            timeout_ms = (int)number;
+        } else if (strcmp(key, "buffer_size") == 0 && is_number) {
+            buffer_size = number < MIN_BUFFER_SIZE ? MIN_BUFFER_SIZE
+                        : number > MAX_BUFFER_CAPACITY ? MAX_BUFFER_CAPACITY : (int)number;
+        } else if (strcmp(key, "max_clients") == 0 && is_number) {
+            max_clients = (int)number;
+        } else if (strcmp(key, "dissectors") == 0 && (strcmp(value, "on") == 0 || strcmp(value, "off") == 0)) {
+            dissectors = strcmp(value, "on") == 0;
+        } else {
+            snprintf(error, error_len, "%s:%d: valor inválido para '%s'", g_config_file, line_number, key);
+            errno = EINVAL;
+            result = -1;
+        }
     }
     fclose(f);
+    if (result < 0) return -1;
+
+    pthread_mutex_lock(&g_config_mutex);
+    g_connection_timeout_ms = timeout_ms;
+    g_buffer_size = buffer_size;
+    g_max_clients = max_clients;
+    g_dissectors_enabled = dissectors;
+    pthread_mutex_unlock(&g_config_mutex);
+    return 0;
+}
+
+int mgmt_load_config_file(const char* path) {
+    snprintf(g_config_file, sizeof(g_config_file), "%s", path);
+    char error[MAX_MESSAGE_LEN];
+    if (apply_config_file(error, sizeof(error)) < 0) {
+        log_error("Could not load configuration: %s", error);
+        return -1;
+    }
+    log_info("Configuration loaded from %s", g_config_file);
+    return 0;
+}
+
+// Recarga los usuarios y deja el resumen en `message'
+static bool reload_users_reporting(char* message, size_t message_len) {
+    users_merge_t merge;
+    int total = 0;
+    if (reload_users(&merge, &total) < 0) {
+        if (errno == EBUSY) {
+            snprintf(message, message_len, "Usuarios cambiando, sin recargar; reintente");
+            log_warn("Users kept changing while reloading %s; keeping the current ones", USERS_PERSIST_FILE);
+        } else {
+            snprintf(message, message_len, "Error leyendo %s, usuarios sin cambios", USERS_PERSIST_FILE);
+            log_error("Could not reload users from %s; keeping the current ones", USERS_PERSIST_FILE);
+        }
+        return false;
+    }
+    snprintf(message, message_len, "Usuarios recargados: %d (%d altas, %d bajas, %d cambios)",
+             total, merge.added, merge.removed, merge.changed);
+    log_info("Users reloaded from %s: %d users, %d added, %d removed, %d changed",
+             USERS_PERSIST_FILE, total, merge.added, merge.removed, merge.changed);
+    return true;
+}
+
+// Vuelve a aplicar --config y deja el resultado en `message'
+static bool reload_config_reporting(char* message, size_t message_len) {
+    char error[MAX_MESSAGE_LEN];
+    if (apply_config_file(error, sizeof(error)) < 0) {
+        snprintf(message, message_len, "configuración sin cambios (%s)", error);
+        log_error("Could not reload configuration: %s", error);
+        return false;
+    }
+    snprintf(message, message_len, "configuración recargada de %s", g_config_file);
+    log_info("Configuration reloaded from %s", g_config_file);
+    return true;
+}
+
+// Lo que hace CMD_RELOAD_CONFIG; deja el resumen en `message'
+static bool reload_all(char* message, size_t message_len) {
+    bool ok = reload_users_reporting(message, message_len);
+    if (g_config_file[0] != '\0') {
+        char config_message[MAX_MESSAGE_LEN];
+        ok = reload_config_reporting(config_message, sizeof(config_message)) && ok;
+        size_t len = strlen(message);
+        snprintf(message + len, message_len - len, "; %s", config_message);
+    }
+    return ok;
+}
+
+static void on_watched_file(const char* path, void* ctx) {
+    (void)ctx;
+    char message[MAX_MESSAGE_LEN];
+    if (strcmp(path, USERS_PERSIST_FILE) == 0) {
+        if (!snapshot_is_ours()) {
+            log_info("%s changed, reloading", path);
+            reload_users_reporting(message, sizeof(message));
+        }
+    } else {
+        log_info("%s changed, reloading", path);
+        reload_config_reporting(message, sizeof(message));
+    }
+}
+
+int mgmt_watch_config_files(void) {
+    const char* paths[] = { USERS_PERSIST_FILE, g_config_file };
+    size_t count = g_config_file[0] != '\0' ? 2 : 1;
+    if (file_watch_start(paths, count, on_watched_file, NULL) < 0) {
+        log_error("Could not watch %s for changes", USERS_PERSIST_FILE);
+        return -1;
+    }
+    log_info("Watching %s%s%s for changes", USERS_PERSIST_FILE,
+             count > 1 ? " and " : "", count > 1 ? g_config_file : "");
+    return 0;
 }
 
 // Inicializar memoria compartida
@@ -141,6 +1074,11 @@ int mgmt_init_shared_memory(void) {
     
     pthread_mutexattr_destroy(&attr);
 
+    // Una sola vez: el KDF cuesta decenas de milisegundos
+    if (password_hash_make("socks5d-dummy", g_dummy_hash, sizeof(g_dummy_hash)) < 0) {
+        log_error("Failed to create dummy password hash");
+    }
+
     // Cargar usuarios persistidos, si existen
     load_users_from_file();
 
@@ -149,13 +1087,37 @@ int mgmt_init_shared_memory(void) {
     //     add_user("admin", "admin");
     // }
 
-    printf("[INF] Shared memory initialized\n");
+    log_info("Shared memory initialized");
     return 0;
 }
 
 // Limpiar memoria compartida
 void mgmt_cleanup_shared_memory(void) {
     if (g_shared_data != NULL) {
+        // El watcher podría estar recargando
+        file_watch_stop();
+        user_journal_close(&g_user_journal);
+        // Sin lectores: el loop ya terminó
+        free_users_view(g_users_view);
+        g_users_view = NULL;
+        free_users_view(g_users_spare);
+        g_users_spare = NULL;
+        for (int i = 0; i < 2; i++) {
+            free(g_users_delta[i].names);
+            g_users_delta[i] = (users_delta_t){0};
+        }
+        user_index_free(&g_user_index);
+        for (int i = 0; i < g_shared_data->user_count; i++) {
+            free(g_shared_data->users[i]);
+        }
+        free(g_shared_data->users);
+        for (int i = 0; i < g_retired_count; i++) {
+            free(g_retired_users[i]);
+        }
+        free(g_retired_users);
+        free(g_rate_users);
+        g_rate_users = NULL;
+        g_rate_user_count = g_rate_user_capacity = 0;
         pthread_mutex_destroy(&g_shared_data->users_mutex);
         pthread_mutex_destroy(&g_shared_data->stats_mutex);
         munmap(g_shared_data, sizeof(shared_data_t));
@@ -168,88 +1130,345 @@ shared_data_t* mgmt_get_shared_data(void) {
     return g_shared_data;
 }
 
-// Función para buscar un usuario
-static int find_user(const char* username) {
-    for (int i = 0; i < g_shared_data->user_count; i++) {
-        if (g_shared_data->users[i].active && strcmp(g_shared_data->users[i].username, username) == 0) {
-            return i;
+// Función para buscar un usuario (con users_mutex tomado)
+static user_t* find_user(const char* username) {
+    return user_index_get(&g_user_index, username);
+}
+
+// Deja lugar para `count' usuarios en la lista y en el índice (con
+// users_mutex tomado). La lista crece al doble, como el índice.
+static int reserve_users(int count) {
+    if (count > g_shared_data->user_capacity) {
+        int capacity = g_shared_data->user_capacity ? g_shared_data->user_capacity : 16;
+        while (capacity < count) {
+            capacity *= 2;
         }
+        user_t** users = realloc(g_shared_data->users, sizeof(*users) * capacity);
+        if (users == NULL) return -1;
+        g_shared_data->users = users;
+        g_shared_data->user_capacity = capacity;
     }
-    return -1;
+    return user_index_reserve(&g_user_index, (size_t)count);
+}
+
+// Alta en la tabla y en el índice (con users_mutex tomado)
+static int insert_user(const char* username, const char* password_hash, int active) {
+    // Verificar si el usuario ya existe
+    if (find_user(username) != NULL) {
+        return -1; // Usuario ya existe
+    }
+
+    user_t* user = calloc(1, sizeof(*user));
+    if (user == NULL) {
+        return -2; // Sin memoria
+    }
+    strncpy(user->username, username, MAX_USERNAME_LEN - 1);
+    strncpy(user->password_hash, password_hash, MAX_PASSWORD_HASH_LEN - 1);
+    user->active = active;
+    if (adopt_user(user) < 0) {
+        free(user);
+        return -2;
+    }
+    return 0;
+}
+
+// Suma a la tabla un user_t ya armado que no está (con users_mutex tomado)
+static int adopt_user(user_t* user) {
+    if (reserve_users(g_shared_data->user_count + 1) < 0) {
+        return -2; // Sin memoria
+    }
+    // No falla: reserve_users ya dejó lugar en el índice
+    user_index_put(&g_user_index, user->username, user);
+    note_user_changed(user->username);
+    g_shared_data->users[g_shared_data->user_count++] = user;
+    return 0;
 }
 
 // Función para agregar un usuario
 static int add_user(const char* username, const char* password) {
+    // Lo mismo que se le pide a un alta de CMD_BATCH_USERS
+    if (!batch_field_valid(username, true) || !batch_field_valid(password, false)) {
+        return -4;
+    }
+
+    // El KDF tarda: se hashea antes de tomar el lock
+    char hash[MAX_PASSWORD_HASH_LEN];
+    if (password_hash_make(password, hash, sizeof(hash)) < 0) {
+        log_error("Could not hash the password of user %s", username);
+        return -3;
+    }
+
     pthread_mutex_lock(&g_shared_data->users_mutex);
-    
-    // Verificar si el usuario ya existe
-    if (find_user(username) != -1) {
-        pthread_mutex_unlock(&g_shared_data->users_mutex);
-        return -1; // Usuario ya existe
+    int result = insert_user(username, hash, USER_ACTIVE);
+
+    // Persistir cambios: un registro en el diario, en el mismo orden que en la tabla
+    users_garbage_t garbage = {0};
+    if (result == 0) {
+        if (user_journal_add(&g_user_journal, username, hash) < 0) {
+            log_error_limited("Could not save user %s to %s: %s", username, USERS_JOURNAL_FILE, strerror(errno));
+        }
+        maybe_compact_users();
+        g_users_changes++;
+        publish_users(&garbage);
     }
-    
-    // Buscar slot libre
-    int slot = -1;
-    for (int i = 0; i < MAX_USERS; i++) {
-        if (!g_shared_data->users[i].active) {
-            slot = i;
+    pthread_mutex_unlock(&g_shared_data->users_mutex);
+    release_users_garbage(&garbage);
+    return result;
+}
+
+// Usuario de la línea de comandos: vive solo en memoria. Si auth.db ya tiene
+// uno con el mismo nombre, gana el de auth.db.
+int mgmt_add_static_user(const char* username, const char* password) {
+    if (g_shared_data == NULL || username == NULL || password == NULL) return -1;
+    char hash[MAX_PASSWORD_HASH_LEN];
+    if (password_hash_make(password, hash, sizeof(hash)) < 0) return -3;
+    pthread_mutex_lock(&g_shared_data->users_mutex);
+    int result = insert_user(username, hash, USER_ACTIVE_STATIC);
+    users_garbage_t garbage = {0};
+    if (result == 0) {
+        publish_users(&garbage);
+    }
+    pthread_mutex_unlock(&g_shared_data->users_mutex);
+    release_users_garbage(&garbage);
+    return result;
+}
+
+// Copia en `hash' el hash de `username' según la versión publicada del
+// índice, sin locks ni disco. La copia permite hacer el KDF fuera de la
+// sección de lectura.
+static bool published_hash(const char* username, char* hash) {
+    rcu_read_lock();
+    const users_view_t* view = __atomic_load_n(&g_users_view, __ATOMIC_ACQUIRE);
+    const user_t* user = view != NULL ? user_index_get(&view->index, username) : NULL;
+    if (user != NULL) {
+        memcpy(hash, user->password_hash, MAX_PASSWORD_HASH_LEN);
+    }
+    rcu_read_unlock();
+    return user != NULL;
+}
+
+// El KDF solo corre si la credencial no se verificó hace poco. Un usuario
+// inexistente paga el KDF igual, contra g_dummy_hash
+bool mgmt_check_credentials(const char* username, const char* password) {
+    if (g_shared_data == NULL || username == NULL || password == NULL) return false;
+    char hash[MAX_PASSWORD_HASH_LEN];
+    if (!published_hash(username, hash)) {
+        password_hash_verify(password, g_dummy_hash);
+        return false;
+    }
+
+    auth_digest_t digest;
+    auth_cache_digest(username, password, hash, &digest);
+    if (auth_cache_lookup(&digest)) return true;
+    bool valid = password_hash_verify(password, hash);
+    if (valid) {
+        auth_cache_insert(&digest);
+    }
+    return valid;
+}
+
+int mgmt_check_credentials_cached(const char* username, const char* password) {
+    if (g_shared_data == NULL || username == NULL || password == NULL) return 0;
+    char hash[MAX_PASSWORD_HASH_LEN];
+    // Inexistente: al pool como cualquier otro, responderlo ya lo delataría
+    if (!published_hash(username, hash)) return -1;
+    auth_digest_t digest;
+    auth_cache_digest(username, password, hash, &digest);
+    return auth_cache_lookup(&digest) ? 1 : -1;
+}
+
+bool mgmt_get_user_bandwidth(const char* username, uint32_t* upload, uint32_t* download) {
+    if (g_shared_data == NULL || username == NULL) return false;
+    rcu_read_lock();
+    const users_view_t* view = __atomic_load_n(&g_users_view, __ATOMIC_ACQUIRE);
+    const user_t* user = view != NULL ? user_index_get(&view->index, username) : NULL;
+    if (user != NULL) {
+        *upload = __atomic_load_n(&user->upload_limit, __ATOMIC_RELAXED);
+        *download = __atomic_load_n(&user->download_limit, __ATOMIC_RELAXED);
+    }
+    rcu_read_unlock();
+    return user != NULL;
+}
+
+uint32_t mgmt_get_user_max_connections(const char* username) {
+    if (g_shared_data == NULL || username == NULL) return 0;
+    rcu_read_lock();
+    const users_view_t* view = __atomic_load_n(&g_users_view, __ATOMIC_ACQUIRE);
+    const user_t* user = view != NULL ? user_index_get(&view->index, username) : NULL;
+    uint32_t max_connections = user != NULL ? __atomic_load_n(&user->max_connections, __ATOMIC_RELAXED) : 0;
+    rcu_read_unlock();
+    return max_connections;
+}
+
+uint64_t mgmt_bandwidth_generation(void) {
+    return __atomic_load_n(&g_bandwidth_generation, __ATOMIC_ACQUIRE);
+}
+
+bool mgmt_has_users(void) {
+    if (g_shared_data == NULL) return false;
+    rcu_read_lock();
+    const users_view_t* view = __atomic_load_n(&g_users_view, __ATOMIC_ACQUIRE);
+    bool any = view != NULL && view->index.count > 0;
+    rcu_read_unlock();
+    return any;
+}
+
+// Saca users[position] de la lista (con users_mutex tomado): el último pasa
+// a su lugar, así la lista no tiene huecos
+static void unlink_user_at(int position) {
+    int last = --g_shared_data->user_count;
+    g_shared_data->users[position] = g_shared_data->users[last];
+    g_shared_data->users[last] = NULL;
+}
+
+// Baja de la tabla y del índice (con users_mutex tomado)
+static int remove_user(const char* username) {
+    user_t* user = user_index_remove(&g_user_index, username);
+    if (user == NULL) {
+        return -1; // Usuario no encontrado
+    }
+    note_user_changed(username);
+
+    // Buscar su lugar es lineal, pero las bajas son raras
+    for (int i = 0; i < g_shared_data->user_count; i++) {
+        if (g_shared_data->users[i] == user) {
+            unlink_user_at(i);
             break;
         }
     }
-    
-    if (slot == -1) {
-        pthread_mutex_unlock(&g_shared_data->users_mutex);
-        return -2; // No hay espacio
+    retire_user(user);
+    return 0;
+}
+
+// Función para eliminar un usuario
+static int delete_user(const char* username) {
+    pthread_mutex_lock(&g_shared_data->users_mutex);
+    int result = remove_user(username);
+
+    // Persistir cambios
+    users_garbage_t garbage = {0};
+    if (result == 0) {
+        if (user_journal_delete(&g_user_journal, username) < 0) {
+            log_error_limited("Could not save deletion of %s to %s: %s", username, USERS_JOURNAL_FILE, strerror(errno));
+        }
+        maybe_compact_users();
+        g_users_changes++;
+        publish_users(&garbage);
+    }
+    pthread_mutex_unlock(&g_shared_data->users_mutex);
+    release_users_garbage(&garbage);
+    return result;
+}
+
+// Guarda los límites recién cambiados de `user' (con users_mutex tomado):
+// un alta del diario con el mismo hash. Los de un usuario de -u quedan solo
+// en memoria; `*persisted' dice cuál fue.
+static void persist_user_limits(const user_t* user, bool* persisted) {
+    *persisted = user->active == USER_ACTIVE;
+    if (!*persisted) return;
+    char secret[USER_RECORD_LEN];
+    format_user_secret(user, secret, sizeof(secret));
+    if (user_journal_add(&g_user_journal, user->username, secret) < 0) {
+        log_error_limited("Could not save the limits of %s to %s: %s",
+                          user->username, USERS_JOURNAL_FILE, strerror(errno));
     }
-    
-    // Agregar usuario
-    strncpy(g_shared_data->users[slot].username, username, MAX_USERNAME_LEN - 1);
-    strncpy(g_shared_data->users[slot].password, password, MAX_PASSWORD_LEN - 1);
-    g_shared_data->users[slot].username[MAX_USERNAME_LEN - 1] = '\0';
-    g_shared_data->users[slot].password[MAX_PASSWORD_LEN - 1] = '\0';
-    g_shared_data->users[slot].active = 1;
-    
-    if (slot >= g_shared_data->user_count) {
-        g_shared_data->user_count = slot + 1;
+    maybe_compact_users();
+    g_users_changes++;
+}
+
+// Límites de ancho de banda de un usuario. Devuelve -1 si no existe.
+static int set_user_bandwidth(const char* username, uint32_t upload, uint32_t download, bool* persisted) {
+    pthread_mutex_lock(&g_shared_data->users_mutex);
+    user_t* user = find_user(username);
+    if (user != NULL) {
+        set_user_limits(user, upload, download, user->max_connections);
+        persist_user_limits(user, persisted);
     }
-    
     pthread_mutex_unlock(&g_shared_data->users_mutex);
-
-    // Persistir cambios
-    save_users_to_file();
-    return 0;
+    return user != NULL ? 0 : -1;
 }
 
-// Función para eliminar un usuario
-static int delete_user(const char* username) {
+// Máximo de conexiones simultáneas de un usuario. Bajarlo no cierra las que
+// ya tiene: se rechazan las nuevas hasta que quede por debajo. Devuelve -1
+// si no existe.
+static int set_user_max_connections(const char* username, uint32_t max_connections, bool* persisted) {
     pthread_mutex_lock(&g_shared_data->users_mutex);
-    
-    int index = find_user(username);
-    if (index == -1) {
-        pthread_mutex_unlock(&g_shared_data->users_mutex);
-        return -1; // Usuario no encontrado
+    user_t* user = find_user(username);
+    if (user != NULL) {
+        set_user_limits(user, user->upload_limit, user->download_limit, max_connections);
+        persist_user_limits(user, persisted);
     }
-    
-    g_shared_data->users[index].active = 0;
-    memset(&g_shared_data->users[index], 0, sizeof(user_t));
-    
     pthread_mutex_unlock(&g_shared_data->users_mutex);
+    return user != NULL ? 0 : -1;
+}
 
-    // Persistir cambios
-    save_users_to_file();
-    return 0;
+// Aplica un lote de altas y bajas con un solo paso por users_mutex: un
+// write() al diario y una publicación del índice para todo el lote. Solo
+// mira las entradas con results[i] == MGMT_BATCH_OK (las que pasaron la
+// validación y, las altas, ya tienen su hash en hashes[i]) y deja ahí el
+// resultado final. Devuelve cuántas se aplicaron.
+static uint32_t apply_user_batch(const mgmt_batch_entry_t* entries, char (*hashes)[MAX_PASSWORD_HASH_LEN],
+                                 int32_t* results, uint32_t count) {
+    int adds = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        adds += results[i] == MGMT_BATCH_OK && entries[i].op == MGMT_BATCH_ADD;
+    }
+
+    user_journal_batch_t journal = {0};
+    bool journal_failed = false;
+    uint32_t applied = 0;
+    pthread_mutex_lock(&g_shared_data->users_mutex);
+    // Si no alcanza, insert_user lo vuelve a intentar por entrada
+    reserve_users(g_shared_data->user_count + adds);
+    for (uint32_t i = 0; i < count; i++) {
+        if (results[i] != MGMT_BATCH_OK) continue;
+        const char* username = entries[i].username;
+        int journaled;
+        if (entries[i].op == MGMT_BATCH_ADD) {
+            int result = insert_user(username, hashes[i], USER_ACTIVE);
+            if (result != 0) {
+                results[i] = result == -1 ? MGMT_BATCH_EXISTS : MGMT_BATCH_FAILED;
+                continue;
+            }
+            journaled = user_journal_batch_add(&journal, username, hashes[i]);
+        } else {
+            if (remove_user(username) != 0) {
+                results[i] = MGMT_BATCH_NOT_FOUND;
+                continue;
+            }
+            journaled = user_journal_batch_delete(&journal, username);
+        }
+        journal_failed |= journaled < 0;
+        applied++;
+    }
+
+    users_garbage_t garbage = {0};
+    if (applied > 0) {
+        if (journal_failed || user_journal_commit(&g_user_journal, &journal) < 0) {
+            log_error("Could not save a batch of %u user changes to %s: %s",
+                      applied, USERS_JOURNAL_FILE, strerror(errno));
+        }
+        maybe_compact_users();
+        g_users_changes++;
+        publish_users(&garbage);
+    }
+    pthread_mutex_unlock(&g_shared_data->users_mutex);
+    release_users_garbage(&garbage);
+    user_journal_batch_free(&journal);
+    return applied;
 }
 
-// Función para obtener lista de usuarios
-static int get_users(user_t* user_list, int max_users) {
+// Página de la lista de usuarios, sin las contraseñas. Deja en `total' la
+// cantidad configurada.
+static int get_users(user_t* user_list, uint32_t offset, int max_users, uint32_t* total) {
     pthread_mutex_lock(&g_shared_data->users_mutex);
     
     int count = 0;
-    for (int i = 0; i < g_shared_data->user_count && count < max_users; i++) {
-        if (g_shared_data->users[i].active) {
-            memcpy(&user_list[count], &g_shared_data->users[i], sizeof(user_t));
-            count++;
-        }
+    *total = (uint32_t)g_shared_data->user_count;
+    for (uint32_t i = offset; i < *total && count < max_users; i++) {
+        memcpy(&user_list[count], g_shared_data->users[i], sizeof(user_t));
+        memset(user_list[count].password_hash, 0, sizeof(user_list[count].password_hash));
+        count++;
     }
     
     pthread_mutex_unlock(&g_shared_data->users_mutex);
@@ -263,6 +1482,45 @@ static void get_stats(stats_t* stats) {
     pthread_mutex_unlock(&g_shared_data->stats_mutex);
 }
 
+// Cantidad de usuarios activos configurados
+static int count_active_users(void) {
+    pthread_mutex_lock(&g_shared_data->users_mutex);
+    int active_users = g_shared_data->user_count;
+    pthread_mutex_unlock(&g_shared_data->users_mutex);
+    return active_users;
+}
+
+// Copia las estadísticas globales al segmento de memoria compartida nombrado
+void mgmt_publish_stats_shm(void) {
+    if (g_shared_data == NULL || !stats_shm_active()) return;
+
+    stats_t stats;
+    get_stats(&stats);
+    int users = count_active_users();
+
+    stats_shm_layout_t* shm = stats_shm_write_begin();
+    shm->server_start_time = (int64_t)stats.server_start_time;
+    shm->total_connections = stats.total_connections;
+    shm->current_connections = stats.current_connections;
+    shm->peak_concurrent_connections = stats.peak_concurrent_connections;
+    shm->total_bytes_transferred = stats.total_bytes_transferred;
+    shm->configured_users = (uint64_t)users;
+    shm->bytes_rate_1s = stats.rates.bytes_1s;
+    shm->bytes_rate_10s = stats.rates.bytes_10s;
+    shm->bytes_rate_60s = stats.rates.bytes_60s;
+    shm->connection_rate_1s = stats.rates.connections_1s;
+    shm->connection_rate_10s = stats.rates.connections_10s;
+    shm->connection_rate_60s = stats.rates.connections_60s;
+
+    loop_stats_t loop;
+    loop_profiler_snapshot(&loop);
+    shm->loop_wakeups = loop.wakeups;
+    shm->loop_max_handler_ns = loop.interval_max_handler_ns;
+    shm->loop_utilization = loop.utilization;
+    shm->loop_utilization_60s = loop.utilization_60s;
+    stats_shm_write_end();
+}
+
 // Función para actualizar estadísticas globales
 void mgmt_update_stats(uint64_t bytes_transferred, int connection_change) {
     if (g_shared_data == NULL) return;
@@ -290,18 +1548,30 @@ void mgmt_update_stats(uint64_t bytes_transferred, int connection_change) {
 // Función para actualizar estadísticas por usuario
 void mgmt_update_user_stats(const char* username, uint64_t bytes_transferred, int connection_change) {
     if (g_shared_data == NULL || username == NULL) return;
+
+    mgmt_account_user_traffic(username, bytes_transferred, connection_change);
+
+    // También actualizar estadísticas globales
+    mgmt_update_stats(bytes_transferred, connection_change);
+}
+
+// Actualiza solo las estadísticas del usuario. La usa el loop de eventos, que
+// ya contabiliza por su cuenta las conexiones y bytes globales.
+void mgmt_account_user_traffic(const char* username, uint64_t bytes_transferred, int connection_change) {
+    if (g_shared_data == NULL || username == NULL) return;
     
     pthread_mutex_lock(&g_shared_data->users_mutex);
     
     // Buscar el usuario
-    int user_index = find_user(username);
-    if (user_index == -1) {
+    user_t* user = find_user(username);
+    if (user == NULL) {
         pthread_mutex_unlock(&g_shared_data->users_mutex);
         return; // Usuario no encontrado
     }
     
-    user_stats_t* user_stats = &g_shared_data->users[user_index].stats;
+    user_stats_t* user_stats = &user->stats;
     time_t current_time = time(NULL);
+    track_user_rates(user);
     
     if (connection_change > 0) {
         user_stats->total_connections++;
@@ -326,9 +1596,56 @@ void mgmt_update_user_stats(const char* username, uint64_t bytes_transferred, in
     user_stats->current_bytes_transferred += bytes_transferred;
     
     pthread_mutex_unlock(&g_shared_data->users_mutex);
-    
-    // También actualizar estadísticas globales
-    mgmt_update_stats(bytes_transferred, connection_change);
+}
+
+// Recalcula las tasas globales y por usuario. Se llama desde el timer del
+// loop una vez por segundo, nunca por paquete.
+void mgmt_stats_tick(unsigned elapsed_seconds) {
+    if (g_shared_data == NULL || elapsed_seconds == 0) return;
+
+    pthread_mutex_lock(&g_shared_data->stats_mutex);
+    stats_t* stats = &g_shared_data->stats;
+    traffic_rates_tick(&stats->rates, stats->total_bytes_transferred,
+                       stats->total_connections, elapsed_seconds);
+    pthread_mutex_unlock(&g_shared_data->stats_mutex);
+
+    // Solo los usuarios con tráfico reciente: con 100000 configurados, el
+    // tick cuesta lo que cuestan los activos
+    pthread_mutex_lock(&g_shared_data->users_mutex);
+    for (int i = 0; i < g_rate_user_count;) {
+        user_t* user = g_rate_users[i];
+        traffic_rates_tick(&user->stats.rates, user->stats.total_bytes_transferred,
+                           user->stats.total_connections, elapsed_seconds);
+        if (user->stats.current_connections == 0 && traffic_rates_settle(&user->stats.rates)) {
+            user->rates_active = false;
+            g_rate_users[i] = g_rate_users[--g_rate_user_count];
+            continue;
+        }
+        i++;
+    }
+    pthread_mutex_unlock(&g_shared_data->users_mutex);
+}
+
+// Suma una muestra de TCP_INFO de ambas patas al agregado global y al del usuario
+void mgmt_account_path_sample(const char* username, const tcp_leg_sample_t* client, uint32_t client_retransmits,
+                              const tcp_leg_sample_t* remote, uint32_t remote_retransmits) {
+    if (g_shared_data == NULL) return;
+
+    pthread_mutex_lock(&g_shared_data->stats_mutex);
+    path_stats_add(&g_shared_data->stats.path.client, client, client_retransmits);
+    path_stats_add(&g_shared_data->stats.path.remote, remote, remote_retransmits);
+    pthread_mutex_unlock(&g_shared_data->stats_mutex);
+
+    if (username == NULL || username[0] == '\0') return;
+
+    pthread_mutex_lock(&g_shared_data->users_mutex);
+    user_t* user = find_user(username);
+    if (user != NULL) {
+        user_stats_t* user_stats = &user->stats;
+        path_stats_add(&user_stats->path.client, client, client_retransmits);
+        path_stats_add(&user_stats->path.remote, remote, remote_retransmits);
+    }
+    pthread_mutex_unlock(&g_shared_data->users_mutex);
 }
 
 uint64_t mgmt_get_next_connection_id(void) {
@@ -337,10 +1654,256 @@ uint64_t mgmt_get_next_connection_id(void) {
     return __sync_add_and_fetch(&g_shared_data->connection_id_counter, 1);
 }
 
+// Foto de la tabla de conexiones filtrada por usuario (username) y destino
+// (filter), paginada con offset/limit. La lectura usa los seqlocks de la
+// tabla, así que no frena al loop de eventos.
+static int mgmt_list_connections(int client_sock, const mgmt_message_t* msg) {
+    mgmt_connections_response_t response;
+    memset(&response, 0, sizeof(response));
+
+    size_t limit = msg->limit;
+    if (limit == 0 || limit > MGMT_CONNECTIONS_PAGE_MAX) {
+        limit = MGMT_CONNECTIONS_PAGE_MAX;
+    }
+
+    char user_filter[MAX_USERNAME_LEN];
+    char dest_filter[MAX_DESTINATION_LEN];
+    strncpy(user_filter, msg->username, sizeof(user_filter) - 1);
+    user_filter[sizeof(user_filter) - 1] = '\0';
+    strncpy(dest_filter, msg->filter, sizeof(dest_filter) - 1);
+    dest_filter[sizeof(dest_filter) - 1] = '\0';
+
+    conn_query_t query = {
+        .username = user_filter,
+        .destination = dest_filter,
+        .offset = msg->offset,
+        .limit = limit,
+    };
+
+    conn_info_t infos[MGMT_CONNECTIONS_PAGE_MAX];
+    mgmt_connection_entry_t entries[MGMT_CONNECTIONS_PAGE_MAX];
+    size_t total = 0;
+    size_t count = conn_table_query(&query, infos, &total);
+    uint64_t now_ms = monotonicMillis();
+
+    memset(entries, 0, sizeof(entries[0]) * count);
+    for (size_t i = 0; i < count; i++) {
+        mgmt_connection_entry_t* e = &entries[i];
+        const conn_info_t* info = &infos[i];
+        e->connection_id = info->connection_id;
+        memcpy(e->client_address, info->client_address, sizeof(e->client_address));
+        memcpy(e->username, info->username, sizeof(e->username));
+        memcpy(e->destination, info->destination, sizeof(e->destination));
+        strncpy(e->state, conn_state_name(info->state), sizeof(e->state) - 1);
+        e->age_ms = now_ms > info->opened_ms ? now_ms - info->opened_ms : 0;
+        e->idle_ms = now_ms > info->last_activity_ms ? now_ms - info->last_activity_ms : 0;
+        e->bytes_to_remote = info->bytes_to_remote;
+        e->bytes_to_client = info->bytes_to_client;
+        e->pending_to_remote = info->pending_to_remote;
+        e->pending_to_client = info->pending_to_client;
+        e->client_tcp = info->client_tcp;
+        e->remote_tcp = info->remote_tcp;
+    }
+
+    response.success = 1;
+    response.total = (uint32_t)total;
+    response.offset = msg->offset;
+    response.count = (uint32_t)count;
+    snprintf(response.message, sizeof(response.message),
+             "Conexiones activas: %u (mostrando %u desde %u)",
+             response.total, response.count, response.offset);
+
+    return mgmt_send_connections_response(client_sock, &response, entries);
+}
+
+// CMD_FLIGHT_RECORDER: una conexión por `connection_id' o las de `username'
+static int mgmt_dump_flight(int client_sock, const mgmt_message_t* msg) {
+    mgmt_flight_response_t response;
+    memset(&response, 0, sizeof(response));
+
+    char username[MAX_USERNAME_LEN];
+    strncpy(username, msg->username, sizeof(username) - 1);
+    username[sizeof(username) - 1] = '\0';
+    uint64_t connection_id = msg->connection_id;
+
+    size_t max = msg->limit == 0 || msg->limit > MGMT_FLIGHT_MAX ? MGMT_FLIGHT_MAX : msg->limit;
+    flight_record_t records[MGMT_FLIGHT_MAX];
+    size_t count = flight_recorder_query(connection_id, username, records, max);
+
+    response.success = 1;
+    response.count = (uint32_t)count;
+    if (connection_id != 0) {
+        snprintf(response.message, sizeof(response.message),
+                 "Flight recorder de la conexión %llu: %s", (unsigned long long)connection_id,
+                 count > 0 ? "encontrado" : "no hay registro (cerrada sin error o vencida)");
+    } else if (username[0] != '\0') {
+        snprintf(response.message, sizeof(response.message),
+                 "Flight recorder del usuario %s: %u conexiones", username, response.count);
+    } else {
+        snprintf(response.message, sizeof(response.message),
+                 "Conexiones fallidas recientes: %u", response.count);
+    }
+    return mgmt_send_flight_response(client_sock, &response, records);
+}
+
+// CMD_SLOW_HANDSHAKES: los más recientes primero, `limit' acota la cantidad
+static int mgmt_list_slow_handshakes(int client_sock, const mgmt_message_t* msg) {
+    mgmt_slow_handshakes_response_t response;
+    memset(&response, 0, sizeof(response));
+
+    size_t max = msg->limit == 0 || msg->limit > MGMT_SLOW_HANDSHAKES_MAX ? MGMT_SLOW_HANDSHAKES_MAX : msg->limit;
+    slow_handshake_t entries[MGMT_SLOW_HANDSHAKES_MAX];
+    response.count = (uint32_t)slow_handshake_query(entries, max);
+    response.total = slow_handshake_total();
+    response.threshold_ms = slow_handshake_threshold_ms();
+    response.success = 1;
+    if (response.threshold_ms == 0) {
+        snprintf(response.message, sizeof(response.message), "Detector de handshakes lentos apagado");
+    } else {
+        snprintf(response.message, sizeof(response.message),
+                 "Handshakes de más de %u ms: %llu desde el arranque, %u recientes",
+                 response.threshold_ms, (unsigned long long)response.total, response.count);
+    }
+    return mgmt_send_slow_handshakes_response(client_sock, &response, entries);
+}
+
+// Un nombre o una clave que no rompe el formato de auth.db y del diario
+static bool batch_field_valid(const char* value, bool is_username) {
+    if (is_username && value[0] == '\0') return false;
+    return strpbrk(value, is_username ? ":\n\r" : "\n\r") == NULL;
+}
+
+// Un lote para hashear
+typedef struct {
+    mgmt_batch_entry_t* entries;
+    char (*hashes)[MAX_PASSWORD_HASH_LEN];
+    int32_t* results;
+    uint32_t count;
+} batch_hash_t;
+
+// Valida las entradas first, first + step, ... y hashea las claves de las
+// altas. Deja en results[i] MGMT_BATCH_OK si la entrada puede aplicarse y
+// borra las claves.
+static void prepare_batch_slice(void* ctx, uint32_t first, uint32_t step) {
+    batch_hash_t* batch = ctx;
+    for (uint32_t i = first; i < batch->count; i += step) {
+        mgmt_batch_entry_t* entry = &batch->entries[i];
+        entry->username[MAX_USERNAME_LEN - 1] = '\0';
+        entry->password[MAX_PASSWORD_LEN - 1] = '\0';
+        batch->results[i] = MGMT_BATCH_OK;
+        if ((entry->op != MGMT_BATCH_ADD && entry->op != MGMT_BATCH_DEL) ||
+            !batch_field_valid(entry->username, true) ||
+            (entry->op == MGMT_BATCH_ADD && !batch_field_valid(entry->password, false))) {
+            batch->results[i] = MGMT_BATCH_INVALID;
+        } else if (entry->op == MGMT_BATCH_ADD &&
+                   password_hash_make(entry->password, batch->hashes[i], sizeof(batch->hashes[i])) < 0) {
+            log_error("Could not hash the password of user %s", entry->username);
+            batch->results[i] = MGMT_BATCH_FAILED;
+        }
+        explicit_bzero(entry->password, sizeof(entry->password));
+    }
+}
+
+// Prepara el lote sin lock, con las claves hasheadas en paralelo
+static void prepare_user_batch(mgmt_batch_entry_t* entries, char (*hashes)[MAX_PASSWORD_HASH_LEN],
+                               int32_t* results, uint32_t count) {
+    batch_hash_t batch = { entries, hashes, results, count };
+    hash_in_parallel(count, prepare_batch_slice, &batch);
+}
+
+// CMD_BATCH_USERS: recibe `limit' entradas, hashea las claves (el KDF
+// tarda) antes de tomar el lock y aplica todo el lote de una vez
+static int mgmt_batch_users(int client_sock, const mgmt_message_t* msg) {
+    mgmt_batch_response_t response;
+    memset(&response, 0, sizeof(response));
+    uint32_t count = msg->limit;
+    if (count == 0 || count > MGMT_BATCH_MAX) {
+        snprintf(response.message, sizeof(response.message),
+                 "Error: Un lote lleva entre 1 y %d entradas", MGMT_BATCH_MAX);
+        return mgmt_send_batch_response(client_sock, &response, NULL);
+    }
+
+    mgmt_batch_entry_t* entries = malloc(sizeof(*entries) * count);
+    char (*hashes)[MAX_PASSWORD_HASH_LEN] = malloc(sizeof(*hashes) * count);
+    int32_t* results = malloc(sizeof(*results) * count);
+    int status;
+    if (entries == NULL || hashes == NULL || results == NULL) {
+        snprintf(response.message, sizeof(response.message), "Error: Sin memoria para el lote");
+        status = mgmt_send_batch_response(client_sock, &response, NULL);
+    } else if (recv_all(client_sock, entries, sizeof(*entries) * count) < 0) {
+        status = -1;
+    } else {
+        uint64_t started = monotonicMillis();
+        prepare_user_batch(entries, hashes, results, count);
+        response.count = count;
+        response.applied = apply_user_batch(entries, hashes, results, count);
+        response.success = 1;
+        snprintf(response.message, sizeof(response.message), "Lote aplicado: %u de %u entradas",
+                 response.applied, count);
+        log_info("Applied %u of %u batched user changes in %llu ms", response.applied, count,
+                 (unsigned long long)(monotonicMillis() - started));
+        status = mgmt_send_batch_response(client_sock, &response, results);
+    }
+
+    if (entries != NULL) {
+        explicit_bzero(entries, sizeof(*entries) * count);
+    }
+    free(entries);
+    free(hashes);
+    free(results);
+    return status;
+}
+
+static uint64_t destination_samples(const path_destination_t* d) {
+    return d->path.client.samples > d->path.remote.samples ? d->path.client.samples : d->path.remote.samples;
+}
+
+static int compare_destinations(const void* a, const void* b) {
+    uint64_t sa = destination_samples((const path_destination_t*)a);
+    uint64_t sb = destination_samples((const path_destination_t*)b);
+    return sa < sb ? 1 : (sa > sb ? -1 : 0);
+}
+
+// Agregados de TCP_INFO globales y por destino, los más muestreados primero.
+// `limit' acota la cantidad de destinos (0 = todos).
+static int mgmt_list_paths(int client_sock, const mgmt_message_t* msg) {
+    mgmt_paths_response_t response;
+    memset(&response, 0, sizeof(response));
+
+    stats_t stats;
+    get_stats(&stats);
+    response.global = stats.path;
+
+    path_destination_t destinations[PATH_STATS_MAX_DESTINATIONS];
+    mgmt_path_entry_t entries[PATH_STATS_MAX_DESTINATIONS];
+    size_t total = path_stats_destinations(destinations, PATH_STATS_MAX_DESTINATIONS);
+    qsort(destinations, total, sizeof(destinations[0]), compare_destinations);
+
+    size_t count = total;
+    if (msg->limit > 0 && msg->limit < count) {
+        count = msg->limit;
+    }
+
+    uint64_t now_ms = monotonicMillis();
+    memset(entries, 0, sizeof(entries[0]) * count);
+    for (size_t i = 0; i < count; i++) {
+        strncpy(entries[i].destination, destinations[i].destination, sizeof(entries[i].destination) - 1);
+        entries[i].idle_ms = now_ms > destinations[i].last_sample_ms ? now_ms - destinations[i].last_sample_ms : 0;
+        entries[i].path = destinations[i].path;
+    }
+
+    response.success = 1;
+    response.total = (uint32_t)total;
+    response.count = (uint32_t)count;
+    snprintf(response.message, sizeof(response.message),
+             "Caminos TCP obtenidos (%u destinos)", response.total);
+    return mgmt_send_paths_response(client_sock, &response, entries);
+}
+
 // Manejar cliente de gestión con protocolo optimizado
 int mgmt_handle_client(int client_sock) {
     if (g_shared_data == NULL) {
-        printf("[ERR] Shared memory not initialized\n");
+        log_error("Shared memory not initialized");
         return -1;
     }
     
@@ -365,6 +1928,12 @@ int mgmt_handle_client(int client_sock) {
                 } else if (result == -1) {
                     response.success = 0;
                     snprintf(response.message, sizeof(response.message), "Error: El usuario %s ya existe", msg.username);
+                } else if (result == -3) {
+                    response.success = 0;
+                    snprintf(response.message, sizeof(response.message), "Error: No se pudo hashear la clave");
+                } else if (result == -4) {
+                    response.success = 0;
+                    snprintf(response.message, sizeof(response.message), "Error: Nombre de usuario o clave inválidos");
                 } else {
                     response.success = 0;
                     snprintf(response.message, sizeof(response.message), "Error: No hay espacio para más usuarios");
@@ -394,12 +1963,19 @@ int mgmt_handle_client(int client_sock) {
             {
                 mgmt_users_response_t response;
                 memset(&response, 0, sizeof(response));
-                
-                response.user_count = get_users(response.users, MAX_USERS);
+
+                int limit = (int)msg.limit;
+                if (limit <= 0 || limit > MGMT_USERS_PAGE_MAX) {
+                    limit = MGMT_USERS_PAGE_MAX;
+                }
+                user_t users[MGMT_USERS_PAGE_MAX];
+                response.count = (uint32_t)get_users(users, msg.offset, limit, &response.total);
+                response.offset = msg.offset;
                 response.success = 1;
-                snprintf(response.message, sizeof(response.message), "Lista de usuarios obtenida (%d usuarios)", response.user_count);
+                snprintf(response.message, sizeof(response.message), "Lista de usuarios obtenida (%u de %u usuarios)",
+                         response.count, response.total);
                 
-                return mgmt_send_users_response(client_sock, &response);
+                return mgmt_send_users_response(client_sock, &response, users);
             }
             
         case CMD_STATS:
@@ -409,14 +1985,7 @@ int mgmt_handle_client(int client_sock) {
                 
                 get_stats(&response.stats);
                 // Solo enviar el número de usuarios configurados, no los datos específicos
-                pthread_mutex_lock(&g_shared_data->users_mutex);
-                int active_users = 0;
-                for (int i = 0; i < g_shared_data->user_count; i++) {
-                    if (g_shared_data->users[i].active) {
-                        active_users++;
-                    }
-                }
-                pthread_mutex_unlock(&g_shared_data->users_mutex);
+                int active_users = count_active_users();
                 
                 response.user_count = active_users;
                 response.success = 1;
@@ -528,14 +2097,90 @@ int mgmt_handle_client(int client_sock) {
             {
                 mgmt_simple_response_t response;
                 memset(&response, 0, sizeof(response));
-                // En una implementación real, aquí se volvería a cargar la configuración
-                // desde un archivo. Por ahora, se envía éxito.
+                response.success = reload_all(response.message, sizeof(response.message)) ? 1 : 0;
+                return mgmt_send_simple_response(client_sock, &response);
+            }
+
+        case CMD_ROTATE_LOGS:
+            {
+                mgmt_simple_response_t response;
+                memset(&response, 0, sizeof(response));
+                // Cada escritor rota su archivo desde su propio hilo: metrics.log
+                // enseguida, access.bin y pop3_credentials.log en el próximo tick
+                uint32_t generation = logger_request_rotation();
                 response.success = 1;
                 snprintf(response.message, sizeof(response.message),
-                         "Configuración recargada exitosamente");
+                         "Rotación de logs solicitada (generación %u)", generation);
+                log_info("Log rotation requested via management interface");
+                return mgmt_send_simple_response(client_sock, &response);
+            }
+
+        case CMD_LIST_CONNECTIONS:
+            return mgmt_list_connections(client_sock, &msg);
+
+        case CMD_PATH_STATS:
+            return mgmt_list_paths(client_sock, &msg);
+
+        case CMD_FLIGHT_RECORDER:
+            return mgmt_dump_flight(client_sock, &msg);
+
+        case CMD_BATCH_USERS:
+            return mgmt_batch_users(client_sock, &msg);
+
+        case CMD_SET_BANDWIDTH:
+            {
+                // `offset' es la subida y `limit' la bajada, en bytes/s
+                mgmt_simple_response_t response;
+                memset(&response, 0, sizeof(response));
+
+                bool persisted = false;
+                if (set_user_bandwidth(msg.username, msg.offset, msg.limit, &persisted) < 0) {
+                    snprintf(response.message, sizeof(response.message), "Error: Usuario %s no encontrado", msg.username);
+                } else {
+                    response.success = 1;
+                    snprintf(response.message, sizeof(response.message),
+                             "Límites de %s: subida %u B/s, bajada %u B/s (0 = sin límite)%s", msg.username,
+                             msg.offset, msg.limit, persisted ? "" : "; usuario de -u, no se guardan");
+                    log_info("Bandwidth limits of %s set to %u B/s up, %u B/s down", msg.username, msg.offset, msg.limit);
+                }
+                return mgmt_send_simple_response(client_sock, &response);
+            }
+
+        case CMD_SET_MAX_CONNECTIONS:
+            {
+                // `limit' es el máximo de conexiones simultáneas
+                mgmt_simple_response_t response;
+                memset(&response, 0, sizeof(response));
+
+                bool persisted = false;
+                if (set_user_max_connections(msg.username, msg.limit, &persisted) < 0) {
+                    snprintf(response.message, sizeof(response.message), "Error: Usuario %s no encontrado", msg.username);
+                } else {
+                    response.success = 1;
+                    snprintf(response.message, sizeof(response.message),
+                             "Máximo de conexiones simultáneas de %s: %u (0 = sin límite)%s", msg.username,
+                             msg.limit, persisted ? "" : "; usuario de -u, no se guarda");
+                    log_info("Connection limit of %s set to %u", msg.username, msg.limit);
+                }
                 return mgmt_send_simple_response(client_sock, &response);
             }
 
+        case CMD_SLOW_HANDSHAKES:
+            return mgmt_list_slow_handshakes(client_sock, &msg);
+
+        case CMD_LOOP_STATS:
+            {
+                mgmt_loop_stats_response_t response;
+                memset(&response, 0, sizeof(response));
+                loop_profiler_snapshot(&response.loop);
+                loop_watchdog_snapshot(&response.watchdog);
+                response.success = 1;
+                snprintf(response.message, sizeof(response.message),
+                         "Perfil del loop de eventos obtenido (utilización %.1f%%)",
+                         response.loop.utilization * 100.0);
+                return mgmt_send_loop_stats_response(client_sock, &response);
+            }
+
         case CMD_GET_CONFIG:
             {
                 mgmt_config_response_t response;
@@ -622,6 +2267,65 @@ int mgmt_send_command(int sock, mgmt_command_t cmd, const char* username, const
     return 0;
 }
 
+// Enviar comando con filtros y paginación (CMD_LIST_CONNECTIONS, etc.)
+int mgmt_send_paged_command(int sock, mgmt_command_t cmd, const char* username, const char* filter,
+                            uint32_t offset, uint32_t limit) {
+    mgmt_message_t msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.command = cmd;
+    msg.offset = offset;
+    msg.limit = limit;
+
+    if (username) {
+        strncpy(msg.username, username, MAX_USERNAME_LEN - 1);
+    }
+    if (filter) {
+        strncpy(msg.filter, filter, MAX_DESTINATION_LEN - 1);
+    }
+
+    if (send_all(sock, &msg, sizeof(msg)) < 0) {
+        perror("Error sending message");
+        return -1;
+    }
+    return 0;
+}
+
+// Enviar un pedido del flight recorder (CMD_FLIGHT_RECORDER)
+int mgmt_send_flight_command(int sock, const char* username, uint64_t connection_id, uint32_t limit) {
+    mgmt_message_t msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.command = CMD_FLIGHT_RECORDER;
+    msg.limit = limit;
+    msg.connection_id = connection_id;
+
+    if (username) {
+        strncpy(msg.username, username, MAX_USERNAME_LEN - 1);
+    }
+
+    if (send_all(sock, &msg, sizeof(msg)) < 0) {
+        perror("Error sending message");
+        return -1;
+    }
+    return 0;
+}
+
+// Enviar un lote de altas y bajas (CMD_BATCH_USERS); la cantidad va en `limit'
+int mgmt_send_batch_command(int sock, const mgmt_batch_entry_t* entries, uint32_t count) {
+    mgmt_message_t msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.command = CMD_BATCH_USERS;
+    msg.limit = count;
+
+    if (send_all(sock, &msg, sizeof(msg)) < 0 || send_all(sock, entries, sizeof(*entries) * count) < 0) {
+        perror("Error sending message");
+        return -1;
+    }
+    return 0;
+}
+
 // Recibir respuesta del servidor
 int mgmt_receive_response(int sock, mgmt_response_t* response) {
     if (!response) {
@@ -658,9 +2362,13 @@ int mgmt_receive_stats_response(int sock, mgmt_stats_response_t* response) {
 }
 
 // Recibir respuesta de usuarios optimizada
-int mgmt_receive_users_response(int sock, mgmt_users_response_t* response) {
+int mgmt_receive_users_response(int sock, mgmt_users_response_t* response,
+                                user_t* users, uint32_t max_users) {
     if (!response) return -1;
-    return recv_all(sock, response, sizeof(*response));
+    if (recv_all(sock, response, sizeof(*response)) < 0) return -1;
+    if (response->count > max_users) return -1;
+    if (response->count == 0) return 0;
+    return recv_all(sock, users, sizeof(*users) * response->count);
 }
 
 // Recibir respuesta simple optimizada
@@ -675,10 +2383,12 @@ int mgmt_send_stats_response(int sock, mgmt_stats_response_t* response) {
     return send_all(sock, response, sizeof(*response));
 }
 
-// Enviar respuesta de usuarios optimizada
-int mgmt_send_users_response(int sock, mgmt_users_response_t* response) {
+// Enviar encabezado de usuarios seguido de la página
+int mgmt_send_users_response(int sock, mgmt_users_response_t* response, const user_t* users) {
     if (!response) return -1;
-    return send_all(sock, response, sizeof(*response));
+    if (send_all(sock, response, sizeof(*response)) < 0) return -1;
+    if (response->count == 0) return 0;
+    return send_all(sock, users, sizeof(*users) * response->count);
 }
 
 // Enviar respuesta simple optimizada
@@ -687,6 +2397,108 @@ int mgmt_send_simple_response(int sock, mgmt_simple_response_t* response) {
     return send_all(sock, response, sizeof(*response));
 }
 
+// Enviar encabezado de conexiones seguido de las entradas
+int mgmt_send_connections_response(int sock, mgmt_connections_response_t* response,
+                                   const mgmt_connection_entry_t* entries) {
+    if (!response) return -1;
+    if (send_all(sock, response, sizeof(*response)) < 0) return -1;
+    if (response->count == 0) return 0;
+    return send_all(sock, entries, sizeof(*entries) * response->count);
+}
+
+// Enviar encabezado de caminos seguido de las entradas
+int mgmt_send_paths_response(int sock, mgmt_paths_response_t* response, const mgmt_path_entry_t* entries) {
+    if (!response) return -1;
+    if (send_all(sock, response, sizeof(*response)) < 0) return -1;
+    if (response->count == 0) return 0;
+    return send_all(sock, entries, sizeof(*entries) * response->count);
+}
+
+// Recibir encabezado de caminos y hasta max_entries entradas
+int mgmt_receive_paths_response(int sock, mgmt_paths_response_t* response,
+                                mgmt_path_entry_t* entries, uint32_t max_entries) {
+    if (!response) return -1;
+    if (recv_all(sock, response, sizeof(*response)) < 0) return -1;
+    if (response->count > max_entries) return -1;
+    if (response->count == 0) return 0;
+    return recv_all(sock, entries, sizeof(*entries) * response->count);
+}
+
+// Enviar encabezado del flight recorder seguido de los rings
+int mgmt_send_flight_response(int sock, mgmt_flight_response_t* response, const flight_record_t* records) {
+    if (!response) return -1;
+    if (send_all(sock, response, sizeof(*response)) < 0) return -1;
+    if (response->count == 0) return 0;
+    return send_all(sock, records, sizeof(*records) * response->count);
+}
+
+int mgmt_receive_flight_response(int sock, mgmt_flight_response_t* response,
+                                 flight_record_t* records, uint32_t max_records) {
+    if (!response) return -1;
+    if (recv_all(sock, response, sizeof(*response)) < 0) return -1;
+    if (response->count > max_records) return -1;
+    if (response->count == 0) return 0;
+    return recv_all(sock, records, sizeof(*records) * response->count);
+}
+
+// Enviar encabezado de handshakes lentos seguido de las entradas
+int mgmt_send_slow_handshakes_response(int sock, mgmt_slow_handshakes_response_t* response,
+                                       const slow_handshake_t* entries) {
+    if (!response) return -1;
+    if (send_all(sock, response, sizeof(*response)) < 0) return -1;
+    if (response->count == 0) return 0;
+    return send_all(sock, entries, sizeof(*entries) * response->count);
+}
+
+int mgmt_receive_slow_handshakes_response(int sock, mgmt_slow_handshakes_response_t* response,
+                                          slow_handshake_t* entries, uint32_t max_entries) {
+    if (!response) return -1;
+    if (recv_all(sock, response, sizeof(*response)) < 0) return -1;
+    if (response->count > max_entries) return -1;
+    if (response->count == 0) return 0;
+    return recv_all(sock, entries, sizeof(*entries) * response->count);
+}
+
+// Enviar encabezado del lote seguido del resultado de cada entrada
+int mgmt_send_batch_response(int sock, mgmt_batch_response_t* response, const int32_t* results) {
+    if (!response) return -1;
+    if (send_all(sock, response, sizeof(*response)) < 0) return -1;
+    if (response->count == 0) return 0;
+    return send_all(sock, results, sizeof(*results) * response->count);
+}
+
+// Recibir encabezado del lote y hasta max_results resultados
+int mgmt_receive_batch_response(int sock, mgmt_batch_response_t* response,
+                                int32_t* results, uint32_t max_results) {
+    if (!response) return -1;
+    if (recv_all(sock, response, sizeof(*response)) < 0) return -1;
+    if (response->count > max_results) return -1;
+    if (response->count == 0) return 0;
+    return recv_all(sock, results, sizeof(*results) * response->count);
+}
+
+// Enviar perfil del loop de eventos
+int mgmt_send_loop_stats_response(int sock, mgmt_loop_stats_response_t* response) {
+    if (!response) return -1;
+    return send_all(sock, response, sizeof(*response));
+}
+
+// Recibir perfil del loop de eventos
+int mgmt_receive_loop_stats_response(int sock, mgmt_loop_stats_response_t* response) {
+    if (!response) return -1;
+    return recv_all(sock, response, sizeof(*response));
+}
+
+// Recibir encabezado de conexiones y hasta max_entries entradas
+int mgmt_receive_connections_response(int sock, mgmt_connections_response_t* response,
+                                      mgmt_connection_entry_t* entries, uint32_t max_entries) {
+    if (!response) return -1;
+    if (recv_all(sock, response, sizeof(*response)) < 0) return -1;
+    if (response->count > max_entries) return -1;
+    if (response->count == 0) return 0;
+    return recv_all(sock, entries, sizeof(*entries) * response->count);
+}
+
 int mgmt_get_buffer_size(void) {
     pthread_mutex_lock(&g_config_mutex);
     int value = g_buffer_size;
@@ -751,7 +2563,7 @@ int mgmt_server_start(int port) {
         return -1;
     }
     
-    printf("[INF] Management server listening on port %d\n", port);
+    log_info("Management server listening on port %d", port);
     return server_sock;
 }
 
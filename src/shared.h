@@ -8,15 +8,30 @@
 #include <time.h>
 #include <stdbool.h>
 
+#include "utils/rates.h"
+#include "utils/loop_profiler.h"
+#include "utils/loop_watchdog.h"
+#include "utils/path_stats.h"
+#include "utils/flight_recorder.h"
+#include "utils/slow_handshake.h"
+#include "utils/password_hash.h"
+
 #define MGMT_PORT 8080
 #define MGMT_HOST "127.0.0.1"
 #define MAX_USERNAME_LEN 64
 #define MAX_PASSWORD_LEN 64
-#define MAX_USERS 10
+#define MAX_USERS 10                // solo para el mgmt_response_t histórico
 #define MAX_MESSAGE_LEN 1024
 #define DEFAULT_BUFFER_SIZE 4096
 #define MAX_BUFFER_CAPACITY 65536
 #define MIN_BUFFER_SIZE 512
+#define MAX_ADDRESS_LEN 64          // "ip:puerto" de un cliente
+#define MAX_DESTINATION_LEN 272     // dominio (255) + ':' + puerto
+#define MGMT_CONNECTIONS_PAGE_MAX 256
+#define MGMT_USERS_PAGE_MAX 256
+#define MGMT_FLIGHT_MAX 16
+#define MGMT_SLOW_HANDSHAKES_MAX SLOW_HANDSHAKE_RETAINED
+#define MGMT_BATCH_MAX 16384       // entradas por CMD_BATCH_USERS
 
 // Comandos del protocolo de gestión
 typedef enum {
@@ -30,7 +45,16 @@ typedef enum {
     CMD_ENABLE_DISSECTORS,
     CMD_DISABLE_DISSECTORS,
     CMD_RELOAD_CONFIG,
-    CMD_GET_CONFIG
+    CMD_GET_CONFIG,
+    CMD_LIST_CONNECTIONS,
+    CMD_LOOP_STATS,
+    CMD_PATH_STATS,
+    CMD_ROTATE_LOGS,
+    CMD_FLIGHT_RECORDER,
+    CMD_SLOW_HANDSHAKES,
+    CMD_BATCH_USERS,
+    CMD_SET_BANDWIDTH,
+    CMD_SET_MAX_CONNECTIONS
 } mgmt_command_t;
 
 // Estructura para estadísticas por usuario
@@ -42,13 +66,23 @@ typedef struct {
     time_t last_connection_time;
     time_t first_connection_time;
     uint64_t total_connection_time;  // Tiempo total conectado en segundos
+    traffic_rates_t rates;           // Tasas 1s/10s/60s, actualizadas por el tick
+    tcp_path_stats_t path;           // TCP_INFO muestreado de sus conexiones
 } user_stats_t;
 
+// Valores de user_t.active (0 = slot libre)
+#define USER_ACTIVE 1           // alta por management o auth.db; se persiste
+#define USER_ACTIVE_STATIC 2    // -u de la línea de comandos; no se persiste
+
 // Estructura para almacenar un usuario
 typedef struct {
     char username[MAX_USERNAME_LEN];
-    char password[MAX_PASSWORD_LEN];
-    int active;
+    char password_hash[MAX_PASSWORD_HASH_LEN];  // crypt(3); en ceros por management
+    int active;             // USER_ACTIVE*
+    uint32_t upload_limit;  // bytes/s de cliente a destino; 0 = sin límite
+    uint32_t download_limit; // bytes/s de destino a cliente; 0 = sin límite
+    uint32_t max_connections; // conexiones simultáneas; 0 = sin límite
+    bool rates_active;      // interno del servidor: el timer recalcula sus tasas
     user_stats_t stats;  // Estadísticas específicas del usuario
 } user_t;
 
@@ -61,11 +95,17 @@ typedef struct {
     int current_users;
     time_t server_start_time;
     uint64_t peak_concurrent_connections;
+    traffic_rates_t rates;           // Tasas 1s/10s/60s, actualizadas por el tick
+    tcp_path_stats_t path;           // TCP_INFO muestreado de todas las conexiones
 } stats_t;
 
 // Estructura para datos compartidos entre procesos
 typedef struct {
-    user_t users[MAX_USERS];
+    // Usuarios: cada user_t se aloca aparte (su dirección no cambia mientras
+    // existe, el índice por nombre apunta a ella) y `users' los lista sin
+    // huecos; una baja mueve el último al lugar del borrado.
+    user_t** users;
+    int user_capacity;
     stats_t stats;
     int user_count;
     uint64_t connection_id_counter;
@@ -78,6 +118,10 @@ typedef struct {
     mgmt_command_t command;
     char username[MAX_USERNAME_LEN];
     char password[MAX_PASSWORD_LEN];
+    uint32_t offset;    // paginación: primera entrada a devolver
+    uint32_t limit;     // paginación: cantidad máxima de entradas (0 = default)
+    char filter[MAX_DESTINATION_LEN];   // CMD_LIST_CONNECTIONS: substring del destino
+    uint64_t connection_id;             // CMD_FLIGHT_RECORDER: conexión pedida (0 = ninguna)
 } mgmt_message_t;
 
 // Estructura para la respuesta
@@ -97,11 +141,13 @@ typedef struct {
     int user_count;
 } mgmt_stats_response_t;
 
+// Encabezado de CMD_LIST_USERS; lo siguen `count' user_t (sin contraseña)
 typedef struct {
     int success;
     char message[MAX_MESSAGE_LEN];
-    user_t users[MAX_USERS];
-    int user_count;
+    uint32_t total;     // usuarios configurados
+    uint32_t offset;
+    uint32_t count;
 } mgmt_users_response_t;
 
 typedef struct {
@@ -119,22 +165,142 @@ typedef struct {
     int dissectors_enabled; // 1 habilitado, 0 deshabilitado
 } mgmt_config_response_t;
 
+// Una conexión viva en la respuesta de CMD_LIST_CONNECTIONS
+typedef struct {
+    uint64_t connection_id;
+    char client_address[MAX_ADDRESS_LEN];
+    char username[MAX_USERNAME_LEN];
+    char destination[MAX_DESTINATION_LEN];
+    char state[16];
+    uint64_t age_ms;
+    uint64_t idle_ms;
+    uint64_t bytes_to_remote;
+    uint64_t bytes_to_client;
+    uint32_t pending_to_remote;
+    uint32_t pending_to_client;
+    tcp_leg_sample_t client_tcp;    // última muestra de TCP_INFO (valid = 0 si no hay)
+    tcp_leg_sample_t remote_tcp;
+} mgmt_connection_entry_t;
+
+// Encabezado de CMD_LIST_CONNECTIONS; lo siguen `count' mgmt_connection_entry_t
+typedef struct {
+    int success;
+    char message[MAX_MESSAGE_LEN];
+    uint32_t total;     // conexiones que cumplen el filtro
+    uint32_t offset;
+    uint32_t count;
+} mgmt_connections_response_t;
+
+// Un destino en la respuesta de CMD_PATH_STATS
+typedef struct {
+    char destination[MAX_DESTINATION_LEN];
+    uint64_t idle_ms;               // desde la última muestra
+    tcp_path_stats_t path;
+} mgmt_path_entry_t;
+
+// Encabezado de CMD_PATH_STATS; lo siguen `count' mgmt_path_entry_t
+typedef struct {
+    int success;
+    char message[MAX_MESSAGE_LEN];
+    tcp_path_stats_t global;
+    uint32_t total;     // destinos registrados
+    uint32_t count;
+} mgmt_paths_response_t;
+
+// Autoperfilado del loop de eventos (CMD_LOOP_STATS)
+typedef struct {
+    int success;
+    char message[MAX_MESSAGE_LEN];
+    loop_stats_t loop;
+    loop_watchdog_stats_t watchdog;
+} mgmt_loop_stats_response_t;
+
+// Encabezado de CMD_FLIGHT_RECORDER; lo siguen `count' flight_record_t
+typedef struct {
+    int success;
+    char message[MAX_MESSAGE_LEN];
+    uint32_t count;
+} mgmt_flight_response_t;
+
+// Encabezado de CMD_SLOW_HANDSHAKES; lo siguen `count' slow_handshake_t
+typedef struct {
+    int success;
+    char message[MAX_MESSAGE_LEN];
+    uint32_t threshold_ms;      // 0 = detector apagado
+    uint32_t count;
+    uint64_t total;             // handshakes lentos desde el arranque
+} mgmt_slow_handshakes_response_t;
+
+// Operación de una entrada de CMD_BATCH_USERS
+typedef enum {
+    MGMT_BATCH_ADD,
+    MGMT_BATCH_DEL
+} mgmt_batch_op_t;
+
+// Una entrada de CMD_BATCH_USERS. El mensaje trae la cantidad en `limit' y
+// lo siguen las entradas; se aplican en orden.
+typedef struct {
+    uint32_t op;        // mgmt_batch_op_t
+    char username[MAX_USERNAME_LEN];
+    char password[MAX_PASSWORD_LEN];    // solo en MGMT_BATCH_ADD
+} mgmt_batch_entry_t;
+
+// Resultado de cada entrada de CMD_BATCH_USERS
+#define MGMT_BATCH_OK 0
+#define MGMT_BATCH_EXISTS 1         // alta de un usuario que ya existe
+#define MGMT_BATCH_NOT_FOUND 2      // baja de un usuario que no existe
+#define MGMT_BATCH_INVALID 3        // nombre vacío o con ':', u operación desconocida
+#define MGMT_BATCH_FAILED 4         // no se pudo hashear la clave o sin memoria
+
+// Encabezado de CMD_BATCH_USERS; lo siguen `count' int32_t con el
+// resultado de cada entrada (MGMT_BATCH_*), en el orden del pedido
+typedef struct {
+    int success;
+    char message[MAX_MESSAGE_LEN];
+    uint32_t count;
+    uint32_t applied;   // entradas con MGMT_BATCH_OK
+} mgmt_batch_response_t;
+
 // Funciones para comunicación cliente-servidor
 int mgmt_connect_to_server(void);
 int mgmt_send_command(int sock, mgmt_command_t cmd, const char* username, const char* password);
+int mgmt_send_paged_command(int sock, mgmt_command_t cmd, const char* username, const char* filter,
+                            uint32_t offset, uint32_t limit);
+int mgmt_send_flight_command(int sock, const char* username, uint64_t connection_id, uint32_t limit);
+int mgmt_send_batch_command(int sock, const mgmt_batch_entry_t* entries, uint32_t count);
 int mgmt_receive_response(int sock, mgmt_response_t* response);
 void mgmt_close_connection(int sock);
 void* mgmt_accept_loop(void* arg);
 
 // Funciones optimizadas para comunicación específica por comando
 int mgmt_receive_stats_response(int sock, mgmt_stats_response_t* response);
-int mgmt_receive_users_response(int sock, mgmt_users_response_t* response);
+int mgmt_receive_users_response(int sock, mgmt_users_response_t* response,
+                                user_t* users, uint32_t max_users);
 int mgmt_receive_simple_response(int sock, mgmt_simple_response_t* response);
 int mgmt_receive_config_response(int sock, mgmt_config_response_t* response);
 int mgmt_send_config_response(int sock, mgmt_config_response_t* response);
 int mgmt_send_stats_response(int sock, mgmt_stats_response_t* response);
-int mgmt_send_users_response(int sock, mgmt_users_response_t* response);
+int mgmt_send_users_response(int sock, mgmt_users_response_t* response, const user_t* users);
 int mgmt_send_simple_response(int sock, mgmt_simple_response_t* response);
+int mgmt_send_connections_response(int sock, mgmt_connections_response_t* response,
+                                   const mgmt_connection_entry_t* entries);
+int mgmt_send_paths_response(int sock, mgmt_paths_response_t* response, const mgmt_path_entry_t* entries);
+int mgmt_receive_paths_response(int sock, mgmt_paths_response_t* response,
+                                mgmt_path_entry_t* entries, uint32_t max_entries);
+int mgmt_send_flight_response(int sock, mgmt_flight_response_t* response, const flight_record_t* records);
+int mgmt_receive_flight_response(int sock, mgmt_flight_response_t* response,
+                                 flight_record_t* records, uint32_t max_records);
+int mgmt_send_slow_handshakes_response(int sock, mgmt_slow_handshakes_response_t* response,
+                                       const slow_handshake_t* entries);
+int mgmt_receive_slow_handshakes_response(int sock, mgmt_slow_handshakes_response_t* response,
+                                          slow_handshake_t* entries, uint32_t max_entries);
+int mgmt_send_batch_response(int sock, mgmt_batch_response_t* response, const int32_t* results);
+int mgmt_receive_batch_response(int sock, mgmt_batch_response_t* response,
+                                int32_t* results, uint32_t max_results);
+int mgmt_send_loop_stats_response(int sock, mgmt_loop_stats_response_t* response);
+int mgmt_receive_loop_stats_response(int sock, mgmt_loop_stats_response_t* response);
+int mgmt_receive_connections_response(int sock, mgmt_connections_response_t* response,
+                                      mgmt_connection_entry_t* entries, uint32_t max_entries);
 int mgmt_get_buffer_size(void);
 bool mgmt_are_dissectors_enabled(void);
 
@@ -150,8 +316,32 @@ shared_data_t* mgmt_get_shared_data(void);
 // Funciones para actualizar estadísticas
 void mgmt_update_stats(uint64_t bytes_transferred, int connection_change);
 void mgmt_update_user_stats(const char* username, uint64_t bytes_transferred, int connection_change);
+void mgmt_account_user_traffic(const char* username, uint64_t bytes_transferred, int connection_change);
+void mgmt_stats_tick(unsigned elapsed_seconds);
+void mgmt_account_path_sample(const char* username, const tcp_leg_sample_t* client, uint32_t client_retransmits,
+                              const tcp_leg_sample_t* remote, uint32_t remote_retransmits);
+void mgmt_publish_stats_shm(void);
 uint64_t mgmt_get_next_connection_id(void);
 
+// Usuarios: un índice hash por nombre con los de auth.db, management y -u
+int mgmt_add_static_user(const char* username, const char* password);
+bool mgmt_check_credentials(const char* username, const char* password);
+// Sin el KDF: 1 válidas (verificadas hace poco), -1 hay que llamar a
+// mgmt_check_credentials (también si el usuario no existe)
+int mgmt_check_credentials_cached(const char* username, const char* password);
+bool mgmt_has_users(void);
+// Límites de ancho de banda de `username' (false si no existe). La
+// generación cambia cada vez que management o una recarga tocan límites.
+bool mgmt_get_user_bandwidth(const char* username, uint32_t* upload, uint32_t* download);
+uint64_t mgmt_bandwidth_generation(void);
+// Máximo de conexiones simultáneas de `username' (0 = sin límite o no existe)
+uint32_t mgmt_get_user_max_connections(const char* username);
+
+// Recarga (CMD_RELOAD_CONFIG y, con --watch, inotify): auth.db con sus
+// diarios y el archivo de --config
+int mgmt_load_config_file(const char* path);
+int mgmt_watch_config_files(void);
+
 // Funciones utilitarias
 void sayHello(void);
 
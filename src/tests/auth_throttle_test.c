@@ -0,0 +1,130 @@
+#include <arpa/inet.h>
+#include <assert.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "utils/auth_throttle.h"
+
+static struct sockaddr_in ipv4(const char *text) {
+    struct sockaddr_in addr = { .sin_family = AF_INET };
+    assert(inet_pton(AF_INET, text, &addr.sin_addr) == 1);
+    return addr;
+}
+
+static struct sockaddr_in6 ipv6(const char *text) {
+    struct sockaddr_in6 addr = { .sin6_family = AF_INET6 };
+    assert(inet_pton(AF_INET6, text, &addr.sin6_addr) == 1);
+    return addr;
+}
+
+// `count' failures from `addr' at `now'
+static void fail(const void *addr, int count, uint64_t now) {
+    for (int i = 0; i < count; i++) {
+        auth_throttle_failure(addr, now);
+    }
+}
+
+static bool blocked(const void *addr, uint64_t now) {
+    return auth_throttle_blocked(addr, now);
+}
+
+static void test_backoff(void) {
+    printf("Running auth throttle back-off test...\n");
+    struct sockaddr_in addr = ipv4("192.0.2.1");
+    uint64_t now = 1000000;
+
+    // The free failures never block
+    fail(&addr, AUTH_THROTTLE_FREE_FAILURES, now);
+    assert(!blocked(&addr, now));
+
+    // Each one after them blocks for twice as long as the previous one
+    fail(&addr, 1, now);
+    assert(blocked(&addr, now));
+    assert(blocked(&addr, now + AUTH_THROTTLE_BASE_MS - 1));
+    assert(!blocked(&addr, now + AUTH_THROTTLE_BASE_MS));
+
+    now += AUTH_THROTTLE_BASE_MS;
+    fail(&addr, 1, now);
+    assert(blocked(&addr, now + 2 * AUTH_THROTTLE_BASE_MS - 1));
+    assert(!blocked(&addr, now + 2 * AUTH_THROTTLE_BASE_MS));
+
+    now += 2 * AUTH_THROTTLE_BASE_MS;
+    fail(&addr, 1, now);
+    assert(blocked(&addr, now + 4 * AUTH_THROTTLE_BASE_MS - 1));
+    assert(!blocked(&addr, now + 4 * AUTH_THROTTLE_BASE_MS));
+
+    // Up to the maximum, however many failures there are
+    now += 4 * AUTH_THROTTLE_BASE_MS;
+    fail(&addr, 40, now);
+    assert(blocked(&addr, now + AUTH_THROTTLE_MAX_MS - 1));
+    assert(!blocked(&addr, now + AUTH_THROTTLE_MAX_MS));
+
+    // Other addresses are not affected
+    struct sockaddr_in other = ipv4("192.0.2.2");
+    assert(!blocked(&other, now));
+    printf("Auth throttle back-off test passed!\n");
+}
+
+static void test_decay(void) {
+    printf("Running auth throttle decay test...\n");
+    struct sockaddr_in addr = ipv4("198.51.100.7");
+    uint64_t now = 50000000;
+
+    // Six failures: blocked once
+    fail(&addr, AUTH_THROTTLE_FREE_FAILURES + 1, now);
+    assert(blocked(&addr, now));
+
+    // One half-life later the count is 3: two more are free again, the
+    // third blocks for the base time
+    now += AUTH_THROTTLE_HALF_LIFE_MS;
+    assert(!blocked(&addr, now));
+    fail(&addr, 2, now);
+    assert(!blocked(&addr, now));
+    fail(&addr, 1, now);
+    assert(blocked(&addr, now + AUTH_THROTTLE_BASE_MS - 1));
+    assert(!blocked(&addr, now + AUTH_THROTTLE_BASE_MS));
+
+    // Less than a half-life does not decay at all
+    now += AUTH_THROTTLE_HALF_LIFE_MS - 1;
+    fail(&addr, 1, now);
+    assert(blocked(&addr, now + 2 * AUTH_THROTTLE_BASE_MS - 1));
+
+    // After many half-lives it starts over from zero
+    now += 64 * (uint64_t)AUTH_THROTTLE_HALF_LIFE_MS;
+    fail(&addr, AUTH_THROTTLE_FREE_FAILURES, now);
+    assert(!blocked(&addr, now));
+    printf("Auth throttle decay test passed!\n");
+}
+
+static void test_ipv6_prefix(void) {
+    printf("Running auth throttle IPv6 /64 test...\n");
+    uint64_t now = 90000000;
+    struct sockaddr_in6 a = ipv6("2001:db8:1:2::1");
+    struct sockaddr_in6 b = ipv6("2001:db8:1:2:ffff::9");
+    struct sockaddr_in6 other = ipv6("2001:db8:1:3::1");
+
+    // Failures from anywhere in the /64 add up
+    fail(&a, AUTH_THROTTLE_FREE_FAILURES, now);
+    fail(&b, 1, now);
+    assert(blocked(&a, now));
+    assert(blocked(&b, now));
+    assert(!blocked(&other, now));
+
+    // A v4-mapped address counts as the IPv4 one
+    struct sockaddr_in v4 = ipv4("203.0.113.5");
+    struct sockaddr_in6 mapped = ipv6("::ffff:203.0.113.5");
+    fail(&v4, AUTH_THROTTLE_FREE_FAILURES, now);
+    fail(&mapped, 1, now);
+    assert(blocked(&v4, now));
+    assert(blocked(&mapped, now));
+    printf("Auth throttle IPv6 /64 test passed!\n");
+}
+
+int main(void) {
+    test_backoff();
+    test_decay();
+    test_ipv6_prefix();
+    printf("All auth throttle tests passed.\n");
+    return 0;
+}
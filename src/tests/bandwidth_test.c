@@ -0,0 +1,93 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "utils/bandwidth.h"
+
+static void test_allowance(void) {
+    printf("Running bandwidth allowance test...\n");
+    uint64_t now = 1000;
+    uint64_t wait = 0;
+
+    // 4000 B/s: the burst (1000 bytes) is under the minimum read, so the
+    // bucket holds BANDWIDTH_MIN_READ and starts full
+    bandwidth_bucket_t *bucket = bandwidth_acquire("alice", 4000, 0, now);
+    assert(bucket != NULL);
+    assert(bandwidth_allowance(bucket, BANDWIDTH_UPLOAD, 100000, now, &wait) == BANDWIDTH_MIN_READ);
+    assert(bandwidth_allowance(bucket, BANDWIDTH_UPLOAD, 10, now, &wait) == 10);
+
+    // The direction without a limit always gives what is asked
+    assert(bandwidth_allowance(bucket, BANDWIDTH_DOWNLOAD, 1 << 20, now, &wait) == 1 << 20);
+
+    // Empty: 1024 bytes at 4000 B/s are 256 ms away
+    bandwidth_consume(bucket, BANDWIDTH_UPLOAD, BANDWIDTH_MIN_READ);
+    assert(bandwidth_allowance(bucket, BANDWIDTH_UPLOAD, 100000, now, &wait) == 0);
+    assert(wait == 256);
+
+    // The next one waits for its own turn after the first
+    assert(bandwidth_allowance(bucket, BANDWIDTH_UPLOAD, 100000, now, &wait) == 0);
+    assert(wait == 512);
+    bandwidth_resume(bucket, BANDWIDTH_UPLOAD);
+    bandwidth_resume(bucket, BANDWIDTH_UPLOAD);
+
+    // Refill is exact in thousandths of a byte: 100 ms are 400 bytes, not
+    // enough for a minimum read; the wait counts what is already there
+    now += 100;
+    assert(bandwidth_allowance(bucket, BANDWIDTH_UPLOAD, 100000, now, &wait) == 0);
+    assert(wait == 156);
+    bandwidth_resume(bucket, BANDWIDTH_UPLOAD);
+
+    // A read smaller than the minimum does not have to wait for it
+    assert(bandwidth_allowance(bucket, BANDWIDTH_UPLOAD, 300, now, &wait) == 300);
+
+    // It never fills past the burst
+    now += 60000;
+    assert(bandwidth_allowance(bucket, BANDWIDTH_UPLOAD, 100000, now, &wait) == BANDWIDTH_MIN_READ);
+
+    // Consuming more than there is leaves it empty, not negative
+    bandwidth_consume(bucket, BANDWIDTH_UPLOAD, 5000);
+    now += 1;
+    assert(bandwidth_allowance(bucket, BANDWIDTH_UPLOAD, 100000, now, &wait) == 0);
+    assert(wait == 256 - 1);
+    bandwidth_resume(bucket, BANDWIDTH_UPLOAD);
+
+    bandwidth_release(bucket);
+    printf("Bandwidth allowance test passed!\n");
+}
+
+static void test_shared_bucket(void) {
+    printf("Running bandwidth shared bucket test...\n");
+    uint64_t now = 5000;
+    uint64_t wait = 0;
+
+    // 1 MB/s: the burst is 250 ms of traffic
+    assert(bandwidth_acquire("nobody", 0, 0, now) == NULL);
+    bandwidth_bucket_t *first = bandwidth_acquire("bob", 0, 1000000, now);
+    bandwidth_bucket_t *second = bandwidth_acquire("bob", 0, 1000000, now);
+    assert(first != NULL && first == second);
+    assert(bandwidth_allowance(first, BANDWIDTH_DOWNLOAD, 1 << 20, now, &wait) == 250000);
+
+    // Both connections draw from the same tokens
+    bandwidth_consume(first, BANDWIDTH_DOWNLOAD, 200000);
+    assert(bandwidth_allowance(second, BANDWIDTH_DOWNLOAD, 1 << 20, now, &wait) == 50000);
+
+    // A lower limit keeps the tokens up to the new burst
+    bandwidth_bucket_t *third = bandwidth_acquire("bob", 0, 100000, now);
+    assert(third == first);
+    assert(bandwidth_allowance(third, BANDWIDTH_DOWNLOAD, 1 << 20, now, &wait) == 25000);
+
+    // The bucket lives while some connection holds it; a new one starts full
+    bandwidth_release(first);
+    bandwidth_release(second);
+    bandwidth_release(third);
+    bandwidth_bucket_t *fresh = bandwidth_acquire("bob", 0, 1000000, now);
+    assert(bandwidth_allowance(fresh, BANDWIDTH_DOWNLOAD, 1 << 20, now, &wait) == 250000);
+    bandwidth_release(fresh);
+    printf("Bandwidth shared bucket test passed!\n");
+}
+
+int main(void) {
+    test_allowance();
+    test_shared_bucket();
+    printf("All bandwidth tests passed.\n");
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "utils/conn_quota.h"
+
+static void test_acquire_release(void) {
+    printf("Running connection quota test...\n");
+
+    // Up to the maximum, then rejected without being counted
+    assert(conn_quota_count("alice") == 0);
+    assert(conn_quota_acquire("alice", 2));
+    assert(conn_quota_acquire("alice", 2));
+    assert(!conn_quota_acquire("alice", 2));
+    assert(conn_quota_count("alice") == 2);
+
+    // Closing one makes room for another
+    conn_quota_release("alice");
+    assert(conn_quota_count("alice") == 1);
+    assert(conn_quota_acquire("alice", 2));
+    assert(!conn_quota_acquire("alice", 2));
+
+    // A maximum lowered below the open ones rejects new ones, and they
+    // are let in again once enough close
+    assert(!conn_quota_acquire("alice", 1));
+    conn_quota_release("alice");
+    assert(!conn_quota_acquire("alice", 1));
+    conn_quota_release("alice");
+    assert(conn_quota_count("alice") == 0);
+    assert(conn_quota_acquire("alice", 1));
+    conn_quota_release("alice");
+
+    // Without a maximum every connection is counted, so a maximum set later
+    // sees them
+    for (int i = 0; i < 10; i++) {
+        assert(conn_quota_acquire("bob", 0));
+    }
+    assert(conn_quota_count("bob") == 10);
+    assert(!conn_quota_acquire("bob", 10));
+    assert(conn_quota_acquire("bob", 11));
+    for (int i = 0; i < 11; i++) {
+        conn_quota_release("bob");
+    }
+    assert(conn_quota_count("bob") == 0);
+
+    // Users are counted apart, and releasing an unknown one does nothing
+    assert(conn_quota_acquire("carol", 1));
+    assert(conn_quota_acquire("dave", 1));
+    conn_quota_release("nobody");
+    assert(conn_quota_count("carol") == 1);
+    assert(conn_quota_count("dave") == 1);
+    conn_quota_release("carol");
+    conn_quota_release("dave");
+    printf("Connection quota test passed!\n");
+}
+
+int main(void) {
+    test_acquire_release();
+    printf("All connection quota tests passed.\n");
+    return 0;
+}
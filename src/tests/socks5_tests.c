@@ -120,11 +120,11 @@ static void test_ipv6_support(void) {
     assert(write(sp[1], req, sizeof(req)) == sizeof(req));
 
     struct socks5args args = {0};
-    int dest_port = 0;
-    int remote_fd = socks5_handle_request(sp[0], &args, 42, &dest_port);
+    socks5_session_t session = { .connection_id = 42 };
+    int remote_fd = socks5_handle_request(sp[0], &args, &session);
 
     assert(remote_fd >= 0);
-    assert(dest_port == srv_port);
+    assert(session.dest_port == srv_port);
     close(remote_fd);
     close(sp[0]);
     close(sp[1]);
@@ -159,11 +159,11 @@ static void test_failover_iterates_addresses(void) {
     assert(write(sp[1], req, req_len) == (ssize_t)req_len);
 
     struct socks5args args = {0};
-    int dest_port = 0;
-    int remote_fd = socks5_handle_request(sp[0], &args, 43, &dest_port);
+    socks5_session_t session = { .connection_id = 43 };
+    int remote_fd = socks5_handle_request(sp[0], &args, &session);
 
     assert(remote_fd >= 0);
-    assert(dest_port == srv_port);
+    assert(session.dest_port == srv_port);
     close(remote_fd);
     close(sp[0]);
     close(sp[1]);
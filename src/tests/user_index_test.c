@@ -0,0 +1,130 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/user_index.h"
+
+#define NAME_LEN 16
+
+// Slot where `name' lands in an empty index of capacity 16
+static size_t ideal_slot(const char *name) {
+    user_index_t probe = {0};
+    assert(user_index_put(&probe, name, (void *)name) == 0);
+    assert(probe.capacity == 16);
+    size_t slot = 0;
+    while (probe.entries[slot].key != name) slot++;
+    user_index_free(&probe);
+    return slot;
+}
+
+// Fills `out' with `count' names whose ideal slot is `slot'
+static void names_for_slot(size_t slot, char (*out)[NAME_LEN], int count) {
+    int found = 0;
+    for (int i = 0; found < count; i++) {
+        snprintf(out[found], NAME_LEN, "user%d", i);
+        if (ideal_slot(out[found]) == slot) found++;
+    }
+}
+
+static size_t slot_of(const user_index_t *index, const char *name) {
+    for (size_t i = 0; i < index->capacity; i++) {
+        if (index->entries[i].key != NULL && strcmp(index->entries[i].key, name) == 0) return i;
+    }
+    assert(!"name not in the index");
+    return 0;
+}
+
+static void test_wrap_around_deletion(void) {
+    printf("Running user_index wrap-around deletion test...\n");
+
+    // Three names that want the last slot, and one that wants slot 0: the
+    // cluster runs 15, 0, 1, 2
+    char last[3][NAME_LEN];
+    char first[1][NAME_LEN];
+    names_for_slot(15, last, 3);
+    names_for_slot(0, first, 1);
+
+    user_index_t index = {0};
+    assert(user_index_put(&index, last[0], last[0]) == 0);
+    assert(user_index_put(&index, last[1], last[1]) == 0);
+    assert(user_index_put(&index, last[2], last[2]) == 0);
+    assert(user_index_put(&index, first[0], first[0]) == 0);
+    assert(index.capacity == 16);
+    assert(slot_of(&index, last[0]) == 15);
+    assert(slot_of(&index, last[1]) == 0);
+    assert(slot_of(&index, last[2]) == 1);
+    assert(slot_of(&index, first[0]) == 2);
+
+    // Removing the head of the cluster shifts everything back across the
+    // end of the table, including the entry whose ideal slot is 0
+    assert(user_index_remove(&index, last[0]) == last[0]);
+    assert(index.count == 3);
+    assert(slot_of(&index, last[1]) == 15);
+    assert(slot_of(&index, last[2]) == 0);
+    assert(slot_of(&index, first[0]) == 1);
+    assert(index.entries[2].key == NULL);
+    assert(user_index_get(&index, last[0]) == NULL);
+    assert(user_index_get(&index, last[1]) == last[1]);
+    assert(user_index_get(&index, last[2]) == last[2]);
+    assert(user_index_get(&index, first[0]) == first[0]);
+
+    // Removing from the middle of the wrapped part: the one that wants slot
+    // 0 moves back, the one that wants 15 stays
+    assert(user_index_remove(&index, last[2]) == last[2]);
+    assert(slot_of(&index, last[1]) == 15);
+    assert(slot_of(&index, first[0]) == 0);
+    assert(index.entries[1].key == NULL);
+
+    // An entry in its ideal slot never moves before it
+    assert(user_index_remove(&index, last[1]) == last[1]);
+    assert(slot_of(&index, first[0]) == 0);
+    assert(index.entries[15].key == NULL);
+    assert(user_index_remove(&index, last[1]) == NULL);
+    assert(index.count == 1);
+
+    user_index_free(&index);
+    printf("user_index wrap-around deletion test passed!\n");
+}
+
+static void test_against_reference(void) {
+    printf("Running user_index randomized test...\n");
+
+    // Few names in a small table, so clusters and wrap-around are common
+    enum { NAMES = 12, ROUNDS = 20000 };
+    char names[NAMES][NAME_LEN];
+    bool present[NAMES] = {false};
+    for (int i = 0; i < NAMES; i++) {
+        snprintf(names[i], NAME_LEN, "n%d", i);
+    }
+
+    user_index_t index = {0};
+    srand(1);
+    size_t count = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        int i = rand() % NAMES;
+        if (rand() % 2) {
+            assert(user_index_put(&index, names[i], names[i]) == 0);
+            count += !present[i];
+            present[i] = true;
+        } else {
+            assert(user_index_remove(&index, names[i]) == (present[i] ? names[i] : NULL));
+            count -= present[i];
+            present[i] = false;
+        }
+        assert(index.count == count);
+        for (int j = 0; j < NAMES; j++) {
+            assert(user_index_get(&index, names[j]) == (present[j] ? names[j] : NULL));
+        }
+    }
+    user_index_free(&index);
+    printf("user_index randomized test passed!\n");
+}
+
+int main(void) {
+    test_wrap_around_deletion();
+    test_against_reference();
+    printf("All user_index tests passed.\n");
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "utils/user_index.h"
+#include "utils/user_journal.h"
+
+// Users as the journal leaves them: name -> password
+typedef struct {
+    char name[64];
+    char password[160];
+} entry_t;
+
+typedef struct {
+    user_index_t index;
+    int records;
+} users_t;
+
+static void apply(char op, const char *username, const char *password, void *ctx) {
+    users_t *users = ctx;
+    users->records++;
+    if (op == '-') {
+        free(user_index_remove(&users->index, username));
+        return;
+    }
+    entry_t *entry = user_index_get(&users->index, username);
+    if (entry == NULL) {
+        entry = calloc(1, sizeof(*entry));
+        assert(entry != NULL);
+        snprintf(entry->name, sizeof(entry->name), "%s", username);
+        assert(user_index_put(&users->index, entry->name, entry) == 0);
+    }
+    snprintf(entry->password, sizeof(entry->password), "%s", password);
+}
+
+static const char *password_of(const users_t *users, const char *name) {
+    const entry_t *entry = user_index_get(&users->index, name);
+    return entry != NULL ? entry->password : NULL;
+}
+
+static void users_free(users_t *users) {
+    for (size_t i = 0; i < users->index.capacity; i++) {
+        free(users->index.entries[i].value);
+    }
+    user_index_free(&users->index);
+}
+
+static void write_file(const char *path, const char *data) {
+    FILE *f = fopen(path, "w");
+    assert(f != NULL);
+    fputs(data, f);
+    fclose(f);
+}
+
+static void test_replay(const char *dir) {
+    printf("Running journal replay test...\n");
+    char path[256];
+    snprintf(path, sizeof(path), "%s/auth.db.journal", dir);
+
+    // A delete of a user that never existed, a replaced password, a delete
+    // that applies, and a last line cut in the middle of a write
+    write_file(path,
+               "-ghost\n"
+               "+alice:one\n"
+               "+bob:two:100:200\n"
+               "+alice:three\n"
+               "+carol:four\n"
+               "-carol\n"
+               "garbage\n"
+               "+dave:fi");
+    users_t users = {0};
+    assert(user_journal_replay(path, apply, &users) == 6);
+    assert(users.records == 6);
+    assert(users.index.count == 2);
+    assert(strcmp(password_of(&users, "alice"), "three") == 0);
+    assert(strcmp(password_of(&users, "bob"), "two:100:200") == 0);
+    assert(password_of(&users, "carol") == NULL);
+    assert(password_of(&users, "ghost") == NULL);
+    assert(password_of(&users, "dave") == NULL);
+    users_free(&users);
+
+    // Replaying twice gives the same users (a crash between the snapshot
+    // rename and the journal unlink replays records already in it)
+    users = (users_t){0};
+    assert(user_journal_replay(path, apply, &users) == 6);
+    assert(user_journal_replay(path, apply, &users) == 6);
+    assert(users.index.count == 2);
+    assert(strcmp(password_of(&users, "alice"), "three") == 0);
+    users_free(&users);
+
+    unlink(path);
+    users = (users_t){0};
+    assert(user_journal_replay(path, apply, &users) == 0);
+    assert(users.records == 0);
+    printf("Journal replay test passed!\n");
+}
+
+static void test_overlong_line(const char *dir) {
+    printf("Running journal overlong line test...\n");
+    char path[256];
+    snprintf(path, sizeof(path), "%s/auth.db.journal", dir);
+
+    // A hand-edited line longer than any record is skipped whole, and the
+    // records after it still apply
+    char data[2048];
+    int len = snprintf(data, sizeof(data), "+alice:one\n+long:");
+    memset(data + len, 'x', 1000);
+    len += 1000;
+    snprintf(data + len, sizeof(data) - (size_t)len, "\n+bob:two\n-alice\n");
+    write_file(path, data);
+
+    users_t users = {0};
+    assert(user_journal_replay(path, apply, &users) == 3);
+    assert(users.index.count == 1);
+    assert(strcmp(password_of(&users, "bob"), "two") == 0);
+    assert(password_of(&users, "long") == NULL);
+    assert(password_of(&users, "alice") == NULL);
+    users_free(&users);
+    unlink(path);
+    printf("Journal overlong line test passed!\n");
+}
+
+static void test_append_and_replay(const char *dir) {
+    printf("Running journal append test...\n");
+    char path[256];
+    snprintf(path, sizeof(path), "%s/auth.db.journal", dir);
+
+    user_journal_t journal = { .fd = -1 };
+    assert(user_journal_open(&journal, path) == 0);
+    assert(user_journal_add(&journal, "alice", "$y$hash") == 0);
+    assert(user_journal_add(&journal, "bob", "$y$other:10:20:3") == 0);
+    assert(user_journal_delete(&journal, "alice") == 0);
+    assert(user_journal_delete(&journal, "nobody") == 0);
+    assert(journal.records == 4);
+    user_journal_close(&journal);
+
+    users_t users = {0};
+    assert(user_journal_replay(path, apply, &users) == 4);
+    assert(users.index.count == 1);
+    assert(strcmp(password_of(&users, "bob"), "$y$other:10:20:3") == 0);
+    users_free(&users);
+    unlink(path);
+    printf("Journal append test passed!\n");
+}
+
+int main(void) {
+    char dir[] = "/tmp/user_journal_testXXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    test_replay(dir);
+    test_overlong_line(dir);
+    test_append_and_replay(dir);
+    rmdir(dir);
+    printf("All user_journal tests passed.\n");
+    return 0;
+}
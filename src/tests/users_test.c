@@ -0,0 +1,222 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "shared.h"
+#include "utils/password_hash.h"
+
+// Hashes made once: the KDF takes tens of milliseconds each
+static char hash_alice[MAX_PASSWORD_HASH_LEN];
+static char hash_bob[MAX_PASSWORD_HASH_LEN];
+static char hash_bob_new[MAX_PASSWORD_HASH_LEN];
+static char hash_carol[MAX_PASSWORD_HASH_LEN];
+static char hash_frank[MAX_PASSWORD_HASH_LEN];
+static char hash_erin[MAX_PASSWORD_HASH_LEN];
+static char hash_dave[MAX_PASSWORD_HASH_LEN];
+
+static void make_hash(const char *password, char *hash) {
+    assert(password_hash_make(password, hash, MAX_PASSWORD_HASH_LEN) == 0);
+}
+
+static void write_auth_db(const char *data) {
+    FILE *f = fopen("auth.db", "w");
+    assert(f != NULL);
+    fputs(data, f);
+    fclose(f);
+}
+
+// Sends one management command and handles it on the other end
+static mgmt_simple_response_t run_command(mgmt_command_t cmd, const char *username, const char *password) {
+    int sp[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sp) == 0);
+    assert(mgmt_send_command(sp[0], cmd, username, password) == 0);
+    assert(mgmt_handle_client(sp[1]) == 0);
+    mgmt_simple_response_t response;
+    assert(mgmt_receive_simple_response(sp[0], &response) == 0);
+    close(sp[0]);
+    close(sp[1]);
+    return response;
+}
+
+static user_t *table_user(const char *username) {
+    shared_data_t *shared = mgmt_get_shared_data();
+    for (int i = 0; i < shared->user_count; i++) {
+        if (strcmp(shared->users[i]->username, username) == 0) return shared->users[i];
+    }
+    return NULL;
+}
+
+// Whether `username' is in the published index, without the KDF
+static bool published(const char *username) {
+    uint32_t upload, download;
+    return mgmt_get_user_bandwidth(username, &upload, &download);
+}
+
+static void test_reload_merge(void) {
+    printf("Running users reload merge test...\n");
+    char data[2048];
+    snprintf(data, sizeof(data), "alice:%s\nbob:%s\ncarol:%s\nfrank:%s\n",
+             hash_alice, hash_bob, hash_carol, hash_frank);
+    write_auth_db(data);
+    assert(mgmt_init_shared_memory() == 0);
+    assert(mgmt_add_static_user("static", "s1") == 0);
+    assert(mgmt_add_static_user("dave", "d1") == 0);
+
+    assert(mgmt_check_credentials("alice", "pw1"));
+    assert(mgmt_check_credentials("static", "s1"));
+    assert(mgmt_check_credentials("dave", "d1"));
+    assert(!mgmt_check_credentials("alice", "pw2"));
+
+    mgmt_account_user_traffic("alice", 1000, 1);
+    mgmt_account_user_traffic("bob", 2000, 1);
+    mgmt_account_user_traffic("frank", 3000, 1);
+    user_t *alice = table_user("alice");
+    user_t *frank = table_user("frank");
+    user_t *bob = table_user("bob");
+    assert(alice != NULL && frank != NULL && bob != NULL);
+
+    // alice unchanged, bob with another password, frank with limits, carol
+    // gone, erin new, and dave both on the command line and in the file
+    snprintf(data, sizeof(data), "alice:%s\nbob:%s\nfrank:%s:100:200\nerin:%s\ndave:%s\n",
+             hash_alice, hash_bob_new, hash_frank, hash_erin, hash_dave);
+    write_auth_db(data);
+    mgmt_simple_response_t response = run_command(CMD_RELOAD_CONFIG, NULL, NULL);
+    assert(response.success);
+    assert(strcmp(response.message, "Usuarios recargados: 6 (1 altas, 1 bajas, 3 cambios)") == 0);
+
+    // Unchanged users and limit changes keep their user_t and statistics
+    assert(table_user("alice") == alice);
+    assert(alice->stats.total_bytes_transferred == 1000);
+    assert(alice->stats.current_connections == 1);
+    assert(table_user("frank") == frank);
+    assert(frank->upload_limit == 100 && frank->download_limit == 200);
+    uint32_t upload = 0, download = 0;
+    assert(mgmt_get_user_bandwidth("frank", &upload, &download));
+    assert(upload == 100 && download == 200);
+
+    // A password change is a new user_t that inherits the statistics
+    user_t *new_bob = table_user("bob");
+    assert(new_bob != NULL);
+    assert(new_bob->stats.total_bytes_transferred == 2000);
+    assert(new_bob->stats.current_connections == 1);
+    assert(mgmt_check_credentials("bob", "pw2b"));
+    assert(!mgmt_check_credentials("bob", "pw2"));
+
+    // Deleted and added users
+    assert(table_user("carol") == NULL);
+    assert(!published("carol"));
+    // An unknown user goes through the KDF like any other, so it is never
+    // answered from the cache
+    assert(mgmt_check_credentials_cached("carol", "pw3") == -1);
+    assert(!mgmt_check_credentials("carol", "pw3"));
+    assert(mgmt_check_credentials("erin", "pw5"));
+
+    // Command line users not in the file stay; the file beats the ones in it
+    assert(table_user("static")->active == USER_ACTIVE_STATIC);
+    assert(mgmt_check_credentials("static", "s1"));
+    assert(table_user("dave")->active == USER_ACTIVE);
+    assert(mgmt_check_credentials("dave", "d2"));
+    assert(!mgmt_check_credentials("dave", "d1"));
+
+    // Reloading the same file changes nothing
+    response = run_command(CMD_RELOAD_CONFIG, NULL, NULL);
+    assert(strcmp(response.message, "Usuarios recargados: 6 (0 altas, 0 bajas, 0 cambios)") == 0);
+    assert(table_user("bob") == new_bob);
+    printf("Users reload merge test passed!\n");
+}
+
+typedef struct {
+    volatile bool stop;
+    unsigned long lookups;
+} reader_t;
+
+// Authentication side: reads the published index while management changes it
+static void *reader_main(void *arg) {
+    reader_t *reader = arg;
+    while (!reader->stop) {
+        uint32_t upload, download;
+        assert(mgmt_get_user_bandwidth("frank", &upload, &download));
+        assert(published("alice"));
+        assert(mgmt_has_users());
+        published("churn");
+        reader->lookups++;
+    }
+    return NULL;
+}
+
+static void test_publish_retire(void) {
+    printf("Running users publish/retire test...\n");
+    reader_t reader = {0};
+    pthread_t tid;
+    assert(pthread_create(&tid, NULL, reader_main, &reader) == 0);
+
+    // Every add and delete publishes a new version and retires the old one
+    // and the deleted user_t; the reader never sees a half-made one
+    for (int i = 0; i < 8; i++) {
+        assert(!published("churn"));
+        assert(run_command(CMD_ADD_USER, "churn", "c1").success);
+        assert(published("churn"));
+        assert(mgmt_check_credentials("churn", "c1"));
+        assert(run_command(CMD_DEL_USER, "churn", NULL).success);
+        assert(!published("churn"));
+    }
+
+    // Users added one at a time are all published, whichever version the
+    // publication started from
+    char name[16];
+    for (int i = 0; i < 6; i++) {
+        snprintf(name, sizeof(name), "u%d", i);
+        assert(run_command(CMD_ADD_USER, name, "x").success);
+    }
+    assert(run_command(CMD_DEL_USER, "u2", NULL).success);
+    assert(!run_command(CMD_DEL_USER, "u2", NULL).success);
+    assert(!run_command(CMD_ADD_USER, "u1", "y").success);
+    // Names that would break auth.db and the journal are rejected
+    mgmt_simple_response_t response = run_command(CMD_ADD_USER, "x:1", "z");
+    assert(!response.success);
+    assert(strcmp(response.message, "Error: Nombre de usuario o clave inválidos") == 0);
+    assert(!run_command(CMD_ADD_USER, "x\n", "z").success);
+    assert(!run_command(CMD_ADD_USER, "x", "z\r").success);
+    assert(!published("x:1") && !published("x"));
+    for (int i = 0; i < 6; i++) {
+        snprintf(name, sizeof(name), "u%d", i);
+        assert(published(name) == (i != 2));
+    }
+    assert(published("alice") && published("bob") && published("static"));
+
+    reader.stop = true;
+    pthread_join(tid, NULL);
+    assert(reader.lookups > 0);
+    printf("Users publish/retire test passed!\n");
+}
+
+int main(void) {
+    char dir[] = "/tmp/users_testXXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    assert(chdir(dir) == 0);
+
+    make_hash("pw1", hash_alice);
+    make_hash("pw2", hash_bob);
+    make_hash("pw2b", hash_bob_new);
+    make_hash("pw3", hash_carol);
+    make_hash("pw6", hash_frank);
+    make_hash("pw5", hash_erin);
+    make_hash("d2", hash_dave);
+
+    test_reload_merge();
+    test_publish_retire();
+    mgmt_cleanup_shared_memory();
+
+    const char *files[] = { "auth.db", "auth.db.journal", "auth.db.journal.old", "auth.db.tmp" };
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        unlink(files[i]);
+    }
+    assert(chdir("/") == 0);
+    rmdir(dir);
+    printf("All users tests passed.\n");
+    return 0;
+}
@@ -0,0 +1,255 @@
+#include "access_log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "log_rotate.h"
+#include "logger.h"
+#include "user_index.h"
+
+#define BUFFER_SIZE (64 * 1024)
+#define MAX_RECORD_LEN 600          // encabezado + 6 varints + destino o nombre
+#define MAX_USER_NAME_LEN 255
+
+typedef struct {
+    uint32_t id;
+    char name[];
+} user_id_entry_t;
+
+static struct {
+    int fd;
+    pthread_mutex_t mutex;
+    char path[PATH_MAX];
+    log_rotation_state_t rotation;
+    size_t used;
+    user_index_t user_ids;      // nombre -> user_id_entry_t* de este archivo
+    uint32_t last_user_id;
+    uint8_t buffer[BUFFER_SIZE];
+} A = {
+    .fd = -1,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static uint64_t unix_millis(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000u + (uint64_t)tv.tv_usec / 1000u;
+}
+
+static size_t put_u16(uint8_t *out, uint16_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    return 2;
+}
+
+static size_t put_u64(uint8_t *out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+    return 8;
+}
+
+static size_t put_varint(uint8_t *out, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+static size_t put_string(uint8_t *out, const char *value, size_t max) {
+    if (value == NULL) return 0;
+    size_t len = strnlen(value, max);
+    memcpy(out, value, len);
+    return len;
+}
+
+static void write_all(const uint8_t *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(A.fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            log_error("Access log write failed");
+            return;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+static void flush_locked(void) {
+    if (A.fd >= 0 && A.used > 0) {
+        write_all(A.buffer, A.used);
+        A.rotation.size += A.used;
+    }
+    A.used = 0;
+}
+
+// Reserva lugar para un registro; escribe el lote si no entra
+static uint8_t *reserve_locked(void) {
+    if (BUFFER_SIZE - A.used < MAX_RECORD_LEN) {
+        flush_locked();
+    }
+    return A.buffer + A.used;
+}
+
+static void commit_locked(uint8_t *record, size_t len) {
+    put_u16(record, (uint16_t)len);
+    A.used += len;
+}
+
+static void forget_users_locked(void) {
+    for (size_t i = 0; i < A.user_ids.capacity; i++) {
+        free(A.user_ids.entries[i].value);
+    }
+    user_index_clear(&A.user_ids);
+    A.last_user_id = 0;
+}
+
+// Id del usuario en este archivo. La primera vez que aparece le da el
+// siguiente y emite su definición. 0 si no hay usuario (o memoria).
+static uint32_t user_id_locked(const char *username) {
+    if (username == NULL || username[0] == '\0') return 0;
+    size_t name_len = strnlen(username, MAX_USER_NAME_LEN);
+    char name[MAX_USER_NAME_LEN + 1];
+    memcpy(name, username, name_len);
+    name[name_len] = '\0';
+
+    const user_id_entry_t *known = user_index_get(&A.user_ids, name);
+    if (known != NULL) return known->id;
+
+    user_id_entry_t *entry = malloc(sizeof(*entry) + name_len + 1);
+    if (entry == NULL) return 0;
+    memcpy(entry->name, name, name_len + 1);
+    entry->id = A.last_user_id + 1;
+    if (user_index_put(&A.user_ids, entry->name, entry) < 0) {
+        free(entry);
+        return 0;
+    }
+    A.last_user_id = entry->id;
+
+    uint8_t *record = reserve_locked();
+    size_t len = 2;
+    record[len++] = ACCESS_RECORD_USER;
+    record[len++] = ACCESS_STATUS_OK;
+    len += put_varint(record + len, entry->id);
+    len += put_string(record + len, entry->name, MAX_USER_NAME_LEN);
+    commit_locked(record, len);
+    return entry->id;
+}
+
+// Encabezado por cada apertura: el decodificador acepta varios en el mismo
+// archivo y reinicia su diccionario de usuarios en cada uno
+static void start_file_locked(int fd, uint64_t size) {
+    A.fd = fd;
+    A.used = 0;
+    forget_users_locked();
+    log_rotation_start(&A.rotation, size);
+
+    uint8_t *header = A.buffer;
+    memcpy(header, ACCESS_LOG_MAGIC, 4);
+    put_u16(header + 4, ACCESS_LOG_VERSION);
+    put_u16(header + 6, ACCESS_LOG_HEADER_LEN);
+    put_u64(header + 8, unix_millis());
+    A.used = ACCESS_LOG_HEADER_LEN;
+}
+
+// Se rota después de volcar el lote: cada archivo queda con sus propias
+// definiciones de usuario y empieza con su encabezado
+static void maybe_rotate_locked(void) {
+    if (!log_rotation_due(&A.rotation, 0)) return;
+    if (A.rotation.size == 0) {
+        log_rotation_start(&A.rotation, 0);
+        return;
+    }
+    int fd = -1;
+    if (log_rotate_file(A.path) == 0) {
+        fd = open(A.path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0640);
+    }
+    if (fd < 0) {
+        log_rotation_start(&A.rotation, A.rotation.size);
+        log_error("No se pudo rotar el registro de accesos");
+        return;
+    }
+    close(A.fd);
+    start_file_locked(fd, 0);
+}
+
+int access_log_open(const char *path) {
+    pthread_mutex_lock(&A.mutex);
+    if (A.fd >= 0) {
+        pthread_mutex_unlock(&A.mutex);
+        return 0;
+    }
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0640);
+    if (fd < 0) {
+        pthread_mutex_unlock(&A.mutex);
+        return -1;
+    }
+    struct stat st;
+    strncpy(A.path, path, sizeof(A.path) - 1);
+    start_file_locked(fd, fstat(fd, &st) == 0 ? (uint64_t)st.st_size : 0);
+    pthread_mutex_unlock(&A.mutex);
+    return 0;
+}
+
+bool access_log_active(void) {
+    return __atomic_load_n(&A.fd, __ATOMIC_RELAXED) >= 0;
+}
+
+void access_log_record(const access_event_t *event) {
+    if (event == NULL || !access_log_active()) {
+        return;
+    }
+    uint64_t now = unix_millis();
+
+    pthread_mutex_lock(&A.mutex);
+    if (A.fd < 0) {
+        pthread_mutex_unlock(&A.mutex);
+        return;
+    }
+    uint32_t user_id = user_id_locked(event->username);
+
+    uint8_t *record = reserve_locked();
+    size_t len = 2;
+    record[len++] = (uint8_t)event->type;
+    record[len++] = (uint8_t)event->status;
+    len += put_u64(record + len, now);
+    len += put_varint(record + len, event->connection_id);
+    len += put_varint(record + len, user_id);
+    len += put_varint(record + len, event->bytes_to_remote);
+    len += put_varint(record + len, event->bytes_to_client);
+    len += put_varint(record + len, event->duration_ms);
+    len += put_string(record + len, event->destination, 272);
+    commit_locked(record, len);
+    pthread_mutex_unlock(&A.mutex);
+}
+
+void access_log_flush(void) {
+    if (!access_log_active()) return;
+    pthread_mutex_lock(&A.mutex);
+    flush_locked();
+    maybe_rotate_locked();
+    pthread_mutex_unlock(&A.mutex);
+}
+
+void access_log_close(void) {
+    pthread_mutex_lock(&A.mutex);
+    flush_locked();
+    if (A.fd >= 0) {
+        close(A.fd);
+    }
+    __atomic_store_n(&A.fd, -1, __ATOMIC_RELAXED);
+    forget_users_locked();
+    user_index_free(&A.user_ids);
+    pthread_mutex_unlock(&A.mutex);
+}
@@ -0,0 +1,80 @@
+#ifndef ACCESS_LOG_H_Pz5kW2nHc8RyTm3XqVd7LbJf
+#define ACCESS_LOG_H_Pz5kW2nHc8RyTm3XqVd7LbJf
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * access_log.c - registro de accesos binario, append-only.
+ *
+ * Reemplaza las líneas de texto "[ACCESS]" por registros compactos con
+ * prefijo de longitud. Los registros se arman en un buffer en memoria y se
+ * escriben en lotes (cuando el buffer se llena o con access_log_flush, que el
+ * loop llama una vez por segundo). `tools/access_log_decode' los convierte a
+ * texto o CSV.
+ *
+ * Formato (enteros little-endian):
+ *
+ *   encabezado:  "S5AL" | u16 versión | u16 largo del encabezado | u64 creado (unix ms)
+ *   registro:    u16 largo total | u8 tipo | u8 estado | cuerpo
+ *
+ *   ACCESS_RECORD_USER:  varint user_id | nombre (resto del registro)
+ *   eventos:             u64 timestamp (unix ms) | varint connection_id |
+ *                        varint user_id | varint bytes cliente->destino |
+ *                        varint bytes destino->cliente | varint duración ms |
+ *                        destino "host:puerto" (resto del registro)
+ *
+ * El user_id es un número por archivo: cada encabezado empieza de nuevo y
+ * los usuarios se numeran desde 1 en el orden en que aparecen (0 = sin
+ * usuario). La primera vez que aparece un usuario se escribe antes un
+ * registro ACCESS_RECORD_USER con su nombre y su id, así el decodificador
+ * puede resolverlo. Dos nombres nunca comparten id. La versión 1 usaba un
+ * hash de 32 bits del nombre, y dos nombres que chocaban quedaban mezclados.
+ */
+
+#define ACCESS_LOG_MAGIC "S5AL"
+#define ACCESS_LOG_VERSION 2
+#define ACCESS_LOG_HEADER_LEN 16
+#define ACCESS_LOG_DEFAULT_FILE "access.bin"
+
+typedef enum {
+    ACCESS_RECORD_USER = 0,
+    ACCESS_RECORD_AUTH = 1,
+    ACCESS_RECORD_CONNECT = 2,
+    ACCESS_RECORD_CLOSE = 3,
+} access_record_type_t;
+
+typedef enum {
+    ACCESS_STATUS_OK = 0,
+    ACCESS_STATUS_FAIL = 1,     // rechazo esperable: credenciales, destino inalcanzable
+    ACCESS_STATUS_ERROR = 2,    // error de protocolo o de E/S
+} access_status_t;
+
+typedef struct {
+    access_record_type_t type;
+    access_status_t status;
+    uint64_t connection_id;
+    const char *username;       // NULL o "" si no hay
+    const char *destination;    // NULL o "" si no hay
+    uint64_t bytes_to_remote;
+    uint64_t bytes_to_client;
+    uint64_t duration_ms;
+} access_event_t;
+
+/** Abre (o crea) el archivo. Retorna 0 si pudo, -1 si no. */
+int access_log_open(const char *path);
+
+/** Indica si hay un archivo abierto */
+bool access_log_active(void);
+
+/** Agrega un evento al buffer. No hace nada si el registro no está abierto. */
+void access_log_record(const access_event_t *event);
+
+/** Escribe lo acumulado en el buffer y rota el archivo si corresponde */
+void access_log_flush(void);
+
+/** Escribe lo pendiente y cierra el archivo */
+void access_log_close(void);
+
+#endif
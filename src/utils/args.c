@@ -6,8 +6,25 @@
 #include <getopt.h>
 
 #include "args.h"
+#include "log_rotate.h"
+#include "loop_watchdog.h"
+#include "slow_handshake.h"
+#include "auth_pool.h"
 #include "../shared.h"
 
+enum {
+    OPT_LOG_MAX_SIZE = 0x100,
+    OPT_LOG_ROTATE_INTERVAL,
+    OPT_LOG_KEEP,
+    OPT_LOG_SUMMARY,
+    OPT_LOG_SAMPLE,
+    OPT_STALL_MS,
+    OPT_SLOW_HANDSHAKE_MS,
+    OPT_CONFIG,
+    OPT_WATCH,
+    OPT_AUTH_WORKERS,
+};
+
 static unsigned short
 port(const char* s)
 {
@@ -25,6 +42,35 @@ port(const char* s)
     return (unsigned short)sl;
 }
 
+static unsigned long long
+number(const char* s, const char* what, bool allow_suffix)
+{
+    char* end = 0;
+    errno = 0;
+    unsigned long long value = strtoull(s, &end, 10);
+    if (end == s || errno == ERANGE || s[0] == '-')
+    {
+        fprintf(stderr, "invalid %s: %s\n", what, s);
+        exit(1);
+    }
+    if (allow_suffix && *end != '\0' && end[1] == '\0')
+    {
+        switch (*end)
+        {
+        case 'k': case 'K': value <<= 10; end++; break;
+        case 'm': case 'M': value <<= 20; end++; break;
+        case 'g': case 'G': value <<= 30; end++; break;
+        default: break;
+        }
+    }
+    if (*end != '\0')
+    {
+        fprintf(stderr, "invalid %s: %s\n", what, s);
+        exit(1);
+    }
+    return value;
+}
+
 static void
 user(char* s, struct users* user)
 {
@@ -62,11 +108,28 @@ usage(const char* progname)
             "   -L <conf  addr>  Dirección donde servirá el servicio de management.\n"
             "   -p <SOCKS port>  Puerto entrante conexiones SOCKS.\n"
             "   -P <conf port>   Puerto entrante conexiones configuracion\n"
-            "   -u <name>:<pass> Usuario y contraseña de usuario que puede usar el proxy. Hasta 10.\n"
+            "   -u <name>:<pass> Usuario y contraseña de usuario que puede usar el proxy. Puede repetirse.\n"
             "   -v               Imprime información sobre la versión versión y termina.\n"
+            "\n"
+            "   --log-max-size <bytes>       Rota los logs al superar este tamaño (admite K, M, G).\n"
+            "   --log-rotate-interval <seg>  Rota los logs cada tantos segundos.\n"
+            "   --log-keep <n>               Archivos rotados a conservar (default %d).\n"
+            "   --log-summary                Una línea resumen por conexión al cerrarse.\n"
+            "   --log-sample <n>             Con --log-summary, 1 de cada n conexiones se\n"
+            "                                sigue registrando etapa por etapa.\n"
+            "   --stall-ms <ms>              Avisa si el loop queda bloqueado más de ms\n"
+            "                                (default %d, 0 lo apaga).\n"
+            "   --slow-handshake-ms <ms>     Registra los handshakes que tarden más de ms,\n"
+            "                                con el tiempo de cada etapa (default %d, 0 lo apaga).\n"
+            "   --config <archivo>           Configuración (clave = valor) que se aplica al\n"
+            "                                arrancar y en cada recarga.\n"
+            "   --watch                      Recarga auth.db y --config cuando cambian (inotify).\n"
+            "   --auth-workers <n>           Hilos que verifican claves fuera del loop (default\n"
+            "                                uno por CPU, hasta %d; 0 verifica en el loop).\n"
 
             "\n",
-            progname);
+            progname, LOG_ROTATE_DEFAULT_KEEP, LOOP_WATCHDOG_DEFAULT_MS, SLOW_HANDSHAKE_DEFAULT_MS,
+            AUTH_POOL_DEFAULT_WORKERS);
     exit(1);
 }
 
@@ -82,14 +145,27 @@ parse_args(const int argc, char** argv, struct socks5args* args)
     args->mng_port = MGMT_PORT;
 
     args->disectors_enabled = true;
+    args->log_keep = LOG_ROTATE_DEFAULT_KEEP;
+    args->stall_ms = LOOP_WATCHDOG_DEFAULT_MS;
+    args->slow_handshake_ms = SLOW_HANDSHAKE_DEFAULT_MS;
+    args->auth_workers = -1;
 
     int c;
-    int nusers = 0;
 
     while (true)
     {
         int option_index = 0;
         static struct option long_options[] = {
+            {"log-max-size", required_argument, 0, OPT_LOG_MAX_SIZE},
+            {"log-rotate-interval", required_argument, 0, OPT_LOG_ROTATE_INTERVAL},
+            {"log-keep", required_argument, 0, OPT_LOG_KEEP},
+            {"log-summary", no_argument, 0, OPT_LOG_SUMMARY},
+            {"log-sample", required_argument, 0, OPT_LOG_SAMPLE},
+            {"stall-ms", required_argument, 0, OPT_STALL_MS},
+            {"slow-handshake-ms", required_argument, 0, OPT_SLOW_HANDSHAKE_MS},
+            {"config", required_argument, 0, OPT_CONFIG},
+            {"watch", no_argument, 0, OPT_WATCH},
+            {"auth-workers", required_argument, 0, OPT_AUTH_WORKERS},
             {0, 0, 0, 0}
         };
 
@@ -118,20 +194,64 @@ parse_args(const int argc, char** argv, struct socks5args* args)
             args->mng_port = port(optarg);
             break;
         case 'u':
-            if (nusers >= MAX_USERS)
+        {
+            struct users* users = realloc(args->users, sizeof(*users) * (args->user_count + 1));
+            if (users == NULL)
             {
-                fprintf(stderr, "maximun number of command line users reached: %d.\n", MAX_USERS);
+                fprintf(stderr, "out of memory for command line users.\n");
                 exit(1);
             }
-            else
-            {
-                user(optarg, args->users + nusers);
-                nusers++;
-            }
+            args->users = users;
+            user(optarg, args->users + args->user_count);
+            args->user_count++;
             break;
+        }
         case 'v':
             version();
             exit(0);
+        case OPT_LOG_MAX_SIZE:
+            args->log_max_bytes = number(optarg, "log size", true);
+            break;
+        case OPT_LOG_ROTATE_INTERVAL:
+            args->log_rotate_interval = (unsigned)number(optarg, "rotation interval", false);
+            break;
+        case OPT_LOG_KEEP:
+            args->log_keep = (unsigned)number(optarg, "log count", false);
+            if (args->log_keep == 0)
+            {
+                fprintf(stderr, "--log-keep should be at least 1\n");
+                exit(1);
+            }
+            break;
+        case OPT_LOG_SUMMARY:
+            args->log_summary = true;
+            break;
+        case OPT_LOG_SAMPLE:
+            args->log_sample = (unsigned)number(optarg, "sample rate", false);
+            break;
+        case OPT_STALL_MS:
+            args->stall_ms = (unsigned)number(optarg, "stall threshold", false);
+            break;
+        case OPT_SLOW_HANDSHAKE_MS:
+            args->slow_handshake_ms = (unsigned)number(optarg, "slow handshake threshold", false);
+            break;
+        case OPT_CONFIG:
+            args->config_file = optarg;
+            break;
+        case OPT_WATCH:
+            args->watch_files = true;
+            break;
+        case OPT_AUTH_WORKERS:
+        {
+            unsigned long long workers = number(optarg, "auth worker count", false);
+            if (workers > AUTH_POOL_MAX_WORKERS)
+            {
+                fprintf(stderr, "--auth-workers should be at most %d\n", AUTH_POOL_MAX_WORKERS);
+                exit(1);
+            }
+            args->auth_workers = (int)workers;
+            break;
+        }
         default:
             fprintf(stderr, "unknown argument %d.\n", c);
             exit(1);
@@ -3,7 +3,6 @@
 
 #include <stdbool.h>
 
-#define MAX_USERS 10
 #define DEFAULT_SOCKS_PORT 1080
 
 struct users
@@ -22,7 +21,24 @@ struct socks5args
 
     bool disectors_enabled;
 
-    struct users users[MAX_USERS];
+    // Rotación de logs (ver utils/log_rotate.h); 0 = deshabilitada
+    unsigned long long log_max_bytes;
+    unsigned log_rotate_interval;
+    unsigned log_keep;
+
+    // Un registro resumen por conexión en lugar de una línea por etapa
+    bool log_summary;
+    unsigned log_sample;    // 1 de cada N conexiones conserva el detalle
+
+    unsigned stall_ms;      // umbral del watchdog del loop, 0 = apagado
+    unsigned slow_handshake_ms; // handshakes más lentos se registran, 0 = apagado
+
+    const char* config_file;    // --config, NULL si no hay
+    bool watch_files;           // --watch: recargar al cambiar auth.db o --config
+    int auth_workers;           // --auth-workers, -1 = uno por CPU, 0 = en el loop
+
+    struct users* users;    // los -u, en el orden en que llegaron
+    unsigned user_count;
 
     int auth_method;
     const char *username;
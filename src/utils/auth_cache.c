@@ -0,0 +1,77 @@
+#include "auth_cache.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#include "siphash.h"
+#include "util.h"
+
+typedef struct {
+    auth_digest_t digest;
+    uint64_t expires_ms;    // 0 = libre
+} auth_cache_entry_t;
+
+static auth_cache_entry_t entries[AUTH_CACHE_SETS][AUTH_CACHE_WAYS];
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Dos claves independientes dan las dos mitades del digest
+static siphash_key_t key_lo, key_hi;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+
+static void init_keys(void) {
+    siphash_random_key(&key_lo);
+    siphash_random_key(&key_hi);
+}
+
+void auth_cache_digest(const char *username, const char *password, const char *hash, auth_digest_t *digest) {
+    pthread_once(&key_once, init_keys);
+
+    // usuario \0 clave \0 hash; los \0 separan, así "ab"+"c" no es "a"+"bc"
+    char input[64 + 256 + 128 + 3];
+    size_t len = 0;
+    const char *parts[] = { username, password, hash };
+    for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+        size_t part_len = strnlen(parts[i], sizeof(input) - len - 1);
+        memcpy(input + len, parts[i], part_len);
+        len += part_len;
+        input[len++] = '\0';
+    }
+    digest->lo = siphash24(&key_lo, input, len);
+    digest->hi = siphash24(&key_hi, input, len);
+    explicit_bzero(input, sizeof(input));
+}
+
+bool auth_cache_lookup(const auth_digest_t *digest) {
+    const auth_cache_entry_t *set = entries[digest->lo & (AUTH_CACHE_SETS - 1)];
+    uint64_t now = monotonicMillis();
+    bool hit = false;
+    pthread_mutex_lock(&cache_mutex);
+    for (int way = 0; way < AUTH_CACHE_WAYS && !hit; way++) {
+        hit = set[way].expires_ms > now &&
+              set[way].digest.lo == digest->lo && set[way].digest.hi == digest->hi;
+    }
+    pthread_mutex_unlock(&cache_mutex);
+    return hit;
+}
+
+void auth_cache_insert(const auth_digest_t *digest) {
+    auth_cache_entry_t *set = entries[digest->lo & (AUTH_CACHE_SETS - 1)];
+    uint64_t now = monotonicMillis();
+    pthread_mutex_lock(&cache_mutex);
+    // El mismo digest si ya estaba (vencido); si no, la que vence primero
+    // (las libres y vencidas primero que nadie)
+    auth_cache_entry_t *victim = &set[0];
+    for (int way = 0; way < AUTH_CACHE_WAYS; way++) {
+        auth_cache_entry_t *entry = &set[way];
+        if (entry->digest.lo == digest->lo && entry->digest.hi == digest->hi) {
+            victim = entry;
+            break;
+        }
+        if (entry->expires_ms < victim->expires_ms) {
+            victim = entry;
+        }
+    }
+    victim->digest = *digest;
+    victim->expires_ms = now + AUTH_CACHE_TTL_MS;
+    pthread_mutex_unlock(&cache_mutex);
+}
@@ -0,0 +1,39 @@
+#ifndef AUTH_CACHE_H_Kc4tXw9NqR2mLz7VbHs5PdGy
+#define AUTH_CACHE_H_Kc4tXw9NqR2mLz7VbHs5PdGy
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * auth_cache.c - credenciales verificadas hace poco, para no repetir el KDF.
+ *
+ * Guarda un digest de 128 bits de (usuario, clave, hash guardado), hecho
+ * con SipHash y una clave aleatoria del proceso; la clave en sí nunca se
+ * guarda. El hash guardado lleva la sal, así que un cambio de clave o una
+ * baja y alta del usuario hacen que el digest viejo ya no coincida: no hace
+ * falta invalidar nada. Una entrada vale AUTH_CACHE_TTL_MS desde que se
+ * verificó (usarla no la renueva) y los intentos fallidos no se guardan.
+ *
+ * Tabla asociativa por conjuntos de tamaño fijo: cuando un conjunto se
+ * llena se pisa la entrada que vence primero. Un mutex la protege; se toma
+ * solo para comparar o copiar unas pocas entradas.
+ */
+
+#define AUTH_CACHE_SETS 1024    // potencia de 2
+#define AUTH_CACHE_WAYS 4
+#define AUTH_CACHE_TTL_MS (5 * 60 * 1000)
+
+typedef struct {
+    uint64_t lo;
+    uint64_t hi;
+} auth_digest_t;
+
+void auth_cache_digest(const char *username, const char *password, const char *hash, auth_digest_t *digest);
+
+/** true si `digest' se verificó hace menos de AUTH_CACHE_TTL_MS */
+bool auth_cache_lookup(const auth_digest_t *digest);
+
+/** Recuerda un digest recién verificado */
+void auth_cache_insert(const auth_digest_t *digest);
+
+#endif
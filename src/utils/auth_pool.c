@@ -0,0 +1,181 @@
+#include "auth_pool.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+typedef struct {
+    size_t slot;
+    uint64_t connection_id;
+    char username[AUTH_POOL_CREDENTIAL_LEN];
+    char password[AUTH_POOL_CREDENTIAL_LEN];
+} auth_job_t;
+
+// Colas circulares; cada una con su mutex
+static auth_job_t *jobs = NULL;
+static size_t job_head = 0, job_count = 0;
+static pthread_mutex_t jobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobs_cond = PTHREAD_COND_INITIALIZER;
+
+static auth_pool_result_t *results = NULL;
+static size_t result_head = 0, result_count = 0;
+static pthread_mutex_t results_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Pedidos encolados y todavía no devueltos por auth_pool_drain; solo lo
+// toca el loop, y mientras no pase de AUTH_POOL_QUEUE ninguna cola se llena
+static size_t outstanding = 0;
+
+static pthread_t threads[AUTH_POOL_MAX_WORKERS];
+static unsigned thread_count = 0;
+static int event_fd = -1;
+static bool stopping = false;
+static auth_pool_verify_fn verify_fn;
+
+static void notify_loop(void) {
+    uint64_t one = 1;
+    // Solo falla si el contador llegara al máximo, y el loop lo vacía antes
+    while (write(event_fd, &one, sizeof(one)) < 0 && errno == EINTR) {
+    }
+}
+
+static void *worker_main(void *arg) {
+    (void)arg;
+    // En Linux la prioridad es por hilo: esto no toca al loop
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), AUTH_POOL_WORKER_NICE);
+
+    auth_job_t job;
+    while (true) {
+        pthread_mutex_lock(&jobs_mutex);
+        while (job_count == 0 && !stopping) {
+            pthread_cond_wait(&jobs_cond, &jobs_mutex);
+        }
+        if (stopping) {
+            pthread_mutex_unlock(&jobs_mutex);
+            break;
+        }
+        job = jobs[job_head];
+        explicit_bzero(jobs[job_head].password, sizeof(jobs[job_head].password));
+        job_head = (job_head + 1) % AUTH_POOL_QUEUE;
+        job_count--;
+        pthread_mutex_unlock(&jobs_mutex);
+
+        bool valid = verify_fn(job.username, job.password);
+        explicit_bzero(job.password, sizeof(job.password));
+
+        pthread_mutex_lock(&results_mutex);
+        auth_pool_result_t *result = &results[(result_head + result_count) % AUTH_POOL_QUEUE];
+        result->slot = job.slot;
+        result->connection_id = job.connection_id;
+        result->valid = valid;
+        memcpy(result->username, job.username, sizeof(result->username));
+        result_count++;
+        pthread_mutex_unlock(&results_mutex);
+        notify_loop();
+    }
+    return NULL;
+}
+
+int auth_pool_start(unsigned workers, auth_pool_verify_fn verify) {
+    if (thread_count > 0 || workers == 0) return -1;
+    if (workers > AUTH_POOL_MAX_WORKERS) {
+        workers = AUTH_POOL_MAX_WORKERS;
+    }
+    jobs = calloc(AUTH_POOL_QUEUE, sizeof(*jobs));
+    results = calloc(AUTH_POOL_QUEUE, sizeof(*results));
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (jobs == NULL || results == NULL || event_fd < 0) {
+        auth_pool_stop();
+        return -1;
+    }
+    verify_fn = verify;
+    stopping = false;
+
+    // Las señales las atiende el loop: los workers nacen con todas bloqueadas
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    for (unsigned i = 0; i < workers; i++) {
+        if (pthread_create(&threads[thread_count], NULL, worker_main, NULL) != 0) break;
+        thread_count++;
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    if (thread_count == 0) {
+        auth_pool_stop();
+        return -1;
+    }
+    return event_fd;
+}
+
+void auth_pool_stop(void) {
+    pthread_mutex_lock(&jobs_mutex);
+    stopping = true;
+    pthread_cond_broadcast(&jobs_cond);
+    pthread_mutex_unlock(&jobs_mutex);
+    for (unsigned i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    thread_count = 0;
+
+    if (event_fd >= 0) {
+        close(event_fd);
+        event_fd = -1;
+    }
+    if (jobs != NULL) {
+        explicit_bzero(jobs, AUTH_POOL_QUEUE * sizeof(*jobs));
+        free(jobs);
+        jobs = NULL;
+    }
+    free(results);
+    results = NULL;
+    job_head = job_count = 0;
+    result_head = result_count = 0;
+    outstanding = 0;
+}
+
+int auth_pool_submit(size_t slot, uint64_t connection_id, const char *username, const char *password) {
+    if (thread_count == 0 || outstanding >= AUTH_POOL_QUEUE) return -1;
+    pthread_mutex_lock(&jobs_mutex);
+    auth_job_t *job = &jobs[(job_head + job_count) % AUTH_POOL_QUEUE];
+    job->slot = slot;
+    job->connection_id = connection_id;
+    strncpy(job->username, username, sizeof(job->username) - 1);
+    job->username[sizeof(job->username) - 1] = '\0';
+    strncpy(job->password, password, sizeof(job->password) - 1);
+    job->password[sizeof(job->password) - 1] = '\0';
+    job_count++;
+    pthread_cond_signal(&jobs_cond);
+    pthread_mutex_unlock(&jobs_mutex);
+    outstanding++;
+    return 0;
+}
+
+size_t auth_pool_drain(auth_pool_result_t *out, size_t max) {
+    if (event_fd < 0) return 0;
+    uint64_t ignored;
+    while (read(event_fd, &ignored, sizeof(ignored)) < 0 && errno == EINTR) {
+    }
+
+    pthread_mutex_lock(&results_mutex);
+    size_t count = result_count < max ? result_count : max;
+    for (size_t i = 0; i < count; i++) {
+        out[i] = results[result_head];
+        result_head = (result_head + 1) % AUTH_POOL_QUEUE;
+    }
+    result_count -= count;
+    bool more = result_count > 0;
+    pthread_mutex_unlock(&results_mutex);
+
+    outstanding -= count;
+    if (more) {
+        // Lo que no entró se devuelve en la próxima vuelta del loop
+        notify_loop();
+    }
+    return count;
+}
@@ -0,0 +1,52 @@
+#ifndef AUTH_POOL_H_Jt7mWq3KxP9vRn2LzBd6HsFc
+#define AUTH_POOL_H_Jt7mWq3KxP9vRn2LzBd6HsFc
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * auth_pool.c - hilos que verifican credenciales fuera del loop.
+ *
+ * Verificar una clave puede costar decenas de milisegundos de CPU (el KDF
+ * de password_hash.c); hecho en el loop, frena el relay de todas las
+ * conexiones. El loop encola un pedido con auth_pool_submit() y sigue; un
+ * worker llama a `verify' y deja el resultado en la cola de respuestas, y
+ * avisa escribiendo en un eventfd que el loop vigila junto con los sockets.
+ * Cuando el eventfd está listo, auth_pool_drain() devuelve los resultados.
+ *
+ * Las colas tienen AUTH_POOL_QUEUE lugares, uno por conexión posible, así
+ * que con a lo sumo un pedido por conexión nunca se llenan. Los workers
+ * corren con menos prioridad (nice) que el loop: si compiten por CPU, el
+ * relay sigue primero.
+ */
+
+#define AUTH_POOL_QUEUE 1024        // CONN_TABLE_SIZE
+#define AUTH_POOL_MAX_WORKERS 16
+#define AUTH_POOL_DEFAULT_WORKERS 4     // sin --auth-workers: uno por CPU, hasta este
+#define AUTH_POOL_CREDENTIAL_LEN 256
+#define AUTH_POOL_WORKER_NICE 5
+
+typedef bool (*auth_pool_verify_fn)(const char *username, const char *password);
+
+typedef struct {
+    size_t slot;                // de la conexión en la tabla del loop
+    uint64_t connection_id;     // para descartar el resultado si el slot se reusó
+    bool valid;
+    char username[AUTH_POOL_CREDENTIAL_LEN];
+} auth_pool_result_t;
+
+/**
+ * Arranca `workers' hilos. Devuelve el eventfd a vigilar por lectura, o -1
+ * si no pudo (entonces hay que verificar en línea).
+ */
+int auth_pool_start(unsigned workers, auth_pool_verify_fn verify);
+void auth_pool_stop(void);
+
+/** Encola una verificación. 0 si quedó encolada, -1 si no hay pool o lugar */
+int auth_pool_submit(size_t slot, uint64_t connection_id, const char *username, const char *password);
+
+/** Vacía el eventfd y copia hasta `max' resultados; devuelve cuántos */
+size_t auth_pool_drain(auth_pool_result_t *results, size_t max);
+
+#endif
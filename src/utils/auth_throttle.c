@@ -0,0 +1,169 @@
+#include "auth_throttle.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+
+#include "logger.h"
+#include "siphash.h"
+
+#define FAMILY_IPV4 4
+#define FAMILY_IPV6 6
+
+typedef struct {
+    uint64_t prefix;            // IPv4 entera o los primeros 64 bits de la IPv6
+    uint8_t family;             // FAMILY_*; 0 = libre
+    uint32_t failures;          // ya con el decaimiento hasta `updated_ms'
+    uint64_t updated_ms;
+    uint64_t blocked_until_ms;
+} throttle_entry_t;
+
+static throttle_entry_t entries[AUTH_THROTTLE_SETS][AUTH_THROTTLE_WAYS];
+static siphash_key_t set_key;
+static bool key_ready = false;
+
+// El bloqueo que termina más tarde: si ya pasó, nadie está bloqueado y
+// aceptar no necesita buscar nada
+static uint64_t latest_block_ms = 0;
+
+static uint64_t rejected = 0;
+static uint64_t last_report_ms = 0;
+
+static bool address_key(const struct sockaddr *addr, uint8_t *family, uint64_t *prefix) {
+    if (addr->sa_family == AF_INET) {
+        *family = FAMILY_IPV4;
+        *prefix = ntohl(((const struct sockaddr_in *)addr)->sin_addr.s_addr);
+        return true;
+    }
+    if (addr->sa_family == AF_INET6) {
+        const struct in6_addr *in6 = &((const struct sockaddr_in6 *)addr)->sin6_addr;
+        uint64_t value = 0;
+        if (IN6_IS_ADDR_V4MAPPED(in6)) {
+            *family = FAMILY_IPV4;
+            for (int i = 12; i < 16; i++) value = (value << 8) | in6->s6_addr[i];
+        } else {
+            *family = FAMILY_IPV6;
+            for (int i = 0; i < 8; i++) value = (value << 8) | in6->s6_addr[i];
+        }
+        *prefix = value;
+        return true;
+    }
+    return false;
+}
+
+static throttle_entry_t *set_of(uint8_t family, uint64_t prefix) {
+    if (!key_ready) {
+        siphash_random_key(&set_key);
+        key_ready = true;
+    }
+    uint8_t input[9];
+    memcpy(input, &prefix, sizeof(prefix));
+    input[8] = family;
+    return entries[siphash24(&set_key, input, sizeof(input)) & (AUTH_THROTTLE_SETS - 1)];
+}
+
+static throttle_entry_t *find(throttle_entry_t *set, uint8_t family, uint64_t prefix) {
+    for (int way = 0; way < AUTH_THROTTLE_WAYS; way++) {
+        if (set[way].family == family && set[way].prefix == prefix) {
+            return &set[way];
+        }
+    }
+    return NULL;
+}
+
+// Media vida por media vida, en enteros
+static void decay(throttle_entry_t *entry, uint64_t now_ms) {
+    if (now_ms <= entry->updated_ms) return;
+    uint64_t halvings = (now_ms - entry->updated_ms) / AUTH_THROTTLE_HALF_LIFE_MS;
+    if (halvings == 0) return;
+    entry->failures = halvings >= 32 ? 0 : entry->failures >> halvings;
+    entry->updated_ms += halvings * AUTH_THROTTLE_HALF_LIFE_MS;
+}
+
+// Lugar para un origen nuevo: uno libre, si no el no bloqueado con menos
+// fallas, y si están todos bloqueados el que se desbloquea primero
+static throttle_entry_t *victim_in(throttle_entry_t *set, uint64_t now_ms) {
+    throttle_entry_t *victim = NULL;
+    for (int way = 0; way < AUTH_THROTTLE_WAYS; way++) {
+        throttle_entry_t *entry = &set[way];
+        if (entry->family == 0) return entry;
+        decay(entry, now_ms);
+        bool blocked = entry->blocked_until_ms > now_ms;
+        if (victim == NULL) {
+            victim = entry;
+            continue;
+        }
+        bool victim_blocked = victim->blocked_until_ms > now_ms;
+        if (blocked != victim_blocked) {
+            if (!blocked) victim = entry;
+        } else if (blocked ? entry->blocked_until_ms < victim->blocked_until_ms
+                           : entry->failures < victim->failures) {
+            victim = entry;
+        }
+    }
+    return victim;
+}
+
+bool auth_throttle_blocked(const struct sockaddr *addr, uint64_t now_ms) {
+    if (now_ms >= latest_block_ms) return false;
+    uint8_t family;
+    uint64_t prefix;
+    if (!address_key(addr, &family, &prefix)) return false;
+    const throttle_entry_t *entry = find(set_of(family, prefix), family, prefix);
+    if (entry == NULL || entry->blocked_until_ms <= now_ms) return false;
+    rejected++;
+    return true;
+}
+
+void auth_throttle_failure(const struct sockaddr *addr, uint64_t now_ms) {
+    uint8_t family;
+    uint64_t prefix;
+    if (!address_key(addr, &family, &prefix)) return;
+    throttle_entry_t *set = set_of(family, prefix);
+    throttle_entry_t *entry = find(set, family, prefix);
+    if (entry == NULL) {
+        entry = victim_in(set, now_ms);
+        entry->family = family;
+        entry->prefix = prefix;
+        entry->failures = 0;
+        entry->updated_ms = now_ms;
+        entry->blocked_until_ms = 0;
+    } else {
+        decay(entry, now_ms);
+    }
+
+    entry->failures++;
+    if (entry->failures <= AUTH_THROTTLE_FREE_FAILURES) return;
+    uint32_t excess = entry->failures - AUTH_THROTTLE_FREE_FAILURES - 1;
+    uint64_t block_ms = excess >= 16 ? AUTH_THROTTLE_MAX_MS : (uint64_t)AUTH_THROTTLE_BASE_MS << excess;
+    if (block_ms > AUTH_THROTTLE_MAX_MS) {
+        block_ms = AUTH_THROTTLE_MAX_MS;
+    }
+    entry->blocked_until_ms = now_ms + block_ms;
+    if (entry->blocked_until_ms > latest_block_ms) {
+        latest_block_ms = entry->blocked_until_ms;
+    }
+
+    char text[INET6_ADDRSTRLEN];
+    if (family == FAMILY_IPV4) {
+        struct in_addr in = { .s_addr = htonl((uint32_t)prefix) };
+        inet_ntop(AF_INET, &in, text, sizeof(text));
+    } else {
+        struct in6_addr in6;
+        memset(&in6, 0, sizeof(in6));
+        for (int i = 0; i < 8; i++) in6.s6_addr[i] = (uint8_t)(prefix >> (56 - 8 * i));
+        inet_ntop(AF_INET6, &in6, text, sizeof(text));
+    }
+    log_warn_limited("Auth throttled for %s%s after %u failures: connections rejected for %llu ms",
+                     text, family == FAMILY_IPV6 ? "/64" : "", entry->failures, (unsigned long long)block_ms);
+}
+
+void auth_throttle_tick(uint64_t now_ms) {
+    if (now_ms - last_report_ms < AUTH_THROTTLE_REPORT_MS) return;
+    if (rejected > 0) {
+        log_warn("Auth throttling rejected %llu connections in the last %llu s",
+                 (unsigned long long)rejected, (unsigned long long)((now_ms - last_report_ms) / 1000));
+        rejected = 0;
+    }
+    last_report_ms = now_ms;
+}
@@ -0,0 +1,46 @@
+#ifndef AUTH_THROTTLE_H_Wd5pLx8RmK2vQz6NtHc3BjYs
+#define AUTH_THROTTLE_H_Wd5pLx8RmK2vQz6NtHc3BjYs
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+/**
+ * auth_throttle.c - freno a la fuerza bruta por dirección de origen.
+ *
+ * Cuenta las autenticaciones fallidas por origen: la IPv4 entera (también
+ * la mapeada en IPv6) o el /64 de una IPv6, porque a un cliente IPv6 le
+ * sobran direcciones dentro de su /64. La cuenta se reduce a la mitad cada
+ * AUTH_THROTTLE_HALF_LIFE_MS. Pasadas AUTH_THROTTLE_FREE_FAILURES, cada
+ * falla bloquea el origen por un tiempo que se duplica (desde
+ * AUTH_THROTTLE_BASE_MS hasta AUTH_THROTTLE_MAX_MS), y mientras dure el
+ * bloqueo sus conexiones se cierran apenas se aceptan, sin leer ni loguear
+ * nada.
+ *
+ * La tabla tiene tamaño fijo (AUTH_THROTTLE_SETS x AUTH_THROTTLE_WAYS), así
+ * que un ataque desde muchas direcciones no hace crecer la memoria: cuando
+ * un conjunto se llena se pisa el origen no bloqueado con menos fallas. El
+ * conjunto sale de SipHash con clave aleatoria, así que no se puede elegir
+ * a quién desalojar.
+ *
+ * Solo lo usa el loop de eventos: no tiene locks.
+ */
+
+#define AUTH_THROTTLE_SETS 1024     // potencia de 2
+#define AUTH_THROTTLE_WAYS 4
+#define AUTH_THROTTLE_FREE_FAILURES 5
+#define AUTH_THROTTLE_BASE_MS 1000
+#define AUTH_THROTTLE_MAX_MS (60 * 1000)
+#define AUTH_THROTTLE_HALF_LIFE_MS (10 * 60 * 1000)
+#define AUTH_THROTTLE_REPORT_MS (60 * 1000)
+
+/** true si el origen está bloqueado: la conexión se cierra sin atenderla */
+bool auth_throttle_blocked(const struct sockaddr *addr, uint64_t now_ms);
+
+/** Una autenticación con credenciales inválidas desde `addr' */
+void auth_throttle_failure(const struct sockaddr *addr, uint64_t now_ms);
+
+/** Resume en el log las conexiones rechazadas, a lo sumo cada AUTH_THROTTLE_REPORT_MS */
+void auth_throttle_tick(uint64_t now_ms);
+
+#endif
@@ -0,0 +1,105 @@
+#include "bandwidth.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "user_index.h"
+
+#define BANDWIDTH_USERNAME_LEN 64   // MAX_USERNAME_LEN
+
+typedef struct {
+    uint32_t rate;          // bytes/s; 0 = sin límite en este sentido
+    uint64_t burst_milli;   // capacidad, en milésimas de byte
+    uint64_t tokens_milli;  // en milésimas: llenar ms * bytes/s es exacto
+    uint64_t refilled_ms;
+    unsigned waiting;       // conexiones esperando tokens
+} bucket_side_t;
+
+struct bandwidth_bucket {
+    char username[BANDWIDTH_USERNAME_LEN];
+    bucket_side_t sides[BANDWIDTH_DIRECTIONS];
+    unsigned refs;
+};
+
+// Nombre -> bandwidth_bucket_t* de los usuarios con conexiones limitadas
+static user_index_t buckets;
+
+static void set_rate(bucket_side_t *side, uint32_t rate, uint64_t now_ms) {
+    if (side->rate == rate) return;
+    uint64_t burst = (uint64_t)rate * BANDWIDTH_BURST_MS / 1000;
+    if (burst < BANDWIDTH_MIN_READ) {
+        burst = BANDWIDTH_MIN_READ;
+    }
+    side->rate = rate;
+    side->burst_milli = burst * 1000;
+    // Un bucket nuevo arranca lleno; uno que cambia de límite conserva lo
+    // que tenía, hasta la capacidad nueva
+    if (side->refilled_ms == 0 || side->tokens_milli > side->burst_milli) {
+        side->tokens_milli = side->burst_milli;
+    }
+    side->refilled_ms = now_ms;
+}
+
+bandwidth_bucket_t *bandwidth_acquire(const char *username, uint32_t upload, uint32_t download, uint64_t now_ms) {
+    if (upload == 0 && download == 0) return NULL;
+    bandwidth_bucket_t *bucket = user_index_get(&buckets, username);
+    if (bucket == NULL) {
+        bucket = calloc(1, sizeof(*bucket));
+        if (bucket == NULL) return NULL;
+        strncpy(bucket->username, username, sizeof(bucket->username) - 1);
+        if (user_index_put(&buckets, bucket->username, bucket) < 0) {
+            free(bucket);
+            return NULL;
+        }
+    }
+    // El límite vigente es el último leído: vale para todas sus conexiones
+    set_rate(&bucket->sides[BANDWIDTH_UPLOAD], upload, now_ms);
+    set_rate(&bucket->sides[BANDWIDTH_DOWNLOAD], download, now_ms);
+    bucket->refs++;
+    return bucket;
+}
+
+void bandwidth_release(bandwidth_bucket_t *bucket) {
+    if (bucket == NULL || --bucket->refs > 0) return;
+    user_index_remove(&buckets, bucket->username);
+    free(bucket);
+}
+
+size_t bandwidth_allowance(bandwidth_bucket_t *bucket, bandwidth_direction_t direction, size_t want,
+                           uint64_t now_ms, uint64_t *wait_ms) {
+    bucket_side_t *side = &bucket->sides[direction];
+    if (side->rate == 0) return want;
+
+    if (now_ms > side->refilled_ms) {
+        side->tokens_milli += (now_ms - side->refilled_ms) * side->rate;
+        if (side->tokens_milli > side->burst_milli) {
+            side->tokens_milli = side->burst_milli;
+        }
+        side->refilled_ms = now_ms;
+    }
+
+    uint64_t available = side->tokens_milli / 1000;
+    uint64_t needed = want < BANDWIDTH_MIN_READ ? want : BANDWIDTH_MIN_READ;
+    if (available >= needed) {
+        return available < want ? (size_t)available : want;
+    }
+    // Después de las que ya esperan, que se llevan `needed' cada una
+    uint64_t missing_milli = (side->waiting + 1) * needed * 1000 - side->tokens_milli;
+    *wait_ms = (missing_milli + side->rate - 1) / side->rate;
+    side->waiting++;
+    return 0;
+}
+
+void bandwidth_resume(bandwidth_bucket_t *bucket, bandwidth_direction_t direction) {
+    bucket_side_t *side = &bucket->sides[direction];
+    if (side->waiting > 0) {
+        side->waiting--;
+    }
+}
+
+void bandwidth_consume(bandwidth_bucket_t *bucket, bandwidth_direction_t direction, size_t bytes) {
+    bucket_side_t *side = &bucket->sides[direction];
+    if (side->rate == 0) return;
+    uint64_t milli = (uint64_t)bytes * 1000;
+    side->tokens_milli = milli > side->tokens_milli ? 0 : side->tokens_milli - milli;
+}
@@ -0,0 +1,59 @@
+#ifndef BANDWIDTH_H_Qm4vRt8XpL2nKw6ZcHb9JsDf
+#define BANDWIDTH_H_Qm4vRt8XpL2nKw6ZcHb9JsDf
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * bandwidth.c - límite de ancho de banda por usuario con token buckets.
+ *
+ * Cada usuario con límite tiene un bucket por sentido (subida: cliente ->
+ * destino, bajada: destino -> cliente) compartido por todas sus conexiones.
+ * El relay pide permiso antes de cada recv() y lee a lo sumo lo que hay;
+ * sin tokens deja de vigilar el socket hasta el momento que indica
+ * bandwidth_allowance(), así que no se duerme ni se acumula nada en el
+ * proxy. Los usuarios sin límite no tienen bucket: el relay solo ve un
+ * puntero en NULL.
+ *
+ * El bucket se llena a `rate' bytes/s hasta BANDWIDTH_BURST_MS de tráfico
+ * (al menos BANDWIDTH_MIN_READ), y con menos de BANDWIDTH_MIN_READ bytes
+ * disponibles se espera en lugar de hacer recv() chicos. Las conexiones
+ * que esperan se cuentan, y cada una nueva espera también el turno de las
+ * anteriores: así no despiertan todas juntas a pelear por los mismos
+ * tokens (la primera del loop se los llevaría siempre) sino de a una.
+ *
+ * Solo lo usa el loop de eventos: no tiene locks.
+ */
+
+#define BANDWIDTH_BURST_MS 250
+#define BANDWIDTH_MIN_READ 1024
+
+typedef enum {
+    BANDWIDTH_UPLOAD,
+    BANDWIDTH_DOWNLOAD,
+    BANDWIDTH_DIRECTIONS
+} bandwidth_direction_t;
+
+typedef struct bandwidth_bucket bandwidth_bucket_t;
+
+/**
+ * Bucket de `username' con los límites dados (bytes/s, 0 = sin límite),
+ * creado si hace falta; una referencia por conexión. NULL si los dos
+ * límites son 0 o no hay memoria (entonces no se limita).
+ */
+bandwidth_bucket_t *bandwidth_acquire(const char *username, uint32_t upload, uint32_t download, uint64_t now_ms);
+void bandwidth_release(bandwidth_bucket_t *bucket);
+
+/**
+ * Cuántos bytes se pueden leer ahora en `direction', hasta `want'. Si
+ * devuelve 0, la conexión queda esperando: en `*wait_ms' deja cuánto, y al
+ * retomarla (o cerrarla) hay que llamar a bandwidth_resume().
+ */
+size_t bandwidth_allowance(bandwidth_bucket_t *bucket, bandwidth_direction_t direction, size_t want,
+                           uint64_t now_ms, uint64_t *wait_ms);
+void bandwidth_resume(bandwidth_bucket_t *bucket, bandwidth_direction_t direction);
+
+/** Descuenta `bytes' leídos (a lo sumo lo que dio bandwidth_allowance) */
+void bandwidth_consume(bandwidth_bucket_t *bucket, bandwidth_direction_t direction, size_t bytes);
+
+#endif
@@ -0,0 +1,52 @@
+#include "conn_log.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+static conn_log_mode_t mode = CONN_LOG_DETAILED;
+static unsigned sample_every = 0;
+
+void conn_log_configure(conn_log_mode_t new_mode, unsigned new_sample_every) {
+    mode = new_mode;
+    sample_every = new_sample_every;
+}
+
+bool conn_log_summary_enabled(void) {
+    return mode == CONN_LOG_SUMMARY;
+}
+
+bool conn_log_detailed(uint64_t connection_id) {
+    if (mode == CONN_LOG_DETAILED) return true;
+    return sample_every > 0 && connection_id % sample_every == 0;
+}
+
+// Duración de una etapa en microsegundos, o "-" si no llegó a completarse
+static const char *stage(char *out, size_t len, uint64_t from_us, uint64_t to_us) {
+    if (from_us == 0 || to_us == 0 || to_us < from_us) return "-";
+    snprintf(out, len, "%" PRIu64, to_us - from_us);
+    return out;
+}
+
+static const char *or_dash(const char *value) {
+    return value != NULL && value[0] != '\0' ? value : "-";
+}
+
+void conn_log_summary(const conn_summary_t *s) {
+    if (mode != CONN_LOG_SUMMARY) return;
+    log_level level = s->error ? LOG_WARN : LOG_INFO;
+    if (!logger_enabled(level)) return;
+
+    char greeting[24], auth[24], connect[24], relay[24];
+    uint64_t total_us = s->closed_us > s->accepted_us ? s->closed_us - s->accepted_us : 0;
+    logger_log(level,
+               "conn id=%" PRIu64 " client=%s user=%s dest=%s status=%s reason=%s"
+               " greeting_us=%s auth_us=%s connect_us=%s relay_us=%s total_us=%" PRIu64
+               " bytes_up=%" PRIu64 " bytes_down=%" PRIu64,
+               s->connection_id, or_dash(s->client_address), or_dash(s->username),
+               or_dash(s->destination), s->error ? "error" : "ok", or_dash(s->close_reason),
+               stage(greeting, sizeof(greeting), s->accepted_us, s->greeted_us),
+               stage(auth, sizeof(auth), s->greeted_us, s->authenticated_us),
+               stage(connect, sizeof(connect), s->authenticated_us, s->connected_us),
+               stage(relay, sizeof(relay), s->connected_us, s->closed_us),
+               total_us, s->bytes_to_remote, s->bytes_to_client);
+}
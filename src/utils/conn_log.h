@@ -0,0 +1,72 @@
+#ifndef CONN_LOG_H_Vq4nX8rLt2KmZc6WsPb9HyDe
+#define CONN_LOG_H_Vq4nX8rLt2KmZc6WsPb9HyDe
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "logger.h"
+
+/**
+ * conn_log.c - modo de log "resumen" por conexión.
+ *
+ * En modo detallado (el de siempre) cada etapa de una conexión deja su línea
+ * INFO: aceptada, autenticación, destino pedido, conectada. En modo resumen
+ * esas líneas bajan a DEBUG y, al cerrarse la conexión, se escribe un único
+ * registro "conn" con la duración de cada etapa, los bytes en cada sentido,
+ * usuario, destino y motivo de cierre. Las conexiones que terminan con error
+ * dejan el resumen en WARN.
+ *
+ * Con un muestreo de 1 cada N, las conexiones cuyo id es múltiplo de N
+ * conservan además las líneas por etapa en INFO.
+ */
+
+typedef enum {
+    CONN_LOG_DETAILED,
+    CONN_LOG_SUMMARY,
+} conn_log_mode_t;
+
+// Motivos de cierre
+#define CONN_CLOSE_CLIENT "client_closed"
+#define CONN_CLOSE_REMOTE "remote_closed"
+#define CONN_CLOSE_GREETING "greeting_failed"
+#define CONN_CLOSE_AUTH "auth_failed"
+#define CONN_CLOSE_QUOTA "user_quota"
+#define CONN_CLOSE_REQUEST "request_failed"
+#define CONN_CLOSE_RECV_ERROR "recv_error"
+#define CONN_CLOSE_SEND_ERROR "send_error"
+
+typedef struct {
+    uint64_t connection_id;
+    const char *client_address;
+    const char *username;
+    const char *destination;
+    const char *close_reason;
+    bool error;
+    // Marcas del reloj monotónico en microsegundos; 0 = etapa no alcanzada
+    uint64_t accepted_us;
+    uint64_t greeted_us;
+    uint64_t authenticated_us;
+    uint64_t connected_us;
+    uint64_t closed_us;
+    uint64_t bytes_to_remote;
+    uint64_t bytes_to_client;
+} conn_summary_t;
+
+void conn_log_configure(conn_log_mode_t mode, unsigned sample_every);
+
+bool conn_log_summary_enabled(void);
+
+/** Indica si las líneas por etapa de esta conexión van en INFO */
+bool conn_log_detailed(uint64_t connection_id);
+
+/** Línea de una etapa de la conexión: INFO si es detallada, si no DEBUG */
+#define log_stage(connection_id, ...)                                       \
+    do {                                                                    \
+        if (conn_log_detailed(connection_id)) log_info(__VA_ARGS__);        \
+        else log_debug(__VA_ARGS__);                                        \
+    } while (0)
+
+/** Escribe el registro de cierre. No hace nada en modo detallado. */
+void conn_log_summary(const conn_summary_t *summary);
+
+#endif
@@ -0,0 +1,49 @@
+#include "conn_quota.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "user_index.h"
+
+#define CONN_QUOTA_USERNAME_LEN 64  // MAX_USERNAME_LEN
+
+typedef struct {
+    char username[CONN_QUOTA_USERNAME_LEN];
+    uint32_t count;
+} quota_entry_t;
+
+// Nombre -> quota_entry_t* de los usuarios con conexiones abiertas
+static user_index_t open_connections;
+
+bool conn_quota_acquire(const char *username, uint32_t max) {
+    quota_entry_t *entry = user_index_get(&open_connections, username);
+    if (entry == NULL) {
+        entry = calloc(1, sizeof(*entry));
+        // Sin memoria no se puede contar, y una conexión sin contar
+        // descontaría la de otra al cerrarse: se rechaza
+        if (entry == NULL) return false;
+        strncpy(entry->username, username, sizeof(entry->username) - 1);
+        if (user_index_put(&open_connections, entry->username, entry) < 0) {
+            free(entry);
+            return false;
+        }
+    } else if (max != 0 && entry->count >= max) {
+        return false;
+    }
+    entry->count++;
+    return true;
+}
+
+void conn_quota_release(const char *username) {
+    quota_entry_t *entry = user_index_get(&open_connections, username);
+    if (entry == NULL) return;
+    if (--entry->count == 0) {
+        user_index_remove(&open_connections, entry->username);
+        free(entry);
+    }
+}
+
+uint32_t conn_quota_count(const char *username) {
+    const quota_entry_t *entry = user_index_get(&open_connections, username);
+    return entry != NULL ? entry->count : 0;
+}
@@ -0,0 +1,33 @@
+#ifndef CONN_QUOTA_H_Hx3nVq7LmR9tKc2WzPd5BfYs
+#define CONN_QUOTA_H_Hx3nVq7LmR9tKc2WzPd5BfYs
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * conn_quota.c - conexiones abiertas por usuario, para el máximo de
+ * conexiones simultáneas.
+ *
+ * Se cuenta al autenticar (antes de responder al cliente) y se descuenta al
+ * cerrar. Se cuentan todos los usuarios, con o sin máximo, así que un
+ * máximo puesto después ya ve las conexiones que tiene abiertas. Un usuario
+ * sin conexiones no ocupa memoria.
+ *
+ * Solo lo usa el loop de eventos, que es quien abre y cierra conexiones:
+ * el contador no necesita locks ni atómicos.
+ */
+
+/**
+ * Cuenta una conexión de `username' si tiene menos de `max' abiertas (0 =
+ * sin máximo). false si llegó al máximo (o no hay memoria): la conexión no
+ * se cuenta.
+ */
+bool conn_quota_acquire(const char *username, uint32_t max);
+
+/** Descuenta una conexión contada con conn_quota_acquire */
+void conn_quota_release(const char *username);
+
+/** Conexiones de `username' contadas ahora */
+uint32_t conn_quota_count(const char *username);
+
+#endif
@@ -0,0 +1,155 @@
+#include "conn_table.h"
+
+#include <string.h>
+
+#include "seqlock.h"
+#include "util.h"
+
+typedef struct {
+    seqlock_t lock;
+    conn_info_t info;
+} conn_slot_t;
+
+static conn_slot_t table[CONN_TABLE_SIZE];
+
+static const char *state_names[] = {
+    "GREETING", "AUTH", "REQUEST", "CONNECTING", "RELAYING", "CLOSING"
+};
+
+const char *conn_state_name(conn_state_t state) {
+    if ((size_t)state >= sizeof(state_names) / sizeof(state_names[0])) {
+        return "UNKNOWN";
+    }
+    return state_names[state];
+}
+
+static conn_slot_t *slot_at(size_t slot) {
+    return slot < CONN_TABLE_SIZE ? &table[slot] : NULL;
+}
+
+void conn_table_open(size_t slot, uint64_t connection_id, const struct sockaddr *addr, uint64_t now_ms) {
+    conn_slot_t *s = slot_at(slot);
+    if (s == NULL) return;
+
+    char address[MAX_ADDRESS_LEN] = "unknown";
+    if (addr != NULL) {
+        printSocketAddress(addr, address);
+    }
+
+    seqlock_write_begin(&s->lock);
+    memset(&s->info, 0, sizeof(s->info));
+    s->info.in_use = true;
+    s->info.connection_id = connection_id;
+    strncpy(s->info.client_address, address, MAX_ADDRESS_LEN - 1);
+    s->info.state = CONN_STATE_GREETING;
+    s->info.opened_ms = now_ms;
+    s->info.last_activity_ms = now_ms;
+    seqlock_write_end(&s->lock);
+}
+
+void conn_table_close(size_t slot) {
+    conn_slot_t *s = slot_at(slot);
+    if (s == NULL) return;
+    seqlock_write_begin(&s->lock);
+    s->info.in_use = false;
+    seqlock_write_end(&s->lock);
+}
+
+void conn_table_set_state(size_t slot, conn_state_t state) {
+    conn_slot_t *s = slot_at(slot);
+    if (s == NULL || s->info.state == state) return;
+    seqlock_write_begin(&s->lock);
+    s->info.state = state;
+    seqlock_write_end(&s->lock);
+}
+
+void conn_table_set_user(size_t slot, const char *username) {
+    conn_slot_t *s = slot_at(slot);
+    if (s == NULL || username == NULL) return;
+    seqlock_write_begin(&s->lock);
+    strncpy(s->info.username, username, MAX_USERNAME_LEN - 1);
+    s->info.username[MAX_USERNAME_LEN - 1] = '\0';
+    seqlock_write_end(&s->lock);
+}
+
+void conn_table_set_destination(size_t slot, const char *destination) {
+    conn_slot_t *s = slot_at(slot);
+    if (s == NULL || destination == NULL) return;
+    seqlock_write_begin(&s->lock);
+    strncpy(s->info.destination, destination, MAX_DESTINATION_LEN - 1);
+    s->info.destination[MAX_DESTINATION_LEN - 1] = '\0';
+    seqlock_write_end(&s->lock);
+}
+
+void conn_table_add_bytes(size_t slot, uint64_t to_remote, uint64_t to_client, uint64_t now_ms) {
+    conn_slot_t *s = slot_at(slot);
+    if (s == NULL) return;
+    seqlock_write_begin(&s->lock);
+    s->info.bytes_to_remote += to_remote;
+    s->info.bytes_to_client += to_client;
+    s->info.last_activity_ms = now_ms;
+    seqlock_write_end(&s->lock);
+}
+
+void conn_table_set_pending(size_t slot, size_t to_remote, size_t to_client) {
+    conn_slot_t *s = slot_at(slot);
+    if (s == NULL) return;
+    if (s->info.pending_to_remote == to_remote && s->info.pending_to_client == to_client) return;
+    seqlock_write_begin(&s->lock);
+    s->info.pending_to_remote = (uint32_t)to_remote;
+    s->info.pending_to_client = (uint32_t)to_client;
+    seqlock_write_end(&s->lock);
+}
+
+void conn_table_set_tcp(size_t slot, const tcp_leg_sample_t *client, const tcp_leg_sample_t *remote) {
+    conn_slot_t *s = slot_at(slot);
+    if (s == NULL) return;
+    seqlock_write_begin(&s->lock);
+    s->info.client_tcp = *client;
+    s->info.remote_tcp = *remote;
+    seqlock_write_end(&s->lock);
+}
+
+bool conn_table_read(size_t slot, conn_info_t *out) {
+    conn_slot_t *s = slot_at(slot);
+    if (s == NULL || out == NULL) return false;
+    uint32_t seq;
+    do {
+        seq = seqlock_read_begin(&s->lock);
+        memcpy(out, &s->info, sizeof(*out));
+    } while (seqlock_read_retry(&s->lock, seq));
+    return out->in_use;
+}
+
+static bool matches(const conn_query_t *query, const conn_info_t *info) {
+    if (query->username != NULL && query->username[0] != '\0' &&
+        strcmp(query->username, info->username) != 0) {
+        return false;
+    }
+    if (query->destination != NULL && query->destination[0] != '\0' &&
+        strstr(info->destination, query->destination) == NULL) {
+        return false;
+    }
+    return true;
+}
+
+size_t conn_table_query(const conn_query_t *query, conn_info_t *out, size_t *total_matches) {
+    size_t matched = 0;
+    size_t copied = 0;
+    conn_info_t info;
+
+    for (size_t i = 0; i < CONN_TABLE_SIZE; i++) {
+        if (!conn_table_read(i, &info) || !matches(query, &info)) {
+            continue;
+        }
+        if (matched >= query->offset && copied < query->limit) {
+            out[copied++] = info;
+        }
+        matched++;
+    }
+
+    if (total_matches != NULL) {
+        *total_matches = matched;
+    }
+    return copied;
+}
@@ -0,0 +1,85 @@
+#ifndef CONN_TABLE_H_Rk3vP9wQz2YtLm8cXn5JbGsA
+#define CONN_TABLE_H_Rk3vP9wQz2YtLm8cXn5JbGsA
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "../shared.h"
+
+/**
+ * conn_table.c - vista pública de la tabla de conexiones del proxy.
+ *
+ * El loop de eventos es el único escritor: cada vez que una conexión cambia
+ * de estado, autentica, elige destino o mueve bytes actualiza su entrada.
+ * Cada entrada está protegida por un seqlock propio, de modo que los hilos de
+ * management pueden tomar una foto consistente de cualquier conexión sin
+ * bloquear ni demorar al loop.
+ *
+ * El índice de cada entrada coincide con el slot que la conexión ocupa en el
+ * arreglo de clientes del servidor.
+ */
+
+#define CONN_TABLE_SIZE 1024
+
+typedef enum {
+    CONN_STATE_GREETING,
+    CONN_STATE_AUTH,
+    CONN_STATE_REQUEST,
+    CONN_STATE_CONNECTING,
+    CONN_STATE_RELAYING,
+    CONN_STATE_CLOSING,
+} conn_state_t;
+
+typedef struct {
+    bool in_use;
+    uint64_t connection_id;
+    char client_address[MAX_ADDRESS_LEN];
+    char username[MAX_USERNAME_LEN];
+    char destination[MAX_DESTINATION_LEN];
+    conn_state_t state;
+    uint64_t opened_ms;             // monotónico, al aceptar la conexión
+    uint64_t last_activity_ms;      // monotónico, último byte relayado
+    uint64_t bytes_to_remote;       // cliente -> destino
+    uint64_t bytes_to_client;       // destino -> cliente
+    uint32_t pending_to_remote;
+    uint32_t pending_to_client;
+    tcp_leg_sample_t client_tcp;    // última muestra de TCP_INFO de cada pata
+    tcp_leg_sample_t remote_tcp;
+} conn_info_t;
+
+/** Filtros y paginación para conn_table_query. Los NULL/vacíos no filtran. */
+typedef struct {
+    const char *username;       // igualdad exacta
+    const char *destination;    // substring de "host:puerto"
+    size_t offset;
+    size_t limit;
+} conn_query_t;
+
+/** Nombre legible de un estado */
+const char *conn_state_name(conn_state_t state);
+
+/* Escritura: solo desde el loop de eventos */
+void conn_table_open(size_t slot, uint64_t connection_id, const struct sockaddr *addr, uint64_t now_ms);
+void conn_table_close(size_t slot);
+void conn_table_set_state(size_t slot, conn_state_t state);
+void conn_table_set_user(size_t slot, const char *username);
+void conn_table_set_destination(size_t slot, const char *destination);
+void conn_table_add_bytes(size_t slot, uint64_t to_remote, uint64_t to_client, uint64_t now_ms);
+void conn_table_set_pending(size_t slot, size_t to_remote, size_t to_client);
+void conn_table_set_tcp(size_t slot, const tcp_leg_sample_t *client, const tcp_leg_sample_t *remote);
+
+/* Lectura: desde cualquier hilo */
+
+/** Copia la entrada de un slot. Retorna false si el slot está libre. */
+bool conn_table_read(size_t slot, conn_info_t *out);
+
+/**
+ * Copia en `out' (capacidad query->limit) las conexiones vivas que cumplen el
+ * filtro, salteando las primeras query->offset. Deja en `total_matches' la
+ * cantidad total que cumple el filtro. Retorna la cantidad copiada.
+ */
+size_t conn_table_query(const conn_query_t *query, conn_info_t *out, size_t *total_matches);
+
+#endif
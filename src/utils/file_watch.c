@@ -0,0 +1,132 @@
+#include "file_watch.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#define FILE_WATCH_POLL_MS 500
+
+typedef struct {
+    char path[PATH_MAX];
+    const char *name;       // dentro de path
+    int wd;
+    bool pending;
+} watched_t;
+
+static watched_t files[FILE_WATCH_MAX_FILES];
+static size_t file_count = 0;
+static file_watch_fn callback;
+static void *callback_ctx;
+static int inotify_fd = -1;
+static pthread_t thread;
+static bool running = false;
+
+// Directorio de `path' en `dir' ("." si no tiene)
+static void dirname_of(const char *path, char *dir, size_t len) {
+    const char *slash = strrchr(path, '/');
+    if (slash == NULL) {
+        snprintf(dir, len, ".");
+    } else if (slash == path) {
+        snprintf(dir, len, "/");
+    } else {
+        snprintf(dir, len, "%.*s", (int)(slash - path), path);
+    }
+}
+
+static void handle_events(void) {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n = read(inotify_fd, buffer, sizeof(buffer));
+    for (char *p = buffer; n > 0 && p < buffer + n;) {
+        const struct inotify_event *event = (const struct inotify_event *)p;
+        for (size_t i = 0; i < file_count; i++) {
+            if (files[i].wd == event->wd && event->len > 0 && strcmp(event->name, files[i].name) == 0) {
+                files[i].pending = true;
+            }
+        }
+        p += sizeof(*event) + event->len;
+    }
+}
+
+static void *watch_main(void *arg) {
+    (void)arg;
+    struct pollfd pfd = { .fd = inotify_fd, .events = POLLIN };
+    bool settling = false;
+    while (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        int ready = poll(&pfd, 1, settling ? FILE_WATCH_SETTLE_MS : FILE_WATCH_POLL_MS);
+        if (ready < 0 && errno != EINTR) break;
+        if (ready > 0) {
+            handle_events();
+            settling = true;
+            continue;
+        }
+        if (!settling) continue;
+        // Se calmó: un aviso por archivo, aunque haya tenido varios eventos
+        settling = false;
+        for (size_t i = 0; i < file_count; i++) {
+            if (files[i].pending) {
+                files[i].pending = false;
+                callback(files[i].path, callback_ctx);
+            }
+        }
+    }
+    return NULL;
+}
+
+int file_watch_start(const char *const *paths, size_t count, file_watch_fn on_change, void *ctx) {
+    if (running || count == 0 || count > FILE_WATCH_MAX_FILES) return -1;
+    inotify_fd = inotify_init1(IN_CLOEXEC);
+    if (inotify_fd < 0) return -1;
+
+    file_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        watched_t *file = &files[file_count];
+        snprintf(file->path, sizeof(file->path), "%s", paths[i]);
+        const char *slash = strrchr(file->path, '/');
+        file->name = slash ? slash + 1 : file->path;
+        file->pending = false;
+        char dir[PATH_MAX];
+        dirname_of(file->path, dir, sizeof(dir));
+        // Dos archivos del mismo directorio comparten el watch descriptor
+        file->wd = inotify_add_watch(inotify_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (file->wd >= 0) {
+            file_count++;
+        }
+    }
+    if (file_count == 0) {
+        close(inotify_fd);
+        inotify_fd = -1;
+        return -1;
+    }
+
+    callback = on_change;
+    callback_ctx = ctx;
+    running = true;
+    // Las señales las atiende el loop: el hilo nace con todas bloqueadas
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    int created = pthread_create(&thread, NULL, watch_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (created != 0) {
+        running = false;
+        close(inotify_fd);
+        inotify_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+void file_watch_stop(void) {
+    if (!running) return;
+    __atomic_store_n(&running, false, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+    close(inotify_fd);
+    inotify_fd = -1;
+}
@@ -0,0 +1,25 @@
+#ifndef FILE_WATCH_H_Hn4rWq8ZcT1vLm6XpKd3BsYj
+#define FILE_WATCH_H_Hn4rWq8ZcT1vLm6XpKd3BsYj
+
+#include <stddef.h>
+
+/**
+ * file_watch.c - avisa cuando cambian unos pocos archivos, con inotify.
+ *
+ * Un hilo propio vigila el directorio de cada archivo (así ve tanto una
+ * escritura en el lugar como un editor que escribe un temporal y lo
+ * renombra encima) y, pasados FILE_WATCH_SETTLE_MS sin eventos nuevos,
+ * llama a on_change una vez por archivo tocado. El callback corre en ese
+ * hilo, nunca en el loop.
+ */
+
+#define FILE_WATCH_MAX_FILES 4
+#define FILE_WATCH_SETTLE_MS 200
+
+typedef void (*file_watch_fn)(const char *path, void *ctx);
+
+/** 0 si arrancó, -1 si inotify no está disponible o ya estaba corriendo */
+int file_watch_start(const char *const *paths, size_t count, file_watch_fn on_change, void *ctx);
+void file_watch_stop(void);
+
+#endif
@@ -0,0 +1,173 @@
+#include "flight_recorder.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#include "seqlock.h"
+#include "util.h"
+
+typedef struct {
+    seqlock_t lock;
+    bool in_use;
+    uint64_t connection_id;
+    char username[FLIGHT_USERNAME_LEN];
+    char destination[FLIGHT_DESTINATION_LEN];
+    uint64_t event_total;
+    flight_event_t events[FLIGHT_EVENTS];
+} flight_slot_t;
+
+typedef struct {
+    uint64_t closed_ms;
+    flight_record_t record;
+} flight_archived_t;
+
+static flight_slot_t slots[FLIGHT_SLOTS];
+
+// Archivo circular de conexiones fallidas; lo escribe el loop al cerrar
+static pthread_mutex_t archive_mutex = PTHREAD_MUTEX_INITIALIZER;
+static flight_archived_t archive[FLIGHT_RETAINED];
+static size_t archive_next = 0;
+
+static const char *event_names[] = {
+    "ACCEPT", "STATE", "RECV", "SEND", "CONNECT", "ERROR", "CLOSE"
+};
+
+const char *flight_event_name(flight_event_type_t type) {
+    if ((size_t)type >= sizeof(event_names) / sizeof(event_names[0])) {
+        return "UNKNOWN";
+    }
+    return event_names[type];
+}
+
+static flight_slot_t *slot_at(size_t slot) {
+    return slot < FLIGHT_SLOTS ? &slots[slot] : NULL;
+}
+
+void flight_open(size_t slot, uint64_t connection_id) {
+    flight_slot_t *s = slot_at(slot);
+    if (s == NULL) return;
+    seqlock_write_begin(&s->lock);
+    s->in_use = true;
+    s->connection_id = connection_id;
+    s->username[0] = '\0';
+    s->destination[0] = '\0';
+    s->event_total = 0;
+    seqlock_write_end(&s->lock);
+}
+
+void flight_set_user(size_t slot, const char *username) {
+    flight_slot_t *s = slot_at(slot);
+    if (s == NULL || username == NULL) return;
+    seqlock_write_begin(&s->lock);
+    strncpy(s->username, username, FLIGHT_USERNAME_LEN - 1);
+    s->username[FLIGHT_USERNAME_LEN - 1] = '\0';
+    seqlock_write_end(&s->lock);
+}
+
+void flight_set_destination(size_t slot, const char *destination) {
+    flight_slot_t *s = slot_at(slot);
+    if (s == NULL || destination == NULL) return;
+    seqlock_write_begin(&s->lock);
+    strncpy(s->destination, destination, FLIGHT_DESTINATION_LEN - 1);
+    s->destination[FLIGHT_DESTINATION_LEN - 1] = '\0';
+    seqlock_write_end(&s->lock);
+}
+
+void flight_event(size_t slot, flight_event_type_t type, uint8_t state, flight_leg_t leg,
+                  int64_t result, int err) {
+    flight_slot_t *s = slot_at(slot);
+    if (s == NULL || !s->in_use) return;
+    uint64_t now_us = monotonicNanos() / 1000;
+    seqlock_write_begin(&s->lock);
+    flight_event_t *e = &s->events[s->event_total & (FLIGHT_EVENTS - 1)];
+    e->time_us = now_us;
+    e->result = result;
+    e->err = err;
+    e->type = (uint8_t)type;
+    e->state = state;
+    e->leg = (uint8_t)leg;
+    e->reserved = 0;
+    s->event_total++;
+    seqlock_write_end(&s->lock);
+}
+
+// Copia el slot al formato de respuesta, con los eventos en orden
+static bool snapshot_slot(const flight_slot_t *s, flight_record_t *out) {
+    flight_slot_t copy;
+    uint32_t seq;
+    do {
+        seq = seqlock_read_begin(&s->lock);
+        memcpy(&copy, s, sizeof(copy));
+    } while (seqlock_read_retry(&s->lock, seq));
+    if (!copy.in_use) return false;
+
+    memset(out, 0, sizeof(*out));
+    out->connection_id = copy.connection_id;
+    memcpy(out->username, copy.username, sizeof(out->username));
+    memcpy(out->destination, copy.destination, sizeof(out->destination));
+    out->live = 1;
+    out->event_total = copy.event_total;
+    uint64_t first = copy.event_total > FLIGHT_EVENTS ? copy.event_total - FLIGHT_EVENTS : 0;
+    for (uint64_t i = first; i < copy.event_total; i++) {
+        out->events[out->event_count++] = copy.events[i & (FLIGHT_EVENTS - 1)];
+    }
+    return true;
+}
+
+void flight_close(size_t slot, const char *reason, bool failed) {
+    flight_slot_t *s = slot_at(slot);
+    if (s == NULL || !s->in_use) return;
+
+    if (failed) {
+        // El loop es el único escritor del slot: leerlo acá no necesita reintentos
+        flight_record_t record;
+        snapshot_slot(s, &record);
+        record.live = 0;
+        record.failed = 1;
+        if (reason != NULL) {
+            strncpy(record.close_reason, reason, FLIGHT_REASON_LEN - 1);
+        }
+        pthread_mutex_lock(&archive_mutex);
+        archive[archive_next].closed_ms = monotonicMillis();
+        archive[archive_next].record = record;
+        archive_next = (archive_next + 1) % FLIGHT_RETAINED;
+        pthread_mutex_unlock(&archive_mutex);
+    }
+
+    seqlock_write_begin(&s->lock);
+    s->in_use = false;
+    seqlock_write_end(&s->lock);
+}
+
+static bool record_matches(const flight_record_t *record, uint64_t connection_id, const char *username) {
+    if (connection_id != 0) return record->connection_id == connection_id;
+    if (username != NULL && username[0] != '\0') return strcmp(record->username, username) == 0;
+    return record->failed;
+}
+
+size_t flight_recorder_query(uint64_t connection_id, const char *username, flight_record_t *out, size_t max) {
+    size_t count = 0;
+    bool filtered = connection_id != 0 || (username != NULL && username[0] != '\0');
+
+    if (filtered) {
+        for (size_t i = 0; i < FLIGHT_SLOTS && count < max; i++) {
+            if (snapshot_slot(&slots[i], &out[count]) &&
+                record_matches(&out[count], connection_id, username)) {
+                count++;
+            }
+        }
+    }
+
+    uint64_t now_ms = monotonicMillis();
+    pthread_mutex_lock(&archive_mutex);
+    for (size_t n = 1; n <= FLIGHT_RETAINED && count < max; n++) {
+        const flight_archived_t *a = &archive[(archive_next + FLIGHT_RETAINED - n) % FLIGHT_RETAINED];
+        if (a->closed_ms == 0 || now_ms - a->closed_ms > FLIGHT_RETAIN_SECONDS * 1000ULL) continue;
+        if (!record_matches(&a->record, connection_id, username)) continue;
+        out[count] = a->record;
+        out[count].closed_ago_ms = now_ms - a->closed_ms;
+        count++;
+    }
+    pthread_mutex_unlock(&archive_mutex);
+    return count;
+}
@@ -0,0 +1,89 @@
+#ifndef FLIGHT_RECORDER_H_Wc5rT8nQx3LbVz7KmYd2PgHs
+#define FLIGHT_RECORDER_H_Wc5rT8nQx3LbVz7KmYd2PgHs
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * flight_recorder.c - últimos eventos de cada conexión.
+ *
+ * Cada slot de conexión tiene un ring fijo de FLIGHT_EVENTS eventos: cambios
+ * de estado, resultados de recv/send con su errno, conexión al destino y
+ * cierre. Registrar un evento es escribir 24 bytes bajo el seqlock del slot;
+ * el loop es el único escritor y management copia el ring sin frenarlo.
+ *
+ * Cuando una conexión termina con error su ring se archiva: se conservan las
+ * últimas FLIGHT_RETAINED fallidas durante FLIGHT_RETAIN_SECONDS para poder
+ * mirarlas después de que el usuario reporte el problema.
+ */
+
+#define FLIGHT_EVENTS 32                // potencia de 2
+#define FLIGHT_SLOTS 1024               // igual a CONN_TABLE_SIZE
+#define FLIGHT_RETAINED 64
+#define FLIGHT_RETAIN_SECONDS 600
+#define FLIGHT_USERNAME_LEN 64
+#define FLIGHT_DESTINATION_LEN 272
+#define FLIGHT_REASON_LEN 24
+
+typedef enum {
+    FLIGHT_ACCEPT,      // result = fd del cliente
+    FLIGHT_STATE,       // result = nuevo conn_state_t
+    FLIGHT_RECV,        // result = retorno de recv(), err = errno si < 0
+    FLIGHT_SEND,        // result = retorno de send(), err = errno si < 0
+    FLIGHT_CONNECT,     // result = fd del destino
+    FLIGHT_ERROR,       // err = errno al fallar la etapa
+    FLIGHT_CLOSE,       // result = 1 si terminó con error
+} flight_event_type_t;
+
+typedef enum {
+    FLIGHT_LEG_CLIENT,
+    FLIGHT_LEG_REMOTE,
+} flight_leg_t;
+
+typedef struct {
+    uint64_t time_us;           // reloj monotónico
+    int64_t result;
+    int32_t err;
+    uint8_t type;               // flight_event_type_t
+    uint8_t state;              // conn_state_t de la conexión en ese momento
+    uint8_t leg;                // flight_leg_t de recv/send
+    uint8_t reserved;
+} flight_event_t;
+
+// Ring de una conexión, ya ordenado; también es la entrada de CMD_FLIGHT_RECORDER
+typedef struct {
+    uint64_t connection_id;
+    char username[FLIGHT_USERNAME_LEN];
+    char destination[FLIGHT_DESTINATION_LEN];
+    char close_reason[FLIGHT_REASON_LEN];
+    uint32_t live;              // 1 si la conexión sigue abierta
+    uint32_t failed;            // 1 si se cerró con error
+    uint64_t closed_ago_ms;     // para las archivadas
+    uint64_t event_total;       // eventos registrados (pueden ser más que los del ring)
+    uint32_t event_count;       // eventos válidos en `events', del más viejo al más nuevo
+    uint32_t reserved;
+    flight_event_t events[FLIGHT_EVENTS];
+} flight_record_t;
+
+const char *flight_event_name(flight_event_type_t type);
+
+/* Escritura: solo desde el loop de eventos */
+void flight_open(size_t slot, uint64_t connection_id);
+void flight_set_user(size_t slot, const char *username);
+void flight_set_destination(size_t slot, const char *destination);
+void flight_event(size_t slot, flight_event_type_t type, uint8_t state, flight_leg_t leg,
+                  int64_t result, int err);
+/** Registra el cierre y, si `failed', archiva el ring */
+void flight_close(size_t slot, const char *reason, bool failed);
+
+/* Lectura: desde cualquier hilo */
+
+/**
+ * Copia en `out' hasta `max' rings: el de `connection_id' si no es 0, los de
+ * `username' si no es vacío (vivos y archivados), o si no hay filtro las
+ * conexiones fallidas archivadas, de la más reciente a la más vieja.
+ */
+size_t flight_recorder_query(uint64_t connection_id, const char *username, flight_record_t *out, size_t max);
+
+#endif
@@ -0,0 +1,106 @@
+#include "log_rotate.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static pthread_mutex_t policy_mutex = PTHREAD_MUTEX_INITIALIZER;
+static log_rotation_policy_t policy = {
+    .max_bytes = 0,
+    .interval_seconds = 0,
+    .keep = LOG_ROTATE_DEFAULT_KEEP,
+};
+static uint32_t generation = 0;
+
+typedef struct {
+    char path[PATH_MAX];
+    log_rotation_state_t state;
+} watched_file_t;
+
+static watched_file_t watched[LOG_ROTATE_MAX_WATCHED];
+static int watched_count = 0;
+
+void log_rotation_configure(const log_rotation_policy_t *new_policy) {
+    pthread_mutex_lock(&policy_mutex);
+    policy = *new_policy;
+    if (policy.keep == 0) {
+        policy.keep = 1;
+    }
+    pthread_mutex_unlock(&policy_mutex);
+}
+
+void log_rotation_get_policy(log_rotation_policy_t *out) {
+    pthread_mutex_lock(&policy_mutex);
+    *out = policy;
+    pthread_mutex_unlock(&policy_mutex);
+}
+
+uint32_t log_rotation_request(void) {
+    return __atomic_add_fetch(&generation, 1, __ATOMIC_RELEASE);
+}
+
+void log_rotation_start(log_rotation_state_t *state, uint64_t size) {
+    state->size = size;
+    state->opened_at = time(NULL);
+    state->generation = __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+}
+
+bool log_rotation_due(const log_rotation_state_t *state, uint64_t pending) {
+    if (state->generation != __atomic_load_n(&generation, __ATOMIC_ACQUIRE)) {
+        return true;
+    }
+    log_rotation_policy_t current;
+    log_rotation_get_policy(&current);
+    if (current.max_bytes > 0 && state->size > 0 && state->size + pending > current.max_bytes) {
+        return true;
+    }
+    if (current.interval_seconds > 0 && state->size > 0 &&
+        time(NULL) - state->opened_at >= (time_t)current.interval_seconds) {
+        return true;
+    }
+    return false;
+}
+
+int log_rotate_file(const char *path) {
+    log_rotation_policy_t current;
+    log_rotation_get_policy(&current);
+
+    char from[PATH_MAX + 16];
+    char to[PATH_MAX + 16];
+    snprintf(to, sizeof(to), "%s.%u", path, current.keep);
+    unlink(to);
+    for (uint32_t i = current.keep; i > 1; i--) {
+        snprintf(from, sizeof(from), "%s.%u", path, i - 1);
+        snprintf(to, sizeof(to), "%s.%u", path, i);
+        rename(from, to);
+    }
+    snprintf(to, sizeof(to), "%s.1", path);
+    return rename(path, to);
+}
+
+static uint64_t file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (uint64_t)st.st_size : 0;
+}
+
+void log_rotation_watch(const char *path) {
+    if (watched_count >= LOG_ROTATE_MAX_WATCHED) return;
+    watched_file_t *file = &watched[watched_count++];
+    strncpy(file->path, path, sizeof(file->path) - 1);
+    log_rotation_start(&file->state, file_size(path));
+}
+
+void log_rotation_tick(void) {
+    for (int i = 0; i < watched_count; i++) {
+        watched_file_t *file = &watched[i];
+        file->state.size = file_size(file->path);
+        if (!log_rotation_due(&file->state, 0)) continue;
+        if (file->state.size > 0) {
+            log_rotate_file(file->path);
+        }
+        log_rotation_start(&file->state, 0);
+    }
+}
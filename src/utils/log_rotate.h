@@ -0,0 +1,64 @@
+#ifndef LOG_ROTATE_H_Gm7xT3vKq9WcRb2NzLh5YdFs
+#define LOG_ROTATE_H_Gm7xT3vKq9WcRb2NzLh5YdFs
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * log_rotate.c - rotación de logs por tamaño, por intervalo o a pedido.
+ *
+ * La política es global para todos los archivos. Cada escritor la consulta
+ * desde su propio hilo y rota su archivo sin frenar a nadie más: el logger
+ * desde su hilo escritor, el registro de accesos al volcar su lote, y los
+ * archivos que se abren por escritura (pop3_credentials.log) desde el tick
+ * del loop con log_rotation_tick.
+ *
+ * Rotar es renombrar path -> path.1 -> path.2 ... hasta `keep' archivos
+ * (el más viejo se borra) y empezar uno nuevo.
+ *
+ * La rotación a pedido (CMD_ROTATE_LOGS) incrementa un número de generación;
+ * cada escritor rota cuando ve una generación distinta de la suya.
+ */
+
+#define LOG_ROTATE_DEFAULT_KEEP 5
+#define LOG_ROTATE_MAX_WATCHED 4
+
+typedef struct {
+    uint64_t max_bytes;         // 0 = sin límite de tamaño
+    uint32_t interval_seconds;  // 0 = sin rotación periódica
+    uint32_t keep;              // archivos rotados que se conservan (>= 1)
+} log_rotation_policy_t;
+
+// Estado de rotación de un archivo, propio de su escritor
+typedef struct {
+    uint64_t size;
+    time_t opened_at;
+    uint32_t generation;
+} log_rotation_state_t;
+
+void log_rotation_configure(const log_rotation_policy_t *policy);
+void log_rotation_get_policy(log_rotation_policy_t *out);
+
+/** Pide rotar todos los logs. Retorna la nueva generación. */
+uint32_t log_rotation_request(void);
+
+/** Arranca el estado de un archivo recién abierto con `size' bytes */
+void log_rotation_start(log_rotation_state_t *state, uint64_t size);
+
+/** Indica si el archivo debería rotar antes de escribir `pending' bytes más */
+bool log_rotation_due(const log_rotation_state_t *state, uint64_t pending);
+
+/** Renombra la cadena path.N. Retorna 0 si pudo, -1 si no. */
+int log_rotate_file(const char *path);
+
+/**
+ * Registra un archivo que no queda abierto (se abre en cada escritura) para
+ * que log_rotation_tick lo rote.
+ */
+void log_rotation_watch(const char *path);
+
+/** Revisa y rota los archivos registrados. Desde el loop, una vez por segundo. */
+void log_rotation_tick(void);
+
+#endif
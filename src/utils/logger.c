@@ -1,31 +1,347 @@
 #include "logger.h"
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 #include <pthread.h>
+#include <sched.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "log_rotate.h"
+
+/*
+ * Asynchronous mode: bounded MPSC ring (Vyukov style). Each slot carries a
+ * sequence number; a producer claims a position with a CAS on `enqueue_pos',
+ * fills the slot and publishes it by storing pos + 1 in its sequence. The
+ * single writer thread consumes slots in order and hands them back by storing
+ * pos + LOG_RING_SIZE.
+ */
+#define LOG_RING_SIZE 4096              // power of two
+#define LOG_MESSAGE_LEN 512
+#define LOG_BATCH_SIZE (64 * 1024)
+#define LOG_WRITER_IDLE_MS 100
+#define LOG_FLUSH_TIMEOUT_MS 2000
+#define LOG_LEVEL_ACCESS -1             // record produced by log_access
+
+typedef struct {
+    uint64_t sequence;
+    time_t timestamp;
+    int level;
+    int saved_errno;
+    char message[LOG_MESSAGE_LEN];
+} log_record;
+
+int logger_runtime_level = LOG_DEFAULT_LEVEL;
 
 static struct {
     FILE *file;
-    log_level level;
     pthread_mutex_t mutex;
+
+    // Asynchronous mode
+    bool async;
+    int fd;
+    char path[PATH_MAX];
+    log_rotation_state_t rotation;      // only touched by the writer thread
+    log_overflow_policy policy;
+    log_record *ring;
+    uint64_t enqueue_pos;
+    uint64_t dequeue_pos;               // only written by the writer thread
+    uint64_t dropped;
+    int producers;                      // threads between enter_async and leave_async
+    int writer_waiting;
+    bool writer_running;
+    pthread_t writer;
+    pthread_cond_t wakeup;
 } L = {
     .file = NULL,
-    .level = LOG_DEFAULT_LEVEL,
     .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .fd = -1,
+    .policy = LOG_OVERFLOW_DROP,
+    .wakeup = PTHREAD_COND_INITIALIZER,
 };
 
 static const char *level_strings[] = {
     "DEBUG", "INFO", "WARN", "ERROR", "FATAL"
 };
 
+static void format_timestamp(time_t now, char *out, size_t out_len) {
+    struct tm tm_now;
+    localtime_r(&now, &tm_now);
+    strftime(out, out_len, "%Y-%m-%d %H:%M:%S", &tm_now);
+}
+
+/* ---------- writer thread ---------- */
+
+static void write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+}
+
+// The timestamp only changes once per second, so the writer caches it
+static size_t format_record(const log_record *rec, char *out, size_t out_len) {
+    static time_t cached_time = (time_t)-1;
+    static char cached_stamp[32];
+    if (rec->timestamp != cached_time) {
+        cached_time = rec->timestamp;
+        format_timestamp(rec->timestamp, cached_stamp, sizeof(cached_stamp));
+    }
+
+    int n;
+    if (rec->level == LOG_LEVEL_ACCESS) {
+        n = snprintf(out, out_len, "%s [ACCESS] %s\n", cached_stamp, rec->message);
+    } else if (rec->level >= LOG_ERROR) {
+        n = snprintf(out, out_len, "%s [%-5s] %s (errno: %s)\n", cached_stamp,
+                     level_strings[rec->level], rec->message, strerror(rec->saved_errno));
+    } else {
+        n = snprintf(out, out_len, "%s [%-5s] %s\n", cached_stamp,
+                     level_strings[rec->level], rec->message);
+    }
+    if (n < 0) return 0;
+    return (size_t)n < out_len ? (size_t)n : out_len - 1;
+}
+
+// Rotation happens on the writer thread between batches: producers keep
+// filling the ring while the file is renamed and reopened.
+static void maybe_rotate(size_t pending) {
+    if (!log_rotation_due(&L.rotation, pending)) {
+        return;
+    }
+    if (L.rotation.size == 0) {
+        // Nothing written yet: only catch up with the requested generation
+        log_rotation_start(&L.rotation, 0);
+        return;
+    }
+    int fd = -1;
+    if (log_rotate_file(L.path) == 0) {
+        fd = open(L.path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    }
+    if (fd < 0) {
+        // Keep writing to the old file rather than losing messages
+        log_rotation_start(&L.rotation, L.rotation.size);
+        return;
+    }
+    close(L.fd);
+    L.fd = fd;
+    log_rotation_start(&L.rotation, 0);
+}
+
+static void write_batch(const char *batch, size_t len) {
+    maybe_rotate(len);
+    write_all(L.fd, batch, len);
+    L.rotation.size += len;
+}
+
+static bool ring_has_data(void) {
+    log_record *rec = &L.ring[L.dequeue_pos & (LOG_RING_SIZE - 1)];
+    return __atomic_load_n(&rec->sequence, __ATOMIC_ACQUIRE) == L.dequeue_pos + 1;
+}
+
+// Drains everything published so far into as few write() calls as possible
+static void drain_ring(char *batch) {
+    static uint64_t reported_drops = 0;
+    size_t used = 0;
+
+    uint64_t dropped = __atomic_load_n(&L.dropped, __ATOMIC_RELAXED);
+    if (dropped != reported_drops) {
+        char stamp[32];
+        format_timestamp(time(NULL), stamp, sizeof(stamp));
+        used += (size_t)snprintf(batch, LOG_BATCH_SIZE, "%s [WARN ] logger ring full, dropped %llu messages\n",
+                                 stamp, (unsigned long long)(dropped - reported_drops));
+        reported_drops = dropped;
+    }
+
+    while (ring_has_data()) {
+        log_record *rec = &L.ring[L.dequeue_pos & (LOG_RING_SIZE - 1)];
+        if (LOG_BATCH_SIZE - used < LOG_MESSAGE_LEN + 128) {
+            write_batch(batch, used);
+            used = 0;
+        }
+        used += format_record(rec, batch + used, LOG_BATCH_SIZE - used);
+        __atomic_store_n(&rec->sequence, L.dequeue_pos + LOG_RING_SIZE, __ATOMIC_RELEASE);
+        __atomic_store_n(&L.dequeue_pos, L.dequeue_pos + 1, __ATOMIC_RELEASE);
+    }
+
+    if (used > 0) {
+        write_batch(batch, used);
+    } else {
+        maybe_rotate(0);
+    }
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    char *batch = malloc(LOG_BATCH_SIZE);
+    if (batch == NULL) {
+        return NULL;
+    }
+
+    while (true) {
+        drain_ring(batch);
+
+        pthread_mutex_lock(&L.mutex);
+        __atomic_store_n(&L.writer_waiting, 1, __ATOMIC_SEQ_CST);
+        if (!ring_has_data() && L.writer_running) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += LOG_WRITER_IDLE_MS * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&L.wakeup, &L.mutex, &deadline);
+        }
+        __atomic_store_n(&L.writer_waiting, 0, __ATOMIC_SEQ_CST);
+        bool running = L.writer_running;
+        pthread_mutex_unlock(&L.mutex);
+
+        if (!running) {
+            drain_ring(batch);
+            break;
+        }
+    }
+
+    free(batch);
+    return NULL;
+}
+
+static void wake_writer(void) {
+    if (__atomic_load_n(&L.writer_waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&L.mutex);
+        pthread_cond_signal(&L.wakeup);
+        pthread_mutex_unlock(&L.mutex);
+    }
+}
+
+/* ---------- producers ---------- */
+
+// Claims a free slot. Returns NULL if the ring is full and the policy is drop.
+static log_record *ring_claim(uint64_t *pos_out) {
+    uint64_t pos = __atomic_load_n(&L.enqueue_pos, __ATOMIC_RELAXED);
+    while (true) {
+        log_record *rec = &L.ring[pos & (LOG_RING_SIZE - 1)];
+        uint64_t seq = __atomic_load_n(&rec->sequence, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&L.enqueue_pos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *pos_out = pos;
+                return rec;
+            }
+        } else if (diff < 0) {
+            // Full: the writer has not released this slot yet
+            if (L.policy == LOG_OVERFLOW_DROP) {
+                __atomic_add_fetch(&L.dropped, 1, __ATOMIC_RELAXED);
+                return NULL;
+            }
+            wake_writer();
+            sched_yield();
+            pos = __atomic_load_n(&L.enqueue_pos, __ATOMIC_RELAXED);
+        } else {
+            pos = __atomic_load_n(&L.enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static void ring_publish(log_record *rec, uint64_t pos) {
+    __atomic_store_n(&rec->sequence, pos + 1, __ATOMIC_SEQ_CST);
+    wake_writer();
+}
+
+static void enqueue_record(int level, int saved_errno, const char *fmt, va_list args) {
+    uint64_t pos;
+    log_record *rec = ring_claim(&pos);
+    if (rec == NULL) {
+        return;
+    }
+    rec->timestamp = time(NULL);
+    rec->level = level;
+    rec->saved_errno = saved_errno;
+    vsnprintf(rec->message, sizeof(rec->message), fmt, args);
+    ring_publish(rec, pos);
+}
+
+static void enqueue_formatted(int level, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    enqueue_record(level, 0, fmt, args);
+    va_end(args);
+}
+
+// A producer announces itself before looking at `async', so logger_close can
+// clear the flag and then wait until nobody still holds the ring it frees
+static bool enter_async(void) {
+    __atomic_add_fetch(&L.producers, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&L.async, __ATOMIC_SEQ_CST)) {
+        return true;
+    }
+    __atomic_sub_fetch(&L.producers, 1, __ATOMIC_RELEASE);
+    return false;
+}
+
+static void leave_async(void) {
+    __atomic_sub_fetch(&L.producers, 1, __ATOMIC_RELEASE);
+}
+
+/* ---------- public API ---------- */
+
+static bool start_async(const char *filename) {
+    L.fd = open(filename, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (L.fd < 0) {
+        return false;
+    }
+    struct stat st;
+    strncpy(L.path, filename, sizeof(L.path) - 1);
+    log_rotation_start(&L.rotation, fstat(L.fd, &st) == 0 ? (uint64_t)st.st_size : 0);
+    L.ring = calloc(LOG_RING_SIZE, sizeof(log_record));
+    if (L.ring == NULL) {
+        close(L.fd);
+        L.fd = -1;
+        return false;
+    }
+    for (uint64_t i = 0; i < LOG_RING_SIZE; i++) {
+        L.ring[i].sequence = i;
+    }
+    L.enqueue_pos = 0;
+    L.dequeue_pos = 0;
+    L.writer_running = true;
+    // Signals belong to the event loop: the writer starts with all of them blocked
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    int created = pthread_create(&L.writer, NULL, writer_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (created != 0) {
+        free(L.ring);
+        L.ring = NULL;
+        close(L.fd);
+        L.fd = -1;
+        L.writer_running = false;
+        return false;
+    }
+    return true;
+}
+
 void logger_init(log_level level, const char *filename) {
     pthread_mutex_lock(&L.mutex);
-    if (L.file == NULL) {
+    if (L.file == NULL && !L.async) {
         if (filename != NULL) {
-            L.file = fopen(filename, "a");
-            if (L.file == NULL) {
+            if (start_async(filename)) {
+                __atomic_store_n(&L.async, true, __ATOMIC_RELEASE);
+            } else {
                 perror("[LOGGER] Failed to open log file, using stderr");
                 L.file = stderr;
             }
@@ -33,17 +349,135 @@ void logger_init(log_level level, const char *filename) {
             L.file = stderr;
         }
     }
-    L.level = level;
+    __atomic_store_n(&logger_runtime_level, (int)level, __ATOMIC_RELAXED);
     pthread_mutex_unlock(&L.mutex);
 }
 
 void logger_set_level(log_level level) {
+    __atomic_store_n(&logger_runtime_level, (int)level, __ATOMIC_RELAXED);
+}
+
+void logger_set_overflow_policy(log_overflow_policy policy) {
+    L.policy = policy;
+}
+
+unsigned long long logger_dropped_count(void) {
+    return (unsigned long long)__atomic_load_n(&L.dropped, __ATOMIC_RELAXED);
+}
+
+void logger_flush(void) {
+    if (!__atomic_load_n(&L.async, __ATOMIC_ACQUIRE)) {
+        pthread_mutex_lock(&L.mutex);
+        if (L.file != NULL) fflush(L.file);
+        pthread_mutex_unlock(&L.mutex);
+        return;
+    }
+
+    uint64_t target = __atomic_load_n(&L.enqueue_pos, __ATOMIC_ACQUIRE);
+    struct timespec pause = {0, 1000000L};
+    for (int waited = 0; waited < LOG_FLUSH_TIMEOUT_MS; waited++) {
+        if (__atomic_load_n(&L.dequeue_pos, __ATOMIC_ACQUIRE) >= target) {
+            return;
+        }
+        pthread_mutex_lock(&L.mutex);
+        pthread_cond_signal(&L.wakeup);
+        pthread_mutex_unlock(&L.mutex);
+        nanosleep(&pause, NULL);
+    }
+}
+
+/* ---------- rate limiting ---------- */
+
+// Guards every limiter and the list of call sites that have suppressed
+// something. Only taken when a limited call site is reached.
+static pthread_mutex_t limit_mutex = PTHREAD_MUTEX_INITIALIZER;
+static log_limiter *limiters = NULL;
+
+static uint64_t coarse_millis(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+// WARN rather than the call site's level: an ERROR line would append errno
+static void report_suppressed_locked(log_limiter *limiter) {
+    if (limiter->suppressed == 0) return;
+    int saved_errno = errno;
+    logger_log(LOG_WARN, "%s: suppressed %u similar messages", limiter->site, limiter->suppressed);
+    limiter->suppressed = 0;
+    errno = saved_errno;
+}
+
+bool logger_limit_allow(log_limiter *limiter) {
+    uint64_t now = coarse_millis();
+    pthread_mutex_lock(&limit_mutex);
+    if (limiter->last_refill_ms == 0) {
+        limiter->millitokens = LOG_LIMIT_BURST * 1000;
+    } else {
+        uint64_t refill = (now - limiter->last_refill_ms) * LOG_LIMIT_PER_SEC;
+        uint64_t tokens = limiter->millitokens + refill;
+        limiter->millitokens = tokens > LOG_LIMIT_BURST * 1000 ? LOG_LIMIT_BURST * 1000 : (uint32_t)tokens;
+    }
+    limiter->last_refill_ms = now;
+
+    bool allowed = limiter->millitokens >= 1000;
+    if (allowed) {
+        limiter->millitokens -= 1000;
+        report_suppressed_locked(limiter);
+    } else {
+        limiter->suppressed++;
+        if (!limiter->registered) {
+            limiter->registered = true;
+            limiter->next = limiters;
+            limiters = limiter;
+        }
+    }
+    pthread_mutex_unlock(&limit_mutex);
+    return allowed;
+}
+
+void logger_report_suppressed(void) {
+    pthread_mutex_lock(&limit_mutex);
+    for (log_limiter *limiter = limiters; limiter != NULL; limiter = limiter->next) {
+        report_suppressed_locked(limiter);
+    }
+    pthread_mutex_unlock(&limit_mutex);
+}
+
+unsigned logger_request_rotation(void) {
+    unsigned generation = log_rotation_request();
     pthread_mutex_lock(&L.mutex);
-    L.level = level;
+    pthread_cond_signal(&L.wakeup);
     pthread_mutex_unlock(&L.mutex);
+    return generation;
 }
 
 void logger_close(void) {
+    pthread_mutex_lock(&L.mutex);
+    bool async = L.async;
+    // From here on new messages take the synchronous path (stderr)
+    __atomic_store_n(&L.async, false, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&L.mutex);
+
+    if (async) {
+        // Threads still inside logger_log may be filling a slot; the writer
+        // keeps running so a blocked producer can finish
+        while (__atomic_load_n(&L.producers, __ATOMIC_SEQ_CST) > 0) {
+            sched_yield();
+        }
+        pthread_mutex_lock(&L.mutex);
+        L.writer_running = false;
+        pthread_cond_signal(&L.wakeup);
+        pthread_mutex_unlock(&L.mutex);
+
+        // The writer drains the ring before exiting
+        pthread_join(L.writer, NULL);
+        close(L.fd);
+        L.fd = -1;
+        free(L.ring);
+        L.ring = NULL;
+    }
+
     pthread_mutex_lock(&L.mutex);
     if (L.file != NULL && L.file != stderr) {
         fclose(L.file);
@@ -53,7 +487,20 @@ void logger_close(void) {
 }
 
 void logger_log(log_level level, const char *fmt, ...) {
-    if (level < L.level) {
+    if (!logger_enabled(level)) {
+        return;
+    }
+    int saved_errno = errno;
+
+    if (enter_async()) {
+        va_list args;
+        va_start(args, fmt);
+        enqueue_record(level, saved_errno, fmt, args);
+        va_end(args);
+        if (level == LOG_FATAL) {
+            logger_flush();
+        }
+        leave_async();
         return;
     }
 
@@ -65,11 +512,8 @@ void logger_log(log_level level, const char *fmt, ...) {
     }
 
     // Timestamp
-    time_t now = time(NULL);
-    struct tm tm_now;
-    localtime_r(&now, &tm_now);
     char timestamp[32];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &tm_now);
+    format_timestamp(time(NULL), timestamp, sizeof(timestamp));
 
     // Message buffer
     char msg_buf[1024];
@@ -81,7 +525,7 @@ void logger_log(log_level level, const char *fmt, ...) {
     // Print to log file
     if (level >= LOG_ERROR) {
         fprintf(L.file, "%s [%-5s] %s (errno: %s)\n",
-                timestamp, level_strings[level], msg_buf, strerror(errno));
+                timestamp, level_strings[level], msg_buf, strerror(saved_errno));
     } else {
         fprintf(L.file, "%s [%-5s] %s\n",
                 timestamp, level_strings[level], msg_buf);
@@ -93,6 +537,20 @@ void logger_log(log_level level, const char *fmt, ...) {
 
 
 void log_access(const char *user, const char *status, const char *details_fmt, ...) {
+    // Details buffer
+    char details_buf[512];
+    va_list args;
+    va_start(args, details_fmt);
+    vsnprintf(details_buf, sizeof(details_buf), details_fmt, args);
+    va_end(args);
+
+    if (enter_async()) {
+        enqueue_formatted(LOG_LEVEL_ACCESS, "user='%s' status='%s' details='%s'",
+                          user ? user : "anonymous", status ? status : "N/A", details_buf);
+        leave_async();
+        return;
+    }
+
     pthread_mutex_lock(&L.mutex);
 
     if (L.file == NULL) {
@@ -100,18 +558,8 @@ void log_access(const char *user, const char *status, const char *details_fmt, .
     }
 
     // Timestamp
-    time_t now = time(NULL);
-    struct tm tm_now;
-    localtime_r(&now, &tm_now);
     char timestamp[32];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &tm_now);
-
-    // Details buffer
-    char details_buf[512];
-    va_list args;
-    va_start(args, details_fmt);
-    vsnprintf(details_buf, sizeof(details_buf), details_fmt, args);
-    va_end(args);
+    format_timestamp(time(NULL), timestamp, sizeof(timestamp));
 
     // Print to log file
     fprintf(L.file, "%s [ACCESS] user='%s' status='%s' details='%s'\n",
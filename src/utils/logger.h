@@ -3,9 +3,19 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 /*
  * Improved, thread-safe logger interface with severity levels.
+ *
+ * When logging to a file the logger is asynchronous: producers format the
+ * message into a slot of a bounded lock-free MPSC ring and return, and a
+ * background writer thread drains the ring in batches with large write()
+ * calls. When the ring is full the overflow policy decides whether the
+ * producer drops the message (counted in logger_dropped_count()) or waits
+ * for room. FATAL messages and logger_close() flush the ring before
+ * returning. Logging to stderr (the management client) stays synchronous.
  */
 
 // Definition of log levels
@@ -19,6 +29,29 @@ typedef enum {
 
 #define LOG_DEFAULT_LEVEL LOG_INFO
 
+/*
+ * Minimum level compiled into the binary, as a number (0 = DEBUG ... 4 = FATAL)
+ * because the preprocessor cannot compare enum values. Call sites below it
+ * expand to dead code: neither the call nor its arguments are evaluated.
+ * Set it from make, e.g. `make clean all LOG_COMPILE_LEVEL=1`.
+ */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 0
+#endif
+
+/* Runtime minimum level. Read before any formatting is done. */
+extern int logger_runtime_level;
+
+static inline bool logger_enabled(log_level level) {
+    return (int)level >= __atomic_load_n(&logger_runtime_level, __ATOMIC_RELAXED);
+}
+
+// What a producer does when the ring is full
+typedef enum {
+    LOG_OVERFLOW_DROP,   // discard the message and count it (default)
+    LOG_OVERFLOW_BLOCK,  // wait until the writer frees a slot
+} log_overflow_policy;
+
 /*
  * Initializes the logger.
  *  - level: Minimum log level to be recorded.
@@ -29,7 +62,23 @@ void logger_init(log_level level, const char *filename);
 /* Changes the log level at runtime. */
 void logger_set_level(log_level level);
 
-/* Closes the log file. Must be called at application shutdown. */
+/* Changes the overflow policy of the asynchronous ring. */
+void logger_set_overflow_policy(log_overflow_policy policy);
+
+/* Number of messages dropped because the ring was full. */
+unsigned long long logger_dropped_count(void);
+
+/* Waits until every message logged so far has been written. */
+void logger_flush(void);
+
+/*
+ * Asks every log file to rotate (see log_rotate.h) and wakes the writer so
+ * metrics.log rotates right away instead of at its next idle poll. Returns the
+ * new rotation generation.
+ */
+unsigned logger_request_rotation(void);
+
+/* Flushes and closes the log file. Must be called at application shutdown. */
 void logger_close(void);
 
 /*
@@ -49,12 +98,71 @@ void logger_log(log_level level, const char *fmt, ...);
 void log_access(const char *user, const char *status, const char *details_fmt, ...);
 
 
-/* Macros to facilitate logging */
-#define log_debug(...) logger_log(LOG_DEBUG, __VA_ARGS__)
-#define log_info(...)  logger_log(LOG_INFO,  __VA_ARGS__)
-#define log_warn(...)  logger_log(LOG_WARN,  __VA_ARGS__)
-#define log_error(...) logger_log(LOG_ERROR, __VA_ARGS__)
+/*
+ * Macros to facilitate logging. They check the compile-time and runtime
+ * levels before calling into the logger, so a disabled message costs one
+ * load and one compare.
+ */
+#define LOG_AT(level, ...)                                                  \
+    do {                                                                    \
+        if ((int)(level) >= LOG_COMPILE_LEVEL && logger_enabled(level)) {   \
+            logger_log((level), __VA_ARGS__);                               \
+        }                                                                   \
+    } while (0)
+
+#define log_debug(...) LOG_AT(LOG_DEBUG, __VA_ARGS__)
+#define log_info(...)  LOG_AT(LOG_INFO,  __VA_ARGS__)
+#define log_warn(...)  LOG_AT(LOG_WARN,  __VA_ARGS__)
+#define log_error(...) LOG_AT(LOG_ERROR, __VA_ARGS__)
 #define log_fatal(...) logger_log(LOG_FATAL, __VA_ARGS__)
 
+/*
+ * Rate-limited logging for call sites that can fire once per failing
+ * connection (resolve/connect/relay errors). Each call site owns a token
+ * bucket: LOG_LIMIT_BURST messages pass right away, then LOG_LIMIT_PER_SEC per
+ * second. Messages over the limit are only counted: their arguments (including
+ * any strerror() call) are never evaluated. The next message that passes
+ * reports how many were suppressed, and logger_report_suppressed() reports
+ * the counts of call sites that went quiet.
+ */
+#define LOG_LIMIT_BURST 10
+#define LOG_LIMIT_PER_SEC 2
+
+typedef struct log_limiter {
+    const char *site;               // "file:line"
+    uint64_t last_refill_ms;
+    uint32_t millitokens;           // 1000 = one message
+    uint32_t suppressed;
+    bool registered;
+    struct log_limiter *next;
+} log_limiter;
+
+/* Takes a token from the call site's bucket. Returns false if it has none. */
+bool logger_limit_allow(log_limiter *limiter);
+
+/*
+ * Writes a "suppressed N similar messages" line for each call site with
+ * pending suppressions. The server calls it from its 1 second tick.
+ */
+void logger_report_suppressed(void);
+
+#define LOG_STRINGIFY_(x) #x
+#define LOG_STRINGIFY(x) LOG_STRINGIFY_(x)
+
+#define LOG_LIMITED(level, ...)                                             \
+    do {                                                                    \
+        if ((int)(level) >= LOG_COMPILE_LEVEL && logger_enabled(level)) {   \
+            static log_limiter log_site_limiter_ = {                        \
+                .site = __FILE__ ":" LOG_STRINGIFY(__LINE__),               \
+            };                                                              \
+            if (logger_limit_allow(&log_site_limiter_)) {                   \
+                logger_log((level), __VA_ARGS__);                           \
+            }                                                               \
+        }                                                                   \
+    } while (0)
+
+#define log_warn_limited(...)  LOG_LIMITED(LOG_WARN,  __VA_ARGS__)
+#define log_error_limited(...) LOG_LIMITED(LOG_ERROR, __VA_ARGS__)
+
 
 #endif // LOGGER_H
@@ -0,0 +1,112 @@
+#include "loop_profiler.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "seqlock.h"
+#include "util.h"
+
+#define INTERVAL_NS 1000000000ull
+#define ALPHA_60S 0.0165285461783838   // 1 - e^(-1/60), un intervalo de 1s
+
+static const char *handler_names[] = {
+    "accept", "handshake", "relay", "flush", "management", "timer"
+};
+
+// Estado privado del loop
+static loop_stats_t current;
+static uint64_t busy_since_ns = 0;
+static uint64_t wait_since_ns = 0;
+static uint64_t interval_start_ns = 0;
+static uint64_t interval_busy_ns = 0;
+static uint64_t interval_wait_ns = 0;
+
+// Copia publicada para los lectores
+static seqlock_t published_lock = SEQLOCK_INITIALIZER;
+static loop_stats_t published;
+
+const char *loop_handler_name(loop_handler_t handler) {
+    if ((unsigned)handler >= LOOP_HANDLER_COUNT) {
+        return "unknown";
+    }
+    return handler_names[handler];
+}
+
+static void close_interval(uint64_t now_ns) {
+    uint64_t total = interval_busy_ns + interval_wait_ns;
+    current.utilization = total > 0 ? (double)interval_busy_ns / (double)total : 0.0;
+    current.utilization_60s += ALPHA_60S * (current.utilization - current.utilization_60s);
+    interval_busy_ns = 0;
+    interval_wait_ns = 0;
+    interval_start_ns = now_ns;
+}
+
+void loop_profiler_before_wait(void) {
+    uint64_t now = monotonicNanos();
+    if (busy_since_ns != 0) {
+        uint64_t busy = now - busy_since_ns;
+        current.busy_ns += busy;
+        interval_busy_ns += busy;
+    }
+    bool interval_done = false;
+    if (interval_start_ns == 0) {
+        interval_start_ns = now;
+    } else if (now - interval_start_ns >= INTERVAL_NS) {
+        close_interval(now);
+        interval_done = true;
+    }
+
+    seqlock_write_begin(&published_lock);
+    published = current;
+    seqlock_write_end(&published_lock);
+
+    if (interval_done) {
+        current.interval_max_handler_ns = 0;
+    }
+    wait_since_ns = now;
+}
+
+void loop_profiler_after_wait(int ready_events) {
+    uint64_t now = monotonicNanos();
+    if (wait_since_ns != 0) {
+        uint64_t waited = now - wait_since_ns;
+        current.wait_ns += waited;
+        interval_wait_ns += waited;
+    }
+    busy_since_ns = now;
+    if (ready_events > 0) {
+        current.wakeups++;
+        current.ready_events += (uint64_t)ready_events;
+        if ((uint32_t)ready_events > current.max_ready_events) {
+            current.max_ready_events = (uint32_t)ready_events;
+        }
+    }
+}
+
+uint64_t loop_profiler_handler_start(void) {
+    return monotonicNanos();
+}
+
+void loop_profiler_handler_end(loop_handler_t handler, uint64_t start_ns) {
+    if ((unsigned)handler >= LOOP_HANDLER_COUNT) {
+        return;
+    }
+    uint64_t elapsed = monotonicNanos() - start_ns;
+    current.handler_ns[handler] += elapsed;
+    current.handler_calls[handler]++;
+    if (elapsed > current.interval_max_handler_ns) {
+        current.interval_max_handler_ns = elapsed;
+    }
+    if (elapsed > current.max_handler_ns) {
+        current.max_handler_ns = elapsed;
+        current.max_handler_class = (int32_t)handler;
+    }
+}
+
+void loop_profiler_snapshot(loop_stats_t *out) {
+    uint32_t seq;
+    do {
+        seq = seqlock_read_begin(&published_lock);
+        memcpy(out, &published, sizeof(*out));
+    } while (seqlock_read_retry(&published_lock, seq));
+}
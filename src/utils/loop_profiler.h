@@ -0,0 +1,55 @@
+#ifndef LOOP_PROFILER_H_Hv2qM8dXs5RnKc1ZwLb7TyPa
+#define LOOP_PROFILER_H_Hv2qM8dXs5RnKc1ZwLb7TyPa
+
+#include <stdint.h>
+
+/**
+ * loop_profiler.c - contadores de autoperfilado del loop de eventos.
+ *
+ * El loop marca con el reloj monotónico cuándo se bloquea en select() y
+ * cuándo vuelve, y cronometra cada handler según su clase. Con eso se sabe
+ * qué fracción del tiempo está ocupado (utilización), en qué, cuántos eventos
+ * trae cada despertar y cuál fue el handler más largo.
+ *
+ * Los acumuladores son privados del loop; se publican una vez por vuelta bajo
+ * un seqlock para que management los lea sin frenarlo.
+ */
+
+typedef enum {
+    LOOP_HANDLER_ACCEPT,
+    LOOP_HANDLER_HANDSHAKE,
+    LOOP_HANDLER_RELAY,
+    LOOP_HANDLER_FLUSH,
+    LOOP_HANDLER_MGMT,
+    LOOP_HANDLER_TIMER,
+    LOOP_HANDLER_COUNT
+} loop_handler_t;
+
+typedef struct {
+    uint64_t wakeups;                   // vueltas que salieron de select()
+    uint64_t ready_events;              // descriptores listos acumulados
+    uint32_t max_ready_events;          // máximo en un solo despertar
+    int32_t  max_handler_class;         // loop_handler_t del handler más largo
+    uint64_t wait_ns;                   // tiempo bloqueado en select()
+    uint64_t busy_ns;                   // tiempo fuera de select()
+    uint64_t handler_ns[LOOP_HANDLER_COUNT];
+    uint64_t handler_calls[LOOP_HANDLER_COUNT];
+    uint64_t max_handler_ns;            // handler más largo desde el arranque
+    uint64_t interval_max_handler_ns;   // handler más largo del último segundo
+    double   utilization;               // busy / (busy + wait), último segundo
+    double   utilization_60s;           // promedio exponencial de 60s
+} loop_stats_t;
+
+/** Nombre legible de una clase de handler */
+const char *loop_handler_name(loop_handler_t handler);
+
+/* Solo desde el loop de eventos */
+void loop_profiler_before_wait(void);
+void loop_profiler_after_wait(int ready_events);
+uint64_t loop_profiler_handler_start(void);
+void loop_profiler_handler_end(loop_handler_t handler, uint64_t start_ns);
+
+/** Copia consistente de los contadores, desde cualquier hilo */
+void loop_profiler_snapshot(loop_stats_t *out);
+
+#endif
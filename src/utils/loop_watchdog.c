@@ -0,0 +1,141 @@
+#include "loop_watchdog.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "logger.h"
+#include "util.h"
+
+// Lo escribe el loop, lo lee el watchdog
+static struct {
+    uint64_t iteration;
+    uint32_t waiting;
+    int32_t handler;
+    uint64_t connection_id;
+} beat = { .handler = -1 };
+
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static loop_watchdog_stats_t stats = { .last_handler = -1 };
+static uint64_t last_stall_mark_ms = 0;
+
+static pthread_t thread;
+static bool running = false;
+
+void loop_watchdog_busy(void) {
+    __atomic_store_n(&beat.iteration, beat.iteration + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&beat.waiting, 0, __ATOMIC_RELAXED);
+}
+
+void loop_watchdog_idle(void) {
+    __atomic_store_n(&beat.waiting, 1, __ATOMIC_RELAXED);
+}
+
+void loop_watchdog_enter(loop_handler_t handler, uint64_t connection_id) {
+    __atomic_store_n(&beat.handler, (int32_t)handler, __ATOMIC_RELAXED);
+    __atomic_store_n(&beat.connection_id, connection_id, __ATOMIC_RELAXED);
+}
+
+static void sleep_ms(uint32_t ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+// Extiende el bloqueo en curso hasta `elapsed_ns'. Con stats_mutex tomado.
+static void account_stall(uint64_t elapsed_ns, uint64_t now_ms) {
+    if (elapsed_ns > stats.last_stall_ns) {
+        stats.stall_ns_total += elapsed_ns - stats.last_stall_ns;
+        stats.last_stall_ns = elapsed_ns;
+    }
+    if (elapsed_ns > stats.max_stall_ns) stats.max_stall_ns = elapsed_ns;
+    last_stall_mark_ms = now_ms;
+}
+
+static void *watchdog_main(void *arg) {
+    (void)arg;
+    uint32_t threshold_ms = stats.threshold_ms;
+    uint32_t period_ms = threshold_ms / 4 > 0 ? threshold_ms / 4 : 1;
+    uint64_t observed_iteration = 0;
+    uint64_t observed_since_ms = monotonicMillis();
+    bool stalled = false;
+    int32_t stall_handler = -1;
+    uint64_t stall_connection = 0;
+
+    while (__atomic_load_n(&running, __ATOMIC_RELAXED)) {
+        sleep_ms(period_ms);
+        uint64_t now_ms = monotonicMillis();
+        uint64_t iteration = __atomic_load_n(&beat.iteration, __ATOMIC_RELAXED);
+        bool waiting = __atomic_load_n(&beat.waiting, __ATOMIC_RELAXED) != 0;
+        uint64_t elapsed_ms = now_ms - observed_since_ms;
+
+        if (waiting || iteration != observed_iteration) {
+            if (stalled) {
+                stalled = false;
+                pthread_mutex_lock(&stats_mutex);
+                account_stall(elapsed_ms * 1000000ull, now_ms);
+                stats.stalled_now = 0;
+                pthread_mutex_unlock(&stats_mutex);
+                log_warn("Event loop recovered after %llu ms blocked in %s handler (connection %llu)",
+                         (unsigned long long)elapsed_ms, loop_handler_name((loop_handler_t)stall_handler),
+                         (unsigned long long)stall_connection);
+            }
+            observed_iteration = iteration;
+            observed_since_ms = now_ms;
+            continue;
+        }
+        if (elapsed_ms < threshold_ms) continue;
+
+        pthread_mutex_lock(&stats_mutex);
+        if (!stalled) {
+            stall_handler = __atomic_load_n(&beat.handler, __ATOMIC_RELAXED);
+            stall_connection = __atomic_load_n(&beat.connection_id, __ATOMIC_RELAXED);
+            stats.stalls++;
+            stats.stalled_now = 1;
+            stats.last_handler = stall_handler;
+            stats.last_connection_id = stall_connection;
+            stats.last_stall_ns = 0;
+        }
+        account_stall(elapsed_ms * 1000000ull, now_ms);
+        pthread_mutex_unlock(&stats_mutex);
+
+        if (!stalled) {
+            stalled = true;
+            log_warn("Event loop stalled: %llu ms in %s handler (connection %llu)",
+                     (unsigned long long)elapsed_ms, loop_handler_name((loop_handler_t)stall_handler),
+                     (unsigned long long)stall_connection);
+        }
+    }
+    return NULL;
+}
+
+int loop_watchdog_start(uint32_t threshold_ms) {
+    if (threshold_ms == 0 || running) return 0;
+    stats.threshold_ms = threshold_ms;
+    running = true;
+    // Las señales las atiende el loop: el hilo nace con todas bloqueadas
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    int created = pthread_create(&thread, NULL, watchdog_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (created != 0) {
+        running = false;
+        return -1;
+    }
+    return 0;
+}
+
+void loop_watchdog_stop(void) {
+    if (!running) return;
+    __atomic_store_n(&running, false, __ATOMIC_RELAXED);
+    pthread_join(thread, NULL);
+}
+
+void loop_watchdog_snapshot(loop_watchdog_stats_t *out) {
+    pthread_mutex_lock(&stats_mutex);
+    *out = stats;
+    pthread_mutex_unlock(&stats_mutex);
+    out->last_stall_ago_ms = last_stall_mark_ms != 0 ? monotonicMillis() - last_stall_mark_ms : 0;
+}
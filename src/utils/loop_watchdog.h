@@ -0,0 +1,47 @@
+#ifndef LOOP_WATCHDOG_H_Pz6kR3tWm9XcLq2VnHb8JsYd
+#define LOOP_WATCHDOG_H_Pz6kR3tWm9XcLq2VnHb8JsYd
+
+#include <stdint.h>
+
+#include "loop_profiler.h"
+
+/**
+ * loop_watchdog.c - detector de bloqueos del loop de eventos.
+ *
+ * El loop solo hace stores relajados: cuenta vueltas al salir de select(),
+ * marca cuándo vuelve a esperar y anota qué handler y qué conexión está
+ * atendiendo. Un hilo aparte lo muestrea cada umbral/4: si el loop está
+ * ocupado y la vuelta no cambió desde hace más del umbral, es un bloqueo.
+ * Se loguea una vez al detectarlo y otra al recuperarse, con su duración.
+ *
+ * La duración se mide entre muestras del watchdog, así que su resolución es
+ * un período de muestreo.
+ */
+
+#define LOOP_WATCHDOG_DEFAULT_MS 200
+
+typedef struct {
+    uint32_t threshold_ms;              // 0 = deshabilitado
+    uint32_t stalled_now;               // 1 si el loop está bloqueado ahora
+    uint64_t stalls;                    // bloqueos detectados
+    uint64_t stall_ns_total;
+    uint64_t max_stall_ns;
+    uint64_t last_stall_ns;
+    uint64_t last_stall_ago_ms;         // desde que terminó (o empezó, si sigue)
+    int32_t  last_handler;              // loop_handler_t, -1 si no hubo
+    uint32_t reserved;
+    uint64_t last_connection_id;        // 0 si el handler no era de una conexión
+} loop_watchdog_stats_t;
+
+/** Arranca el hilo. threshold_ms == 0 no lo arranca. */
+int loop_watchdog_start(uint32_t threshold_ms);
+void loop_watchdog_stop(void);
+
+/* Marcas del loop */
+void loop_watchdog_busy(void);                  // salió de select()
+void loop_watchdog_idle(void);                  // va a entrar a select()
+void loop_watchdog_enter(loop_handler_t handler, uint64_t connection_id);
+
+void loop_watchdog_snapshot(loop_watchdog_stats_t *out);
+
+#endif
@@ -0,0 +1,56 @@
+#include "password_hash.h"
+
+#include <crypt.h>
+#include <errno.h>
+#include <string.h>
+
+int password_hash_make(const char *password, char *out, size_t len) {
+    char setting[CRYPT_GENSALT_OUTPUT_SIZE];
+    // Sin bytes propios: libcrypt saca la sal de getentropy()
+    if (crypt_gensalt_rn(PASSWORD_HASH_PREFIX, PASSWORD_HASH_COST, NULL, 0, setting, sizeof(setting)) == NULL) {
+        return -1;
+    }
+
+    struct crypt_data data;     // ~32 KiB, en la pila de quien llama
+    data.initialized = 0;
+    const char *hash = crypt_rn(password, setting, &data, sizeof(data));
+    int result = -1;
+    if (hash == NULL) {
+        // errno ya quedó puesto
+    } else if (strlen(hash) >= len) {
+        errno = ERANGE;
+    } else {
+        strcpy(out, hash);
+        result = 0;
+    }
+    // crypt_data guarda una copia de la clave
+    explicit_bzero(&data, sizeof(data));
+    return result;
+}
+
+bool password_hash_verify(const char *password, const char *hash) {
+    struct crypt_data data;
+    data.initialized = 0;
+    const char *computed = crypt_rn(password, hash, &data, sizeof(data));
+    bool equal = false;
+    if (computed != NULL) {
+        size_t len = strlen(hash);
+        if (strlen(computed) == len) {
+            unsigned char diff = 0;
+            for (size_t i = 0; i < len; i++) {
+                diff |= (unsigned char)(computed[i] ^ hash[i]);
+            }
+            equal = diff == 0;
+        }
+    }
+    explicit_bzero(&data, sizeof(data));
+    return equal;
+}
+
+bool password_hash_is_hash(const char *stored) {
+    // Sin el '$' inicial crypt_checksalt aceptaría casi cualquier cosa como
+    // sal de DES
+    if (stored[0] != '$') return false;
+    int status = crypt_checksalt(stored);
+    return status == CRYPT_SALT_OK || status == CRYPT_SALT_METHOD_LEGACY || status == CRYPT_SALT_TOO_CHEAP;
+}
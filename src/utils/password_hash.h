@@ -0,0 +1,36 @@
+#ifndef PASSWORD_HASH_H_Vb6nQx2LkT9wRz4MhPc1JdSg
+#define PASSWORD_HASH_H_Vb6nQx2LkT9wRz4MhPc1JdSg
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * password_hash.c - claves guardadas como hash de crypt(3) con sal.
+ *
+ * Se genera yescrypt ("$y$", derivado de scrypt, el default de libxcrypt)
+ * con una sal aleatoria por clave. Verificar cuesta lo mismo que generar,
+ * unas decenas de milisegundos a propósito: quien la llame en un camino
+ * caliente tiene que cachear el resultado (auth_cache.h).
+ *
+ * password_hash_verify() acepta cualquier hash que entienda libcrypt, así
+ * que un auth.db con hashes de otra herramienta (mkpasswd, htpasswd -B)
+ * también sirve.
+ */
+
+#define PASSWORD_HASH_PREFIX "$y$"
+#define PASSWORD_HASH_COST 0    // 0 = el default de libcrypt para el prefijo
+#define MAX_PASSWORD_HASH_LEN 128
+
+/** Hash nuevo de `password' en `out'. 0 si pudo, -1 (con errno) si no */
+int password_hash_make(const char *password, char *out, size_t len);
+
+/** true si `password' corresponde a `hash' */
+bool password_hash_verify(const char *password, const char *hash);
+
+/**
+ * true si `stored' tiene forma de hash que libcrypt sabe verificar; si no,
+ * es una clave en texto plano de un auth.db viejo
+ */
+bool password_hash_is_hash(const char *stored);
+
+#endif
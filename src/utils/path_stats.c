@@ -0,0 +1,103 @@
+#include "path_stats.h"
+
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/tcp.h>
+
+#include "seqlock.h"
+
+#define SMOOTHING 0.125
+
+static seqlock_t destinations_lock = SEQLOCK_INITIALIZER;
+static path_destination_t destinations[PATH_STATS_MAX_DESTINATIONS];
+static size_t destination_count = 0;
+
+bool path_stats_sample(int fd, tcp_leg_sample_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (fd < 0) {
+        return false;
+    }
+
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+    memset(&info, 0, sizeof(info));
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) < 0) {
+        return false;
+    }
+
+    out->rtt_us = info.tcpi_rtt;
+    out->rttvar_us = info.tcpi_rttvar;
+    out->snd_cwnd = info.tcpi_snd_cwnd;
+    out->total_retrans = info.tcpi_total_retrans;
+    // Kernels viejos devuelven una tcp_info más corta, sin delivery rate
+    if (len >= offsetof(struct tcp_info, tcpi_delivery_rate) + sizeof(info.tcpi_delivery_rate)) {
+        out->delivery_rate = info.tcpi_delivery_rate;
+    }
+    out->valid = 1;
+    return true;
+}
+
+static double smooth(double current, double value, bool first) {
+    return first ? value : current + SMOOTHING * (value - current);
+}
+
+void path_stats_add(tcp_leg_stats_t *stats, const tcp_leg_sample_t *sample, uint32_t new_retransmits) {
+    if (stats == NULL || sample == NULL || !sample->valid) {
+        return;
+    }
+    bool first = stats->samples == 0;
+    stats->rtt_us = smooth(stats->rtt_us, sample->rtt_us, first);
+    stats->rttvar_us = smooth(stats->rttvar_us, sample->rttvar_us, first);
+    stats->snd_cwnd = smooth(stats->snd_cwnd, sample->snd_cwnd, first);
+    stats->delivery_rate = smooth(stats->delivery_rate, (double)sample->delivery_rate, first);
+    stats->retransmits += new_retransmits;
+    stats->samples++;
+}
+
+static path_destination_t *destination_slot(const char *destination) {
+    path_destination_t *oldest = NULL;
+    for (size_t i = 0; i < destination_count; i++) {
+        if (strcmp(destinations[i].destination, destination) == 0) {
+            return &destinations[i];
+        }
+        if (oldest == NULL || destinations[i].last_sample_ms < oldest->last_sample_ms) {
+            oldest = &destinations[i];
+        }
+    }
+
+    path_destination_t *slot;
+    if (destination_count < PATH_STATS_MAX_DESTINATIONS) {
+        slot = &destinations[destination_count++];
+    } else {
+        slot = oldest;
+    }
+    memset(slot, 0, sizeof(*slot));
+    strncpy(slot->destination, destination, PATH_STATS_DESTINATION_LEN - 1);
+    return slot;
+}
+
+void path_stats_record_destination(const char *destination, const tcp_leg_sample_t *client,
+                                   uint32_t client_retransmits, const tcp_leg_sample_t *remote,
+                                   uint32_t remote_retransmits, uint64_t now_ms) {
+    if (destination == NULL || destination[0] == '\0') {
+        return;
+    }
+    seqlock_write_begin(&destinations_lock);
+    path_destination_t *slot = destination_slot(destination);
+    path_stats_add(&slot->path.client, client, client_retransmits);
+    path_stats_add(&slot->path.remote, remote, remote_retransmits);
+    slot->last_sample_ms = now_ms;
+    seqlock_write_end(&destinations_lock);
+}
+
+size_t path_stats_destinations(path_destination_t *out, size_t max) {
+    size_t count;
+    uint32_t seq;
+    do {
+        seq = seqlock_read_begin(&destinations_lock);
+        count = destination_count < max ? destination_count : max;
+        memcpy(out, destinations, count * sizeof(*out));
+    } while (seqlock_read_retry(&destinations_lock, seq));
+    return count;
+}
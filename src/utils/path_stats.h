@@ -0,0 +1,72 @@
+#ifndef PATH_STATS_H_Tn4wQ7zKc2VbXm9RsLd6HyPe
+#define PATH_STATS_H_Tn4wQ7zKc2VbXm9RsLd6HyPe
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * path_stats.c - muestras de TCP_INFO y su agregación por camino.
+ *
+ * Cada tanto el loop de eventos lee getsockopt(TCP_INFO) de las dos patas de
+ * un subconjunto de conexiones en relay: cliente <-> proxy y proxy <-> destino.
+ * Con RTT, varianza, retransmisiones, ventana de congestión y delivery rate de
+ * cada pata se puede distinguir un usuario lento por su red de un destino
+ * lento o de un proxy saturado.
+ *
+ * Las muestras se suavizan (promedio exponencial con factor 1/8, como el srtt
+ * de TCP) por usuario, por destino y globalmente. La tabla de destinos tiene
+ * tamaño fijo: cuando se llena se recicla el destino muestreado hace más tiempo.
+ */
+
+#define PATH_STATS_MAX_DESTINATIONS 128
+#define PATH_STATS_DESTINATION_LEN 272
+
+// Una lectura de TCP_INFO de un socket
+typedef struct {
+    uint32_t rtt_us;
+    uint32_t rttvar_us;
+    uint32_t snd_cwnd;          // segmentos
+    uint32_t total_retrans;     // acumulado del socket
+    uint64_t delivery_rate;     // bytes/s estimados por el kernel (0 si no hay)
+    uint32_t valid;
+    uint32_t reserved;
+} tcp_leg_sample_t;
+
+// Agregado suavizado de una pata
+typedef struct {
+    uint64_t samples;
+    uint64_t retransmits;       // retransmisiones vistas entre muestras
+    double rtt_us;
+    double rttvar_us;
+    double snd_cwnd;
+    double delivery_rate;
+} tcp_leg_stats_t;
+
+// Agregado de ambas patas de un camino
+typedef struct {
+    tcp_leg_stats_t client;     // cliente <-> proxy
+    tcp_leg_stats_t remote;     // proxy <-> destino
+} tcp_path_stats_t;
+
+typedef struct {
+    char destination[PATH_STATS_DESTINATION_LEN];
+    uint64_t last_sample_ms;    // monotónico
+    tcp_path_stats_t path;
+} path_destination_t;
+
+/** Lee TCP_INFO de `fd'. Retorna false si no es un socket TCP válido. */
+bool path_stats_sample(int fd, tcp_leg_sample_t *out);
+
+/** Suma una muestra (con las retransmisiones nuevas desde la anterior) */
+void path_stats_add(tcp_leg_stats_t *stats, const tcp_leg_sample_t *sample, uint32_t new_retransmits);
+
+/* Tabla por destino: escritura solo desde el loop, lectura desde cualquier hilo */
+void path_stats_record_destination(const char *destination, const tcp_leg_sample_t *client,
+                                   uint32_t client_retransmits, const tcp_leg_sample_t *remote,
+                                   uint32_t remote_retransmits, uint64_t now_ms);
+
+/** Copia hasta `max' destinos a `out'. Retorna la cantidad copiada. */
+size_t path_stats_destinations(path_destination_t *out, size_t max);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef PROBES_H_Lx7dQ2wNv5TkRm9ZcHb4JsPe
+#define PROBES_H_Lx7dQ2wNv5TkRm9ZcHb4JsPe
+
+/**
+ * probes.h - puntos de traza USDT del proxy (proveedor "socks5").
+ *
+ * Con <sys/sdt.h> (systemtap-sdt-dev / systemtap-sdt-devel) cada PROBE es un
+ * nop con una nota ELF que bpftrace o perf pueden enganchar en vivo, sin
+ * recompilar; mientras nadie traza no cuesta más que ese nop y preparar los
+ * argumentos, que por eso son siempre enteros ya calculados. Sin el header,
+ * o con `make NO_PROBES=1`, los PROBE desaparecen del binario.
+ *
+ * Probes (argumentos):
+ *   accept            (connection_id, fd)
+ *   state             (connection_id, estado anterior, estado nuevo)  conn_state_t
+ *   dns_start         (connection_id, host)
+ *   dns_done          (connection_id, status de getaddrinfo)
+ *   connect_start     (connection_id, familia)
+ *   connect_done      (connection_id, 1 conectado / 0 falló, errno)
+ *   relay_in          (connection_id, pata, bytes)     recv(); pata 0 cliente, 1 destino
+ *   relay_out         (connection_id, pata, bytes)     send() hacia esa pata
+ *   flush             (connection_id, pata, bytes enviados, bytes pendientes)
+ *   close             (connection_id, 1 si falló, bytes al destino, bytes al cliente)
+ *
+ * Ejemplos de uso en tools/bpftrace/.
+ */
+
+#if !defined(SOCKS5_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SOCKS5_HAVE_PROBES 1
+#endif
+#endif
+
+#ifdef SOCKS5_HAVE_PROBES
+#define PROBE2(name, a, b)          DTRACE_PROBE2(socks5, name, a, b)
+#define PROBE3(name, a, b, c)       DTRACE_PROBE3(socks5, name, a, b, c)
+#define PROBE4(name, a, b, c, d)    DTRACE_PROBE4(socks5, name, a, b, c, d)
+#else
+#define PROBE2(name, a, b)          do { } while (0)
+#define PROBE3(name, a, b, c)       do { } while (0)
+#define PROBE4(name, a, b, c, d)    do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,56 @@
+#include "rates.h"
+
+/*
+ * Factores de suavizado para un tick de 1 segundo: alpha = 1 - e^(-1/tau).
+ * Precalculados para no depender de libm en el loop.
+ */
+#define ALPHA_1S  0.6321205588285577
+#define ALPHA_10S 0.0951625819640405
+#define ALPHA_60S 0.0165285461783838
+
+#define MAX_CATCHUP_TICKS 600
+
+static void smooth(double *value, double sample, double alpha) {
+    *value += alpha * (sample - *value);
+}
+
+void traffic_rates_tick(traffic_rates_t *rates, uint64_t total_bytes,
+                        uint64_t total_connections, unsigned elapsed_seconds) {
+    if (elapsed_seconds == 0) {
+        return;
+    }
+
+    // Si los contadores se reiniciaron (p. ej. usuario recreado) no hay delta
+    uint64_t bytes = total_bytes >= rates->last_bytes ? total_bytes - rates->last_bytes : 0;
+    uint64_t conns = total_connections >= rates->last_connections ?
+                     total_connections - rates->last_connections : 0;
+    rates->last_bytes = total_bytes;
+    rates->last_connections = total_connections;
+
+    // El delta se reparte de forma pareja entre los segundos transcurridos.
+    // Pasados MAX_CATCHUP_TICKS incluso la ventana de 60s ya convergió.
+    double bytes_per_sec = (double)bytes / elapsed_seconds;
+    double conns_per_sec = (double)conns / elapsed_seconds;
+    unsigned ticks = elapsed_seconds > MAX_CATCHUP_TICKS ? MAX_CATCHUP_TICKS : elapsed_seconds;
+    for (unsigned i = 0; i < ticks; i++) {
+        smooth(&rates->bytes_1s, bytes_per_sec, ALPHA_1S);
+        smooth(&rates->bytes_10s, bytes_per_sec, ALPHA_10S);
+        smooth(&rates->bytes_60s, bytes_per_sec, ALPHA_60S);
+        smooth(&rates->connections_1s, conns_per_sec, ALPHA_1S);
+        smooth(&rates->connections_10s, conns_per_sec, ALPHA_10S);
+        smooth(&rates->connections_60s, conns_per_sec, ALPHA_60S);
+    }
+}
+
+bool traffic_rates_settle(traffic_rates_t *rates) {
+    const double values[] = {
+        rates->bytes_1s, rates->bytes_10s, rates->bytes_60s,
+        rates->connections_1s, rates->connections_10s, rates->connections_60s,
+    };
+    for (unsigned i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        if (values[i] >= RATES_IDLE_EPSILON) return false;
+    }
+    rates->bytes_1s = rates->bytes_10s = rates->bytes_60s = 0;
+    rates->connections_1s = rates->connections_10s = rates->connections_60s = 0;
+    return true;
+}
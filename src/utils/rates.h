@@ -0,0 +1,41 @@
+#ifndef RATES_H_Tn4wX7cQe1ZpVb9sLk2HmJyR
+#define RATES_H_Tn4wX7cQe1ZpVb9sLk2HmJyR
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * rates.c - tasas de tráfico suavizadas con promedios móviles exponenciales.
+ *
+ * Las tasas no se actualizan por paquete: quien las usa lleva contadores
+ * monótonos (bytes totales, conexiones totales) y llama a traffic_rates_tick
+ * una vez por segundo desde el timer del loop. El tick toma la diferencia
+ * contra el tick anterior y la incorpora a tres ventanas (1s, 10s y 60s).
+ */
+
+typedef struct {
+    double bytes_1s;            // bytes/s
+    double bytes_10s;
+    double bytes_60s;
+    double connections_1s;      // conexiones nuevas/s
+    double connections_10s;
+    double connections_60s;
+    uint64_t last_bytes;        // contadores vistos en el último tick
+    uint64_t last_connections;
+} traffic_rates_t;
+
+/**
+ * Incorpora los contadores actuales. `elapsed_seconds' es la cantidad de
+ * segundos completos desde el tick anterior (normalmente 1).
+ */
+void traffic_rates_tick(traffic_rates_t *rates, uint64_t total_bytes,
+                        uint64_t total_connections, unsigned elapsed_seconds);
+
+/**
+ * Si todas las tasas decayeron por debajo de RATES_IDLE_EPSILON las deja en
+ * 0 y devuelve true: sin tráfico nuevo, otro tick no las cambiaría.
+ */
+#define RATES_IDLE_EPSILON 0.001
+bool traffic_rates_settle(traffic_rates_t *rates);
+
+#endif
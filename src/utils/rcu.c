@@ -0,0 +1,77 @@
+#include "rcu.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+typedef struct {
+    uint64_t epoch;         // 0 = fuera de una sección de lectura
+} __attribute__((aligned(64))) rcu_slot_t;
+
+static rcu_slot_t slots[RCU_MAX_READERS];
+static uint32_t slots_used = 0;
+static uint64_t global_epoch = 1;
+static uint64_t overflow_readers = 0;   // lectores sin slot propio
+
+static __thread rcu_slot_t *my_slot = NULL;
+static __thread int slot_state = 0;     // 0 = sin pedir, 1 = propio, -1 = sin lugar
+
+static void claim_slot(void) {
+    uint32_t index = __atomic_fetch_add(&slots_used, 1, __ATOMIC_RELAXED);
+    if (index < RCU_MAX_READERS) {
+        my_slot = &slots[index];
+        slot_state = 1;
+    } else {
+        slot_state = -1;
+    }
+}
+
+void rcu_read_lock(void) {
+    if (slot_state == 0) {
+        claim_slot();
+    }
+    if (slot_state > 0) {
+        uint64_t epoch = __atomic_load_n(&global_epoch, __ATOMIC_RELAXED);
+        __atomic_store_n(&my_slot->epoch, epoch, __ATOMIC_RELAXED);
+    } else {
+        __atomic_add_fetch(&overflow_readers, 1, __ATOMIC_RELAXED);
+    }
+    // El slot tiene que ser visible antes de leer el puntero publicado; hace
+    // pareja con la barrera de rcu_synchronize
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void rcu_read_unlock(void) {
+    if (slot_state > 0) {
+        __atomic_store_n(&my_slot->epoch, 0, __ATOMIC_RELEASE);
+    } else {
+        __atomic_sub_fetch(&overflow_readers, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void pause_briefly(void) {
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 50 * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+void rcu_synchronize(void) {
+    // El puntero nuevo ya se publicó: todo lector que marque la época nueva
+    // (o una posterior) lo va a leer a él
+    uint64_t target = __atomic_add_fetch(&global_epoch, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    uint32_t used = __atomic_load_n(&slots_used, __ATOMIC_RELAXED);
+    if (used > RCU_MAX_READERS) {
+        used = RCU_MAX_READERS;
+    }
+    for (uint32_t i = 0; i < used; i++) {
+        while (true) {
+            uint64_t epoch = __atomic_load_n(&slots[i].epoch, __ATOMIC_ACQUIRE);
+            if (epoch == 0 || epoch >= target) break;
+            pause_briefly();
+        }
+    }
+    while (__atomic_load_n(&overflow_readers, __ATOMIC_ACQUIRE) != 0) {
+        pause_briefly();
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef RCU_H_Pq7wLz2XcN9vTb4KmRd6HsYg
+#define RCU_H_Pq7wLz2XcN9vTb4KmRd6HsYg
+
+/**
+ * rcu.c - reclamación por épocas para datos que se publican con un puntero.
+ *
+ * El escritor arma una versión nueva aparte, la publica con un store
+ * atómico del puntero y llama a rcu_synchronize() antes de liberar la
+ * vieja. Los lectores encierran cada acceso entre rcu_read_lock() y
+ * rcu_read_unlock(): no toman locks ni esperan a nadie, solo escriben la
+ * época actual en un slot propio del hilo (una línea de caché que no
+ * comparte con otros lectores).
+ *
+ * rcu_synchronize() avanza la época y espera a que cada slot esté libre o
+ * haya visto la época nueva; los lectores que entran después ya leen el
+ * puntero nuevo. Espera durmiendo, así que se llama desde hilos de
+ * management o de fondo, nunca desde el loop, y sin locks que un lector
+ * pueda necesitar.
+ *
+ * Hasta RCU_MAX_READERS hilos tienen slot propio; los que vengan después
+ * comparten un contador (correcto, pero con contención entre ellos). El
+ * slot no se devuelve al terminar el hilo, así que los lectores deben ser
+ * hilos de vida larga (el loop, workers). Las secciones no se anidan.
+ */
+
+#define RCU_MAX_READERS 64
+
+void rcu_read_lock(void);
+void rcu_read_unlock(void);
+
+/** Espera a que terminen todas las lecturas que empezaron antes */
+void rcu_synchronize(void);
+
+#endif
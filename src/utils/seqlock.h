@@ -0,0 +1,58 @@
+#ifndef SEQLOCK_H_q8VtR2mXc4LpZs7NwYb3KfHd
+#define SEQLOCK_H_q8VtR2mXc4LpZs7NwYb3KfHd
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * seqlock.h - lock de secuencia para un único escritor y muchos lectores.
+ *
+ * El escritor (el loop de eventos) nunca se bloquea: incrementa el contador
+ * antes y después de modificar los datos protegidos. Mientras el contador es
+ * impar hay una escritura en curso.
+ *
+ * Los lectores (hilos de management, agentes de monitoreo) copian los datos y
+ * reintentan si el contador cambió en el medio o era impar al empezar:
+ *
+ *   uint32_t seq;
+ *   do {
+ *       seq = seqlock_read_begin(&lock);
+ *       copia = datos;
+ *   } while (seqlock_read_retry(&lock, seq));
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SEQLOCK_CPU_RELAX() __builtin_ia32_pause()
+#else
+#define SEQLOCK_CPU_RELAX() ((void)0)
+#endif
+
+typedef struct {
+    volatile uint32_t sequence;
+} seqlock_t;
+
+#define SEQLOCK_INITIALIZER { .sequence = 0 }
+
+static inline void seqlock_write_begin(seqlock_t *lock) {
+    __atomic_store_n(&lock->sequence, lock->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seqlock_write_end(seqlock_t *lock) {
+    __atomic_store_n(&lock->sequence, lock->sequence + 1, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t seqlock_read_begin(const seqlock_t *lock) {
+    uint32_t seq;
+    while ((seq = __atomic_load_n(&lock->sequence, __ATOMIC_ACQUIRE)) & 1u) {
+        SEQLOCK_CPU_RELAX();
+    }
+    return seq;
+}
+
+static inline bool seqlock_read_retry(const seqlock_t *lock, uint32_t seq) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&lock->sequence, __ATOMIC_RELAXED) != seq;
+}
+
+#endif
@@ -0,0 +1,74 @@
+#include "siphash.h"
+
+#include <sys/random.h>
+#include <unistd.h>
+
+#include "util.h"
+
+void siphash_random_key(siphash_key_t *key) {
+    uint64_t k[2];
+    if (getrandom(k, sizeof(k), 0) != (ssize_t)sizeof(k)) {
+        // Sin getrandom nos conformamos con algo que no se adivine de afuera
+        k[0] = monotonicNanos() ^ ((uint64_t)getpid() << 32);
+        k[1] = (uint64_t)(uintptr_t)&k ^ 0x736f636b73357573ULL;
+    }
+    key->k0 = k[0];
+    key->k1 = k[1];
+}
+
+#define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND                                                            \
+    do {                                                                    \
+        v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32);           \
+        v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2;                              \
+        v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0;                              \
+        v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32);           \
+    } while (0)
+
+static uint64_t load_le64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+uint64_t siphash24(const siphash_key_t *key, const void *data, size_t len) {
+    const uint8_t *in = data;
+    uint64_t v0 = 0x736f6d6570736575ULL ^ key->k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ key->k1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ key->k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ key->k1;
+
+    const uint8_t *end = in + (len & ~(size_t)7);
+    for (; in != end; in += 8) {
+        uint64_t m = load_le64(in);
+        v3 ^= m;
+        SIPROUND;
+        SIPROUND;
+        v0 ^= m;
+    }
+
+    uint64_t b = (uint64_t)len << 56;
+    switch (len & 7) {
+        case 7: b |= (uint64_t)in[6] << 48; /* fall through */
+        case 6: b |= (uint64_t)in[5] << 40; /* fall through */
+        case 5: b |= (uint64_t)in[4] << 32; /* fall through */
+        case 4: b |= (uint64_t)in[3] << 24; /* fall through */
+        case 3: b |= (uint64_t)in[2] << 16; /* fall through */
+        case 2: b |= (uint64_t)in[1] << 8;  /* fall through */
+        case 1: b |= (uint64_t)in[0];       break;
+        default: break;
+    }
+    v3 ^= b;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= b;
+    v2 ^= 0xff;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
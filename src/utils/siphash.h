@@ -0,0 +1,25 @@
+#ifndef SIPHASH_H_Rm3vKq8TzW1xNc5LpHd7BsJf
+#define SIPHASH_H_Rm3vKq8TzW1xNc5LpHd7BsJf
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * siphash.c - SipHash-2-4: hash de 64 bits con una clave de 128.
+ *
+ * Para datos que elige el cliente (nombres de usuario, credenciales): sin
+ * conocer la clave no puede predecir el resultado ni fabricar colisiones.
+ * Cada usuario del hash elige su propia clave con siphash_random_key().
+ */
+
+typedef struct {
+    uint64_t k0;
+    uint64_t k1;
+} siphash_key_t;
+
+/** Clave de getrandom(); si no está disponible, una que no se adivine de afuera */
+void siphash_random_key(siphash_key_t *key);
+
+uint64_t siphash24(const siphash_key_t *key, const void *data, size_t len);
+
+#endif
@@ -0,0 +1,135 @@
+#include "slow_handshake.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "logger.h"
+#include "util.h"
+
+static unsigned threshold_ms = SLOW_HANDSHAKE_DEFAULT_MS;
+static uint64_t slow_total = 0;
+
+// Últimos handshakes lentos; los escribe el loop, los lee management
+static pthread_mutex_t recent_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct {
+    uint64_t recorded_ms;
+    slow_handshake_t entry;
+} recent[SLOW_HANDSHAKE_RETAINED];
+static size_t recent_next = 0;
+
+static uint64_t now_us(void) {
+    return monotonicNanos() / 1000;
+}
+
+static uint32_t clamp_us(uint64_t us) {
+    return us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+void slow_handshake_configure(unsigned ms) {
+    __atomic_store_n(&threshold_ms, ms, __ATOMIC_RELAXED);
+}
+
+unsigned slow_handshake_threshold_ms(void) {
+    return __atomic_load_n(&threshold_ms, __ATOMIC_RELAXED);
+}
+
+void handshake_timing_start(handshake_timing_t *timing) {
+    memset(timing, 0, sizeof(*timing));
+    timing->started_us = now_us();
+    timing->lap_us = timing->started_us;
+}
+
+uint32_t handshake_lap(handshake_timing_t *timing) {
+    uint64_t now = now_us();
+    uint64_t elapsed = now > timing->lap_us ? now - timing->lap_us : 0;
+    timing->lap_us = now;
+    return clamp_us(elapsed);
+}
+
+void handshake_connect_attempt(handshake_timing_t *timing) {
+    uint32_t elapsed = handshake_lap(timing);
+    if (timing->connect_attempts < SLOW_HANDSHAKE_MAX_ATTEMPTS) {
+        timing->connect_us[timing->connect_attempts] = elapsed;
+    }
+    timing->connect_attempts++;
+}
+
+// "1200,35" con los intentos medidos, "+N" si hubo más
+static void format_attempts(const handshake_timing_t *timing, char *out, size_t size) {
+    size_t used = 0;
+    out[0] = '\0';
+    if (timing->connect_attempts == 0) {
+        snprintf(out, size, "-");
+        return;
+    }
+    uint32_t measured = timing->connect_attempts < SLOW_HANDSHAKE_MAX_ATTEMPTS
+                            ? timing->connect_attempts : SLOW_HANDSHAKE_MAX_ATTEMPTS;
+    for (uint32_t i = 0; i < measured && used < size; i++) {
+        used += (size_t)snprintf(out + used, size - used, "%s%" PRIu32, i ? "," : "", timing->connect_us[i]);
+    }
+    if (timing->connect_attempts > measured && used < size) {
+        snprintf(out + used, size - used, ",+%" PRIu32, timing->connect_attempts - measured);
+    }
+}
+
+bool slow_handshake_finish(uint64_t connection_id, const char *username, const char *destination,
+                           handshake_timing_t *timing, bool failed) {
+    if (timing->started_us == 0) return false;
+    timing->total_us = clamp_us(now_us() - timing->started_us);
+    unsigned threshold = slow_handshake_threshold_ms();
+    if (threshold == 0 || timing->total_us < threshold * 1000ULL) return false;
+
+    slow_handshake_t entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.connection_id = connection_id;
+    if (username != NULL) {
+        strncpy(entry.username, username, SLOW_HANDSHAKE_USERNAME_LEN - 1);
+    }
+    if (destination != NULL) {
+        strncpy(entry.destination, destination, SLOW_HANDSHAKE_DESTINATION_LEN - 1);
+    }
+    entry.failed = failed ? 1 : 0;
+    entry.timing = *timing;
+
+    pthread_mutex_lock(&recent_mutex);
+    recent[recent_next].recorded_ms = monotonicMillis();
+    recent[recent_next].entry = entry;
+    recent_next = (recent_next + 1) % SLOW_HANDSHAKE_RETAINED;
+    slow_total++;
+    pthread_mutex_unlock(&recent_mutex);
+
+    char attempts[96];
+    format_attempts(timing, attempts, sizeof(attempts));
+    log_warn_limited("slow handshake id=%" PRIu64 " user=%s dest=%s status=%s total_us=%" PRIu32
+                     " greeting_us=%" PRIu32 " auth_us=%" PRIu32 " validate_us=%" PRIu32
+                     " request_us=%" PRIu32 " dns_us=%" PRIu32 " connect_us=%s reply_us=%" PRIu32,
+                     connection_id, entry.username[0] ? entry.username : "-",
+                     entry.destination[0] ? entry.destination : "-", failed ? "error" : "ok",
+                     timing->total_us, timing->greeting_us, timing->auth_us, timing->validate_us,
+                     timing->request_us, timing->dns_us, attempts, timing->reply_us);
+    return true;
+}
+
+uint64_t slow_handshake_total(void) {
+    pthread_mutex_lock(&recent_mutex);
+    uint64_t total = slow_total;
+    pthread_mutex_unlock(&recent_mutex);
+    return total;
+}
+
+size_t slow_handshake_query(slow_handshake_t *out, size_t max) {
+    size_t count = 0;
+    uint64_t now_ms = monotonicMillis();
+    pthread_mutex_lock(&recent_mutex);
+    for (size_t n = 1; n <= SLOW_HANDSHAKE_RETAINED && count < max; n++) {
+        size_t index = (recent_next + SLOW_HANDSHAKE_RETAINED - n) % SLOW_HANDSHAKE_RETAINED;
+        if (recent[index].recorded_ms == 0) continue;
+        out[count] = recent[index].entry;
+        out[count].ago_ms = now_ms - recent[index].recorded_ms;
+        count++;
+    }
+    pthread_mutex_unlock(&recent_mutex);
+    return count;
+}
@@ -0,0 +1,79 @@
+#ifndef SLOW_HANDSHAKE_H_Hn3kW7qZr5TcLx9VbMd2YsJf
+#define SLOW_HANDSHAKE_H_Hn3kW7qZr5TcLx9VbMd2YsJf
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * slow_handshake.c - detector de handshakes lentos.
+ *
+ * Cada sesión va cronometrando su handshake por etapa (saludo,
+ * autenticación con validateUser aparte, lectura del pedido, DNS, cada
+ * intento de connect y el envío de la respuesta). Al terminar, bien o mal,
+ * si el total supera el umbral se deja una línea WARN con el desglose y el
+ * registro queda entre los últimos SLOW_HANDSHAKE_RETAINED para management.
+ *
+ * El cronómetro es un "lap": cada etapa mide desde el fin de la anterior, así
+ * que la espera por el cliente cae en la etapa que la espera y la suma de las
+ * etapas da el total.
+ */
+
+#define SLOW_HANDSHAKE_DEFAULT_MS 500
+#define SLOW_HANDSHAKE_RETAINED 32
+#define SLOW_HANDSHAKE_MAX_ATTEMPTS 4
+#define SLOW_HANDSHAKE_USERNAME_LEN 64
+#define SLOW_HANDSHAKE_DESTINATION_LEN 272
+
+// Microsegundos por etapa; 0 = etapa no alcanzada (o de menos de 1us)
+typedef struct {
+    uint64_t started_us;        // reloj monotónico al aceptar
+    uint64_t lap_us;            // fin de la última etapa medida
+    uint32_t greeting_us;       // aceptada -> saludo respondido
+    uint32_t auth_us;           // saludo -> autenticación respondida
+    uint32_t validate_us;       // parte de auth_us que llevó validateUser
+    uint32_t request_us;        // autenticada -> pedido CONNECT leído
+    uint32_t dns_us;
+    uint32_t connect_us[SLOW_HANDSHAKE_MAX_ATTEMPTS];
+    uint32_t connect_attempts;  // intentos hechos, pueden ser más que los medidos
+    uint32_t reply_us;
+    uint32_t total_us;
+} handshake_timing_t;
+
+// Handshake lento; también es la entrada de CMD_SLOW_HANDSHAKES
+typedef struct {
+    uint64_t connection_id;
+    char username[SLOW_HANDSHAKE_USERNAME_LEN];
+    char destination[SLOW_HANDSHAKE_DESTINATION_LEN];
+    uint32_t failed;            // 1 si el handshake no llegó al relay
+    uint32_t reserved;
+    uint64_t ago_ms;            // completado por la consulta
+    handshake_timing_t timing;
+} slow_handshake_t;
+
+/** Umbral en milisegundos; 0 apaga el detector */
+void slow_handshake_configure(unsigned threshold_ms);
+unsigned slow_handshake_threshold_ms(void);
+
+/* Cronómetro: solo desde el loop de eventos */
+void handshake_timing_start(handshake_timing_t *timing);
+/** Microsegundos desde la última marca; mueve la marca a ahora */
+uint32_t handshake_lap(handshake_timing_t *timing);
+void handshake_connect_attempt(handshake_timing_t *timing);
+
+/**
+ * Cierra el cronómetro y, si el total pasa el umbral, registra el handshake.
+ * Devuelve true si fue lento.
+ */
+bool slow_handshake_finish(uint64_t connection_id, const char *username, const char *destination,
+                           handshake_timing_t *timing, bool failed);
+
+/* Lectura: desde cualquier hilo */
+
+/** Handshakes lentos desde el arranque */
+uint64_t slow_handshake_total(void);
+
+/** Copia hasta `max' de los más recientes, del más nuevo al más viejo */
+size_t slow_handshake_query(slow_handshake_t *out, size_t max);
+
+#endif
@@ -0,0 +1,93 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "stats_shm.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+static stats_shm_layout_t *segment = NULL;
+static char segment_name[STATS_SHM_NAME_LEN];
+
+void stats_shm_name(unsigned short socks_port, char *out, size_t out_len) {
+    snprintf(out, out_len, STATS_SHM_NAME_FORMAT, (unsigned)socks_port);
+}
+
+int stats_shm_create(const char *name) {
+    if (segment != NULL || name == NULL) {
+        return -1;
+    }
+
+    // Si quedó un segmento de una ejecución anterior lo descartamos: los
+    // lectores que lo tengan mapeado verán que el pid no cambia más.
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        log_error("Could not create stats segment %s", name);
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(stats_shm_layout_t)) < 0) {
+        log_error("Could not size stats segment %s", name);
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+
+    void *mem = mmap(NULL, sizeof(stats_shm_layout_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        log_error("Could not map stats segment %s", name);
+        shm_unlink(name);
+        return -1;
+    }
+
+    segment = mem;
+    memset(segment, 0, sizeof(*segment));
+    segment->version = STATS_SHM_VERSION;
+    segment->size = sizeof(stats_shm_layout_t);
+    segment->pid = (uint32_t)getpid();
+    // El magic va último: un lector que lo ve ya tiene el resto del encabezado
+    __atomic_store_n(&segment->magic, STATS_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    strncpy(segment_name, name, sizeof(segment_name) - 1);
+    segment_name[sizeof(segment_name) - 1] = '\0';
+    return 0;
+}
+
+bool stats_shm_active(void) {
+    return segment != NULL;
+}
+
+stats_shm_layout_t *stats_shm_write_begin(void) {
+    if (segment == NULL) {
+        return NULL;
+    }
+    seqlock_write_begin(&segment->lock);
+    return segment;
+}
+
+void stats_shm_write_end(void) {
+    if (segment == NULL) {
+        return;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    segment->updated_unix_ms = (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+    segment->publish_count++;
+    seqlock_write_end(&segment->lock);
+}
+
+void stats_shm_destroy(void) {
+    if (segment == NULL) {
+        return;
+    }
+    munmap(segment, sizeof(stats_shm_layout_t));
+    segment = NULL;
+    shm_unlink(segment_name);
+}
@@ -0,0 +1,86 @@
+#ifndef STATS_SHM_H_Wc6nB1sRz8KqYd3LmTp5XvGe
+#define STATS_SHM_H_Wc6nB1sRz8KqYd3LmTp5XvGe
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "seqlock.h"
+
+/**
+ * stats_shm.c - segmento de memoria compartida con estadísticas del proxy.
+ *
+ * El servidor crea un segmento POSIX (shm_open) con nombre
+ * "/socks5d-stats-<puerto SOCKS>" y publica ahí una copia de sus contadores.
+ * Un agente de monitoreo local lo abre en solo lectura y lo muestrea con
+ * mmap, sin pasar por el protocolo de gestión ni crear hilos en el proxy.
+ *
+ * El layout es parte de la ABI: solo se agregan campos al final y cada
+ * cambio incrementa STATS_SHM_VERSION. Todos los campos tienen ancho fijo.
+ * Los lectores deben validar magic/version/size y copiar con el seqlock:
+ *
+ *   stats_shm_layout_t copy;
+ *   uint32_t seq;
+ *   do {
+ *       seq = seqlock_read_begin(&shm->lock);
+ *       memcpy(&copy, shm, sizeof(copy));
+ *   } while (seqlock_read_retry(&shm->lock, seq));
+ */
+
+#define STATS_SHM_MAGIC   0x5335534bu   /* "KS5S" */
+#define STATS_SHM_VERSION 2u
+#define STATS_SHM_NAME_FORMAT "/socks5d-stats-%u"
+#define STATS_SHM_NAME_LEN 64
+
+typedef struct {
+    /* encabezado: se escribe una vez al crear el segmento */
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;                  /* sizeof(stats_shm_layout_t) del escritor */
+    uint32_t pid;
+    seqlock_t lock;
+    uint32_t reserved;
+
+    /* datos: protegidos por `lock' */
+    uint64_t publish_count;
+    uint64_t updated_unix_ms;       /* reloj de pared de la última publicación */
+    int64_t  server_start_time;     /* time_t */
+    uint64_t total_connections;
+    uint64_t current_connections;
+    uint64_t peak_concurrent_connections;
+    uint64_t total_bytes_transferred;
+    uint64_t configured_users;
+    double   bytes_rate_1s;
+    double   bytes_rate_10s;
+    double   bytes_rate_60s;
+    double   connection_rate_1s;
+    double   connection_rate_10s;
+    double   connection_rate_60s;
+
+    /* versión 2: autoperfilado del loop de eventos */
+    uint64_t loop_wakeups;
+    uint64_t loop_max_handler_ns;   /* handler más largo del último segundo */
+    double   loop_utilization;      /* fracción ocupada del último segundo */
+    double   loop_utilization_60s;
+} stats_shm_layout_t;
+
+/** Arma el nombre del segmento para un puerto SOCKS dado */
+void stats_shm_name(unsigned short socks_port, char *out, size_t out_len);
+
+/** Crea (o recrea) el segmento. Retorna 0 si pudo, -1 si no. */
+int stats_shm_create(const char *name);
+
+/** Indica si el segmento está activo */
+bool stats_shm_active(void);
+
+/**
+ * Devuelve el layout para completarlo. Debe usarse entre
+ * stats_shm_write_begin y stats_shm_write_end, solo desde un hilo.
+ */
+stats_shm_layout_t *stats_shm_write_begin(void);
+void stats_shm_write_end(void);
+
+/** Desmapea y elimina el segmento */
+void stats_shm_destroy(void);
+
+#endif
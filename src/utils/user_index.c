@@ -0,0 +1,141 @@
+#include "user_index.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "siphash.h"
+
+#define USER_INDEX_MIN_CAPACITY 16
+
+static siphash_key_t sip_key;
+static pthread_once_t sip_once = PTHREAD_ONCE_INIT;
+
+static void sip_init_key(void) {
+    siphash_random_key(&sip_key);
+}
+
+// SipHash-2-4 del nombre con la clave del proceso
+static uint64_t siphash(const char *key) {
+    pthread_once(&sip_once, sip_init_key);
+    return siphash24(&sip_key, key, strlen(key));
+}
+
+// Posición de `key' o del hueco donde iría
+static size_t probe(const user_index_t *index, const char *key, uint64_t hash, bool *found) {
+    size_t mask = index->capacity - 1;
+    size_t pos = (size_t)hash & mask;
+    while (index->entries[pos].key != NULL) {
+        const user_index_entry_t *e = &index->entries[pos];
+        if (e->hash == hash && strcmp(e->key, key) == 0) {
+            *found = true;
+            return pos;
+        }
+        pos = (pos + 1) & mask;
+    }
+    *found = false;
+    return pos;
+}
+
+static int resize(user_index_t *index, size_t capacity) {
+    user_index_entry_t *entries = calloc(capacity, sizeof(*entries));
+    if (entries == NULL) return -1;
+
+    user_index_entry_t *old = index->entries;
+    size_t old_capacity = index->capacity;
+    index->entries = entries;
+    index->capacity = capacity;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i].key == NULL) continue;
+        size_t pos = (size_t)old[i].hash & (capacity - 1);
+        while (entries[pos].key != NULL) {
+            pos = (pos + 1) & (capacity - 1);
+        }
+        entries[pos] = old[i];
+    }
+    free(old);
+    return 0;
+}
+
+int user_index_reserve(user_index_t *index, size_t count) {
+    size_t capacity = index->capacity ? index->capacity : USER_INDEX_MIN_CAPACITY;
+    while (count * 4 > capacity * 3) {
+        capacity *= 2;
+    }
+    if (capacity == index->capacity) return 0;
+    return resize(index, capacity);
+}
+
+void *user_index_get(const user_index_t *index, const char *key) {
+    if (index->count == 0 || key == NULL) return NULL;
+    bool found;
+    size_t pos = probe(index, key, siphash(key), &found);
+    return found ? index->entries[pos].value : NULL;
+}
+
+int user_index_put(user_index_t *index, const char *key, void *value) {
+    if (user_index_reserve(index, index->count + 1) < 0) return -1;
+    uint64_t hash = siphash(key);
+    bool found;
+    size_t pos = probe(index, key, hash, &found);
+    user_index_entry_t *e = &index->entries[pos];
+    if (!found) {
+        e->hash = hash;
+        index->count++;
+    }
+    e->key = key;
+    e->value = value;
+    return 0;
+}
+
+void *user_index_remove(user_index_t *index, const char *key) {
+    if (index->count == 0 || key == NULL) return NULL;
+    bool found;
+    size_t mask = index->capacity - 1;
+    size_t hole = probe(index, key, siphash(key), &found);
+    if (!found) return NULL;
+    void *value = index->entries[hole].value;
+
+    // Corrimiento hacia atrás: toda entrada del mismo cluster que pueda
+    // ocupar el hueco sin quedar antes de su posición ideal se mueve
+    size_t pos = hole;
+    while (true) {
+        pos = (pos + 1) & mask;
+        user_index_entry_t *e = &index->entries[pos];
+        if (e->key == NULL) break;
+        size_t ideal = (size_t)e->hash & mask;
+        if (((pos - ideal) & mask) >= ((pos - hole) & mask)) {
+            index->entries[hole] = *e;
+            hole = pos;
+        }
+    }
+    memset(&index->entries[hole], 0, sizeof(index->entries[hole]));
+    index->count--;
+    return value;
+}
+
+int user_index_copy(user_index_t *dst, const user_index_t *src) {
+    *dst = (user_index_t){0};
+    if (src->capacity == 0) return 0;
+    dst->entries = malloc(src->capacity * sizeof(*src->entries));
+    if (dst->entries == NULL) return -1;
+    memcpy(dst->entries, src->entries, src->capacity * sizeof(*src->entries));
+    dst->capacity = src->capacity;
+    dst->count = src->count;
+    return 0;
+}
+
+void user_index_clear(user_index_t *index) {
+    if (index->entries != NULL) {
+        memset(index->entries, 0, index->capacity * sizeof(*index->entries));
+    }
+    index->count = 0;
+}
+
+void user_index_free(user_index_t *index) {
+    free(index->entries);
+    index->entries = NULL;
+    index->capacity = 0;
+    index->count = 0;
+}
@@ -0,0 +1,54 @@
+#ifndef USER_INDEX_H_Ts6pQ9vKw2NzRb4XhLc8MdYe
+#define USER_INDEX_H_Ts6pQ9vKw2NzRb4XhLc8MdYe
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * user_index.c - índice de usuarios por nombre.
+ *
+ * Hash con direccionamiento abierto y sondeo lineal; al borrar se corren las
+ * entradas siguientes hacia atrás, así que no quedan lápidas y una búsqueda
+ * fallida termina en el primer hueco. La capacidad es potencia de 2 y se
+ * duplica antes de pasar el 75% de ocupación.
+ *
+ * El hash es SipHash-2-4 con una clave aleatoria elegida al arrancar: los
+ * nombres que llegan en la autenticación los elige el cliente, y con una
+ * clave secreta no puede fabricar colisiones para alargar las búsquedas.
+ *
+ * El índice no copia los nombres: `key' debe seguir vivo mientras la entrada
+ * esté en el índice (normalmente apunta al nombre dentro de `value'). No
+ * tiene lock propio; lo protege quien lo usa.
+ */
+
+typedef struct {
+    uint64_t hash;
+    const char *key;        // NULL = libre
+    void *value;
+} user_index_entry_t;
+
+typedef struct {
+    user_index_entry_t *entries;
+    size_t capacity;        // potencia de 2; 0 hasta la primera inserción
+    size_t count;
+} user_index_t;
+
+/** Deja espacio para `count' entradas sin crecer. 0 si pudo, -1 sin memoria */
+int user_index_reserve(user_index_t *index, size_t count);
+
+/** Valor asociado a `key', o NULL */
+void *user_index_get(const user_index_t *index, const char *key);
+
+/** Inserta o reemplaza. 0 si pudo, -1 sin memoria */
+int user_index_put(user_index_t *index, const char *key, void *value);
+
+/** Quita `key'; devuelve su valor o NULL si no estaba */
+void *user_index_remove(user_index_t *index, const char *key);
+
+/** Copia `src' en `dst' (vacío) tal cual, sin rehashear. 0 si pudo */
+int user_index_copy(user_index_t *dst, const user_index_t *src);
+
+void user_index_clear(user_index_t *index);
+void user_index_free(user_index_t *index);
+
+#endif
@@ -0,0 +1,194 @@
+#include "user_journal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// '+' + usuario (63) + ':' + hash (127) + ":subida:bajada:conexiones" (33)
+// + '\n' + '\0' con margen
+#define JOURNAL_LINE_MAX 256
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int user_journal_open(user_journal_t *journal, const char *path) {
+    journal->path = path;
+    journal->records = 0;
+    journal->fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    return journal->fd < 0 ? -1 : 0;
+}
+
+void user_journal_close(user_journal_t *journal) {
+    if (journal->fd >= 0) {
+        close(journal->fd);
+    }
+    journal->fd = -1;
+}
+
+// Un registro es una línea entera en un solo write(): con O_APPEND no se
+// intercala con nada y un corte deja a lo sumo la última línea incompleta
+static int append(user_journal_t *journal, const char *line, int len) {
+    if (journal->fd < 0) {
+        errno = EBADF;
+        return -1;
+    }
+    if (len < 0 || len >= JOURNAL_LINE_MAX) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if (write_all(journal->fd, line, (size_t)len) < 0) return -1;
+    journal->records++;
+    return 0;
+}
+
+static int format_add(char *line, const char *username, const char *password) {
+    return snprintf(line, JOURNAL_LINE_MAX, "+%s:%s\n", username, password);
+}
+
+static int format_delete(char *line, const char *username) {
+    return snprintf(line, JOURNAL_LINE_MAX, "-%s\n", username);
+}
+
+int user_journal_add(user_journal_t *journal, const char *username, const char *password) {
+    char line[JOURNAL_LINE_MAX];
+    return append(journal, line, format_add(line, username, password));
+}
+
+int user_journal_delete(user_journal_t *journal, const char *username) {
+    char line[JOURNAL_LINE_MAX];
+    return append(journal, line, format_delete(line, username));
+}
+
+static int batch_append(user_journal_batch_t *batch, const char *line, int len) {
+    if (len < 0 || len >= JOURNAL_LINE_MAX) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if (batch->len + (size_t)len > batch->capacity) {
+        size_t capacity = batch->capacity ? batch->capacity : 4096;
+        while (capacity < batch->len + (size_t)len) {
+            capacity *= 2;
+        }
+        char *data = realloc(batch->data, capacity);
+        if (data == NULL) return -1;
+        batch->data = data;
+        batch->capacity = capacity;
+    }
+    memcpy(batch->data + batch->len, line, (size_t)len);
+    batch->len += (size_t)len;
+    batch->records++;
+    return 0;
+}
+
+int user_journal_batch_add(user_journal_batch_t *batch, const char *username, const char *password) {
+    char line[JOURNAL_LINE_MAX];
+    return batch_append(batch, line, format_add(line, username, password));
+}
+
+int user_journal_batch_delete(user_journal_batch_t *batch, const char *username) {
+    char line[JOURNAL_LINE_MAX];
+    return batch_append(batch, line, format_delete(line, username));
+}
+
+int user_journal_commit(user_journal_t *journal, user_journal_batch_t *batch) {
+    if (batch->records == 0) return 0;
+    if (journal->fd < 0) {
+        errno = EBADF;
+        return -1;
+    }
+    if (write_all(journal->fd, batch->data, batch->len) < 0) return -1;
+    journal->records += batch->records;
+    batch->len = 0;
+    batch->records = 0;
+    return 0;
+}
+
+void user_journal_batch_free(user_journal_batch_t *batch) {
+    if (batch->data != NULL) {
+        // Lleva los hashes de las claves
+        explicit_bzero(batch->data, batch->capacity);
+    }
+    free(batch->data);
+    *batch = (user_journal_batch_t){0};
+}
+
+int user_journal_rotate(user_journal_t *journal, const char *old_path) {
+    if (rename(journal->path, old_path) < 0) return -1;
+    user_journal_close(journal);
+    return user_journal_open(journal, journal->path);
+}
+
+int user_journal_truncate(user_journal_t *journal) {
+    if (journal->fd < 0 || ftruncate(journal->fd, 0) < 0) return -1;
+    journal->records = 0;
+    return 0;
+}
+
+long user_journal_replay(const char *path, user_journal_apply_fn apply, void *ctx) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    long records = 0;
+    char line[JOURNAL_LINE_MAX];
+    while (fgets(line, sizeof(line), f)) {
+        char *nl = strchr(line, '\n');
+        if (nl == NULL) {
+            if (feof(f)) break;     // la última, cortada a medio escribir
+            // Demasiado larga (no la escribimos nosotros): se saltea entera
+            int c;
+            while ((c = getc(f)) != EOF && c != '\n') {}
+            continue;
+        }
+        *nl = '\0';
+        if (line[0] == '+') {
+            char *sep = strchr(line + 1, ':');
+            if (sep == NULL) continue;
+            *sep = '\0';
+            apply('+', line + 1, sep + 1, ctx);
+        } else if (line[0] == '-') {
+            apply('-', line + 1, NULL, ctx);
+        } else {
+            continue;
+        }
+        records++;
+    }
+    fclose(f);
+    return records;
+}
+
+int user_journal_write_snapshot(const char *path, const char *data, size_t len) {
+    char tmp[PATH_MAX];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return -1;
+    bool ok = write_all(fd, data, len) == 0 && fsync(fd) == 0;
+    int saved_errno = errno;
+    close(fd);
+    if (!ok || rename(tmp, path) < 0) {
+        if (ok) saved_errno = errno;
+        unlink(tmp);
+        errno = saved_errno;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+#ifndef USER_JOURNAL_H_Vb3nQx8KmT2wRz6HpLd9YcJf
+#define USER_JOURNAL_H_Vb3nQx8KmT2wRz6HpLd9YcJf
+
+#include <stddef.h>
+
+/**
+ * user_journal.c - persistencia de usuarios como diario de cambios.
+ *
+ * Cada alta o baja agrega una línea al diario (`+usuario:clave' o
+ * `-usuario') con un solo write() sobre un fd en O_APPEND, en lugar de
+ * reescribir auth.db entero. auth.db queda como foto (snapshot) y se
+ * regenera de vez en cuando compactando: se rota el diario a `.old', se
+ * escribe la foto nueva en un temporal que se renombra encima y recién
+ * entonces se borra el `.old'.
+ *
+ * Al arrancar se carga la foto y se reaplican `.old' y el diario, en ese
+ * orden. Un `+' reemplaza la clave si el usuario ya estaba y un `-' de un
+ * usuario ausente no hace nada, así que reaplicar un diario que ya está en
+ * la foto (corte entre el rename y el unlink) deja el mismo resultado. Una
+ * última línea sin '\n' (corte a mitad de un write) se ignora.
+ *
+ * No tiene lock propio; lo protege quien lo usa.
+ */
+
+typedef struct {
+    int fd;                 // -1 si no está abierto
+    const char *path;
+    size_t records;         // líneas desde la última rotación
+} user_journal_t;
+
+/** Abre (o crea) el diario para agregar. 0 si pudo, -1 con errno */
+int user_journal_open(user_journal_t *journal, const char *path);
+void user_journal_close(user_journal_t *journal);
+
+/** Agregan un registro. 0 si pudo, -1 con errno */
+int user_journal_add(user_journal_t *journal, const char *username, const char *password);
+int user_journal_delete(user_journal_t *journal, const char *username);
+
+/**
+ * Registros de un lote (CMD_BATCH_USERS): se arman en memoria y
+ * user_journal_commit() los agrega todos con un solo write(). Un corte a
+ * mitad deja aplicados los registros completos, como si el lote hubiera
+ * llegado hasta ahí.
+ */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t capacity;
+    size_t records;
+} user_journal_batch_t;
+
+/** Agregan un registro al lote. 0 si pudo, -1 con errno */
+int user_journal_batch_add(user_journal_batch_t *batch, const char *username, const char *password);
+int user_journal_batch_delete(user_journal_batch_t *batch, const char *username);
+
+/** Escribe el lote en el diario y lo vacía. 0 si pudo, -1 con errno */
+int user_journal_commit(user_journal_t *journal, user_journal_batch_t *batch);
+void user_journal_batch_free(user_journal_batch_t *batch);
+
+/** Renombra el diario a `old_path' y empieza uno vacío. 0 si pudo */
+int user_journal_rotate(user_journal_t *journal, const char *old_path);
+
+/** Vacía el diario (después de una compactación sincrónica) */
+int user_journal_truncate(user_journal_t *journal);
+
+/**
+ * Reaplica `path' llamando a apply('+', usuario, clave, ctx) o
+ * apply('-', usuario, NULL, ctx) por registro. Devuelve la cantidad de
+ * registros, 0 si el archivo no existe o -1 si no se pudo leer. Una última
+ * línea sin '\n' (una escritura cortada) se ignora, y una demasiado larga
+ * se saltea sin perder las que siguen.
+ */
+typedef void (*user_journal_apply_fn)(char op, const char *username, const char *password, void *ctx);
+long user_journal_replay(const char *path, user_journal_apply_fn apply, void *ctx);
+
+/** Escribe `data' en `path' de forma atómica (temporal, fsync, rename) */
+int user_journal_write_snapshot(const char *path, const char *data, size_t len);
+
+#endif
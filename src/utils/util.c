@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 const char* printFamily(struct addrinfo* aip) {
     switch (aip->ai_family) {
@@ -139,3 +140,15 @@ int sockAddrsEqual(const struct sockaddr* addr1, const struct sockaddr* addr2) {
     } else
         return 0;
 }
+
+uint64_t monotonicMillis(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+uint64_t monotonicNanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
@@ -6,6 +6,7 @@
 #define _UTIL_H_
 
 #include <netdb.h>
+#include <stdint.h>
 #include <sys/socket.h>
 
 int printSocketAddress(const struct sockaddr* address, char* addrBuffer);
@@ -24,4 +25,8 @@ char* printAddressPort(const struct addrinfo* aip, char addr[]);
 // Determina si dos sockets son iguales (misma direccion y puerto)
 int sockAddrsEqual(const struct sockaddr* addr1, const struct sockaddr* addr2);
 
+// Milisegundos de CLOCK_MONOTONIC (no retrocede con cambios de hora del sistema)
+uint64_t monotonicMillis(void);
+uint64_t monotonicNanos(void);
+
 #endif
@@ -0,0 +1,291 @@
+// Uso:
+//    ./bin/access_log_decode [--csv] [access.bin ...]
+//
+// Decodifica el registro de accesos binario que escribe el proxy (ver
+// src/utils/access_log.h) a texto legible o a CSV. Sin archivos lee
+// access.bin. Acepta archivos con varios encabezados (uno por arranque del
+// servidor) y registros truncados al final (servidor interrumpido).
+
+#define _POSIX_C_SOURCE 200809L
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "utils/access_log.h"
+
+typedef struct {
+    uint32_t id;
+    char name[256];
+} user_entry;
+
+// Versión 2: los ids son 1..n por encabezado y users[id - 1] es el usuario.
+// Versión 1: los ids eran hashes y se buscan en orden.
+static user_entry *users = NULL;
+static size_t user_count = 0;
+static size_t user_capacity = 0;
+static bool dense_ids = true;
+
+static const char *type_names[] = {"USER", "AUTH", "CONNECT", "CLOSE"};
+static const char *status_names[] = {"OK", "FAIL", "ERROR"};
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [--csv] [FILE ...]\n"
+            "  --csv  Print comma-separated values with a header row\n"
+            "  FILE   Binary access log (default " ACCESS_LOG_DEFAULT_FILE ")\n",
+            prog);
+}
+
+static bool reserve_users(size_t count) {
+    if (count <= user_capacity) return true;
+    size_t capacity = user_capacity == 0 ? 64 : user_capacity;
+    while (capacity < count) capacity *= 2;
+    user_entry *grown = realloc(users, capacity * sizeof(*grown));
+    if (grown == NULL) {
+        return false;
+    }
+    memset(grown + user_capacity, 0, (capacity - user_capacity) * sizeof(*grown));
+    users = grown;
+    user_capacity = capacity;
+    return true;
+}
+
+static void define_user(uint32_t id, const uint8_t *name, size_t len) {
+    if (id == 0) return;
+    size_t slot = user_count;
+    if (dense_ids) {
+        // Se definen en orden: un id más adelante es un registro roto
+        if (id > user_count + 1) return;
+        slot = id - 1;
+    } else {
+        for (size_t i = 0; i < user_count; i++) {
+            if (users[i].id == id) {
+                return;
+            }
+        }
+    }
+    if (!reserve_users(slot + 1)) {
+        return;
+    }
+    if (len > sizeof(users[0].name) - 1) len = sizeof(users[0].name) - 1;
+    users[slot].id = id;
+    memcpy(users[slot].name, name, len);
+    users[slot].name[len] = '\0';
+    if (slot + 1 > user_count) {
+        user_count = slot + 1;
+    }
+}
+
+static const char *user_name(uint32_t id) {
+    if (id == 0) return "-";
+    if (dense_ids) {
+        return id <= user_count && users[id - 1].id == id ? users[id - 1].name : "?";
+    }
+    for (size_t i = 0; i < user_count; i++) {
+        if (users[i].id == id) return users[i].name;
+    }
+    return "?";
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+// Lee un varint; retorna false si se sale del registro
+static bool get_varint(const uint8_t **p, const uint8_t *end, uint64_t *out) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+        uint8_t byte = *(*p)++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *out = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void format_time(uint64_t unix_ms, char *out, size_t out_len) {
+    time_t secs = (time_t)(unix_ms / 1000);
+    struct tm tm_value;
+    localtime_r(&secs, &tm_value);
+    char base[32];
+    strftime(base, sizeof(base), "%Y-%m-%d %H:%M:%S", &tm_value);
+    snprintf(out, out_len, "%s.%03u", base, (unsigned)(unix_ms % 1000));
+}
+
+// CSV: los campos de texto van entre comillas y se duplican las comillas
+static void print_csv_string(const char *value, size_t len) {
+    putchar('"');
+    for (size_t i = 0; i < len; i++) {
+        if (value[i] == '"') putchar('"');
+        putchar(value[i]);
+    }
+    putchar('"');
+}
+
+static bool print_event(const uint8_t *rec, size_t len, bool csv) {
+    uint8_t type = rec[2];
+    uint8_t status = rec[3];
+    if (len < 12 || type > ACCESS_RECORD_CLOSE || status > ACCESS_STATUS_ERROR) {
+        return false;
+    }
+    const uint8_t *p = rec + 4;
+    const uint8_t *end = rec + len;
+    uint64_t timestamp = get_u64(p);
+    p += 8;
+
+    uint64_t connection_id, user_id, to_remote, to_client, duration;
+    if (!get_varint(&p, end, &connection_id) || !get_varint(&p, end, &user_id) ||
+        !get_varint(&p, end, &to_remote) || !get_varint(&p, end, &to_client) ||
+        !get_varint(&p, end, &duration)) {
+        return false;
+    }
+    const char *destination = (const char *)p;
+    size_t dest_len = (size_t)(end - p);
+
+    char when[48];
+    format_time(timestamp, when, sizeof(when));
+    const char *user = user_name((uint32_t)user_id);
+
+    if (csv) {
+        printf("%s,%s,%s,%" PRIu64 ",", when, type_names[type], status_names[status], connection_id);
+        print_csv_string(user, strlen(user));
+        putchar(',');
+        print_csv_string(destination, dest_len);
+        printf(",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", to_remote, to_client, duration);
+    } else {
+        if (dest_len == 0) {
+            destination = "-";
+            dest_len = 1;
+        }
+        printf("%s %-7s %-5s id=%" PRIu64 " user=%s dest=%.*s", when, type_names[type],
+               status_names[status], connection_id, user, (int)dest_len, destination);
+        if (type == ACCESS_RECORD_CLOSE) {
+            printf(" up=%" PRIu64 " down=%" PRIu64 " duration_ms=%" PRIu64, to_remote, to_client, duration);
+        }
+        putchar('\n');
+    }
+    return true;
+}
+
+static int decode_file(const char *path, bool csv) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    uint8_t record[65536];
+    long records = 0;
+    int status = 0;
+    while (true) {
+        uint8_t prefix[2];
+        size_t n = fread(prefix, 1, sizeof(prefix), file);
+        if (n == 0) break;
+        if (n < sizeof(prefix)) {
+            fprintf(stderr, "%s: truncated record at end of file\n", path);
+            break;
+        }
+
+        // Encabezado de archivo (uno por cada apertura del servidor)
+        if (memcmp(prefix, ACCESS_LOG_MAGIC, 2) == 0) {
+            uint8_t header[ACCESS_LOG_HEADER_LEN];
+            memcpy(header, prefix, 2);
+            if (fread(header + 2, 1, sizeof(header) - 2, file) != sizeof(header) - 2 ||
+                memcmp(header, ACCESS_LOG_MAGIC, 4) != 0) {
+                fprintf(stderr, "%s: bad header\n", path);
+                status = 1;
+                break;
+            }
+            uint16_t version = get_u16(header + 4);
+            if (version != 1 && version != ACCESS_LOG_VERSION) {
+                fprintf(stderr, "%s: unsupported version %u\n", path, version);
+                status = 1;
+                break;
+            }
+            dense_ids = version != 1;
+            if (users != NULL) {
+                memset(users, 0, user_count * sizeof(*users));
+            }
+            user_count = 0;
+            continue;
+        }
+
+        uint16_t len = get_u16(prefix);
+        if (len < 4) {
+            fprintf(stderr, "%s: corrupt record length %u after %ld records\n", path, len, records);
+            status = 1;
+            break;
+        }
+        memcpy(record, prefix, 2);
+        if (fread(record + 2, 1, len - 2, file) != (size_t)(len - 2)) {
+            fprintf(stderr, "%s: truncated record at end of file\n", path);
+            break;
+        }
+
+        if (record[2] == ACCESS_RECORD_USER) {
+            const uint8_t *p = record + 4;
+            uint64_t id;
+            if (get_varint(&p, record + len, &id)) {
+                define_user((uint32_t)id, p, (size_t)(record + len - p));
+            }
+        } else if (!print_event(record, len, csv)) {
+            fprintf(stderr, "%s: skipping malformed record (type %u)\n", path, record[2]);
+        }
+        records++;
+    }
+
+    fclose(file);
+    return status;
+}
+
+int main(int argc, char *argv[]) {
+    static struct option long_options[] = {
+        {"csv", no_argument, 0, 'c'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    bool csv = false;
+    int option;
+    while ((option = getopt_long(argc, argv, "ch", long_options, NULL)) != -1) {
+        switch (option) {
+            case 'c':
+                csv = true;
+                break;
+            case 'h':
+                usage(argv[0]);
+                return 0;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (csv) {
+        printf("time,event,status,connection_id,user,destination,bytes_to_remote,bytes_to_client,duration_ms\n");
+    }
+
+    int status = 0;
+    if (optind == argc) {
+        status = decode_file(ACCESS_LOG_DEFAULT_FILE, csv);
+    }
+    for (int i = optind; i < argc; i++) {
+        status |= decode_file(argv[i], csv);
+    }
+    free(users);
+    return status;
+}
@@ -0,0 +1,147 @@
+// Uso:
+//    ./bin/auth_bench [--seconds S]
+//
+// Mide autenticaciones por segundo con 10, 1000 y 100000 usuarios de dos
+// formas: la de antes (abrir auth.db y recorrerlo con fgets/strtok en cada
+// intento) y la actual (una búsqueda en el índice hash de src/utils/user_index.h
+// bajo un mutex, como hace mgmt_check_credentials). Un 10% de los intentos usa
+// un usuario inexistente, que es el peor caso de la búsqueda lineal.
+
+#define _POSIX_C_SOURCE 200809L
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "utils/user_index.h"
+#include "utils/util.h"
+
+#define NAME_LEN 64
+#define PASS_LEN 64
+
+typedef struct {
+    char username[NAME_LEN];
+    char password[PASS_LEN];
+} bench_user_t;
+
+static const char *db_path = "auth_bench.db";
+
+// La validación de auth.db tal como estaba en validateUser
+static bool legacy_validate(const char *username, const char *password) {
+    FILE *file = fopen(db_path, "r");
+    if (file == NULL) return false;
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        char *db_user = strtok(line, ":");
+        char *db_pass = strtok(NULL, "\n");
+        if (db_user && db_pass && strcmp(username, db_user) == 0 && strcmp(password, db_pass) == 0) {
+            fclose(file);
+            return true;
+        }
+    }
+    fclose(file);
+    return false;
+}
+
+static pthread_mutex_t index_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static bool index_validate(const user_index_t *index, const char *username, const char *password) {
+    pthread_mutex_lock(&index_mutex);
+    const bench_user_t *user = user_index_get(index, username);
+    bool valid = user != NULL && strcmp(user->password, password) == 0;
+    pthread_mutex_unlock(&index_mutex);
+    return valid;
+}
+
+// Nombre del intento i: existente salvo 1 de cada 10
+static void attempt_name(size_t users, uint64_t i, char *out) {
+    uint64_t r = i * 2654435761u;
+    if (i % 10 == 9) {
+        snprintf(out, NAME_LEN, "nobody%llu", (unsigned long long)(r % users));
+    } else {
+        snprintf(out, NAME_LEN, "user%llu", (unsigned long long)(r % users));
+    }
+}
+
+static double run_legacy(size_t users, double seconds) {
+    char name[NAME_LEN], pass[PASS_LEN];
+    uint64_t start = monotonicNanos();
+    uint64_t deadline = start + (uint64_t)(seconds * 1e9);
+    uint64_t attempts = 0, ok = 0;
+    do {
+        for (int batch = 0; batch < 16; batch++, attempts++) {
+            attempt_name(users, attempts, name);
+            snprintf(pass, sizeof(pass), "pass%s", name + 4);
+            ok += legacy_validate(name, pass);
+        }
+    } while (monotonicNanos() < deadline);
+    double elapsed = (monotonicNanos() - start) / 1e9;
+    if (ok == 0) fprintf(stderr, "legacy: no successful logins?\n");
+    return attempts / elapsed;
+}
+
+static double run_index(const user_index_t *index, size_t users, double seconds) {
+    char name[NAME_LEN], pass[PASS_LEN];
+    uint64_t start = monotonicNanos();
+    uint64_t deadline = start + (uint64_t)(seconds * 1e9);
+    uint64_t attempts = 0, ok = 0;
+    do {
+        for (int batch = 0; batch < 1024; batch++, attempts++) {
+            attempt_name(users, attempts, name);
+            snprintf(pass, sizeof(pass), "pass%s", name + 4);
+            ok += index_validate(index, name, pass);
+        }
+    } while (monotonicNanos() < deadline);
+    double elapsed = (monotonicNanos() - start) / 1e9;
+    if (ok == 0) fprintf(stderr, "index: no successful logins?\n");
+    return attempts / elapsed;
+}
+
+int main(int argc, char **argv) {
+    double seconds = 1.0;
+    static struct option options[] = {
+        {"seconds", required_argument, 0, 's'},
+        {0, 0, 0, 0},
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "s:", options, NULL)) != -1) {
+        if (c == 's') {
+            seconds = atof(optarg);
+        } else {
+            fprintf(stderr, "Usage: %s [--seconds S]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    static const size_t sizes[] = {10, 1000, 100000};
+    printf("%10s %16s %16s %10s\n", "users", "auth.db auth/s", "index auth/s", "speedup");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t users = sizes[s];
+        bench_user_t *table = calloc(users, sizeof(*table));
+        user_index_t index = {0};
+        FILE *db = fopen(db_path, "w");
+        if (table == NULL || db == NULL) {
+            perror("auth_bench");
+            return 1;
+        }
+        for (size_t i = 0; i < users; i++) {
+            snprintf(table[i].username, NAME_LEN, "user%zu", i);
+            snprintf(table[i].password, PASS_LEN, "pass%zu", i);
+            fprintf(db, "%s:%s\n", table[i].username, table[i].password);
+            user_index_put(&index, table[i].username, &table[i]);
+        }
+        fclose(db);
+
+        double legacy = run_legacy(users, seconds);
+        double hashed = run_index(&index, users, seconds);
+        printf("%10zu %16.0f %16.0f %9.0fx\n", users, legacy, hashed, hashed / legacy);
+
+        user_index_free(&index);
+        free(table);
+    }
+    unlink(db_path);
+    return 0;
+}
@@ -0,0 +1,139 @@
+// Uso:
+//    ./bin/stats_shm_reader --port 1080 [--interval-ms 10] [--count 0]
+//    ./bin/stats_shm_reader --name /socks5d-stats-1080
+//
+// Ejemplo de agente de monitoreo local: abre en solo lectura el segmento de
+// estadísticas que publica el proxy (ver src/utils/stats_shm.h) y lo muestrea
+// sin pasar por el protocolo de gestión. Cada muestra cuesta una copia de
+// memoria; el proxy no se entera de cuántos lectores hay ni con qué frecuencia
+// leen.
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "utils/stats_shm.h"
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [--port SOCKS_PORT | --name SHM_NAME] [--interval-ms MS] [--count N]\n"
+            "  --port        SOCKS port of the proxy (default 1080)\n"
+            "  --name        Explicit segment name (e.g. /socks5d-stats-1080)\n"
+            "  --interval-ms Sampling interval in milliseconds (default 1000, 10 = 100 Hz)\n"
+            "  --count       Number of samples, 0 = until interrupted (default 0)\n",
+            prog);
+}
+
+static const stats_shm_layout_t *map_segment(const char *name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "shm_open(%s): %s\n", name, strerror(errno));
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < offsetof(stats_shm_layout_t, publish_count)) {
+        fprintf(stderr, "%s: segment too small\n", name);
+        close(fd);
+        return NULL;
+    }
+    void *mem = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        fprintf(stderr, "mmap(%s): %s\n", name, strerror(errno));
+        return NULL;
+    }
+
+    const stats_shm_layout_t *shm = mem;
+    if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != STATS_SHM_MAGIC) {
+        fprintf(stderr, "%s: bad magic, not a stats segment\n", name);
+        munmap(mem, (size_t)st.st_size);
+        return NULL;
+    }
+    // Aceptamos versiones nuevas siempre que traigan al menos nuestro layout
+    if (shm->version < STATS_SHM_VERSION || shm->size < sizeof(stats_shm_layout_t) ||
+        (size_t)st.st_size < sizeof(stats_shm_layout_t)) {
+        fprintf(stderr, "%s: unsupported layout (version %u, size %u)\n", name, shm->version, shm->size);
+        munmap(mem, (size_t)st.st_size);
+        return NULL;
+    }
+    return shm;
+}
+
+static void snapshot(const stats_shm_layout_t *shm, stats_shm_layout_t *out) {
+    uint32_t seq;
+    do {
+        seq = seqlock_read_begin(&shm->lock);
+        memcpy(out, shm, sizeof(*out));
+    } while (seqlock_read_retry(&shm->lock, seq));
+}
+
+int main(int argc, char **argv) {
+    char name[STATS_SHM_NAME_LEN] = {0};
+    unsigned port = 1080;
+    long interval_ms = 1000;
+    long count = 0;
+
+    static struct option long_options[] = {
+        {"port", required_argument, 0, 'p'},
+        {"name", required_argument, 0, 'n'},
+        {"interval-ms", required_argument, 0, 'i'},
+        {"count", required_argument, 0, 'c'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "p:n:i:c:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'p': port = (unsigned)strtoul(optarg, NULL, 10); break;
+            case 'n': strncpy(name, optarg, sizeof(name) - 1); break;
+            case 'i': interval_ms = strtol(optarg, NULL, 10); break;
+            case 'c': count = strtol(optarg, NULL, 10); break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (name[0] == '\0') {
+        snprintf(name, sizeof(name), STATS_SHM_NAME_FORMAT, port);
+    }
+    if (interval_ms <= 0) {
+        interval_ms = 1;
+    }
+
+    const stats_shm_layout_t *shm = map_segment(name);
+    if (shm == NULL) {
+        return 1;
+    }
+
+    printf("%-23s %8s %10s %8s %14s %12s %12s %12s %7s %10s\n", "time", "pid", "total", "current",
+           "bytes", "KiB/s(1s)", "KiB/s(10s)", "conn/s(10s)", "loop%", "max(us)");
+
+    struct timespec sleep_for = {interval_ms / 1000, (interval_ms % 1000) * 1000000L};
+    stats_shm_layout_t sample;
+    for (long i = 0; count == 0 || i < count; i++) {
+        snapshot(shm, &sample);
+
+        time_t secs = (time_t)(sample.updated_unix_ms / 1000);
+        struct tm tm_now;
+        localtime_r(&secs, &tm_now);
+        char when[32];
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm_now);
+
+        printf("%s.%03u %8u %10" PRIu64 " %8" PRIu64 " %14" PRIu64 " %12.1f %12.1f %12.2f %7.1f %10.1f\n",
+               when, (unsigned)(sample.updated_unix_ms % 1000), sample.pid,
+               sample.total_connections, sample.current_connections,
+               sample.total_bytes_transferred, sample.bytes_rate_1s / 1024.0,
+               sample.bytes_rate_10s / 1024.0, sample.connection_rate_10s,
+               sample.loop_utilization * 100.0, sample.loop_max_handler_ns / 1000.0);
+        fflush(stdout);
+        nanosleep(&sleep_for, NULL);
+    }
+    return 0;
+}